@@ -0,0 +1,193 @@
+#include "ift.h"
+#include "jpeglib.h"
+
+#define UAI_ARGS_SOURCE
+#include "UAIArgs.h"
+
+#define HELP_MSG \
+    "This is a program for checking that the direct CIELAB ingestion (see\n"\
+    "iftReadLabMImageByExt) yields the CIELAB of every 8-bit RGB color, both\n"\
+    "from a .ppm image and from a .jpg image. Since the latter is lossy, its\n"\
+    "colors are compared to those decoded by libjpeg itself. Usage:\n\n"\
+    "  ./iftLabIdentityCheck [parameters]\n"\
+    "\nOptional parameters:\n"\
+    "  --tmp=STR      Path, without extension, of the temporary images with\n"\
+    "                 all colors (default:/tmp/iftLabIdentityCheck)\n"\
+    "  --tol=FLT      Maximum difference to iftRGBtoLabNorm (tol >= 0,\n"\
+    "                 default:2e-4)\n"\
+    "  --help         Prints this message\n"\
+    "\nOutput: maximum differences in L, a and b for each format, and PASSED\n"\
+    "or FAILED\n"
+
+int main(int argc, char const *argv[])
+{
+    const char *PARAM;
+    // 1. Input Validation -----------------------------------------------------
+    char tmp_path[IFT_STR_DEFAULT_SIZE];
+    float tol;
+
+    if(UAIArgsExists(argc, argv, "help"))
+    {
+        puts(HELP_MSG);
+        exit(EXIT_FAILURE);
+    }
+
+    if(UAIArgsExists(argc, argv, "tmp"))
+    {
+        PARAM = UAIArgsGet(argc, argv, "tmp");
+        if(PARAM == NULL) iftError("No temporary path was given!", "main");
+        else if(strlen(PARAM) + 5 > IFT_STR_DEFAULT_SIZE)
+            iftError("The temporary path is too long!", "main");
+        else strcpy(tmp_path, PARAM);
+    }
+    else strcpy(tmp_path, "/tmp/iftLabIdentityCheck");
+
+    if(UAIArgsExists(argc, argv, "tol"))
+    {
+        PARAM = UAIArgsGet(argc, argv, "tol");
+        if(PARAM == NULL)
+            iftError("No tolerance value was given!", "main");
+        else tol = atof(PARAM);
+
+        if(tol < 0.0) iftError("Invalid tolerance value!", "main");
+    }
+    else tol = 2e-4;
+
+    // 2. All Colors Image -----------------------------------------------------
+    // Kept as raw samples, since a color iftImage would keep them as YCbCr
+    uchar *colors, *ref;
+    bool passed;
+
+    colors = iftAllocUCharArray(4096 * 4096 * 3);
+    ref    = iftAllocUCharArray(4096 * 4096 * 3);
+
+    for(int c = 0; c < 4096 * 4096; c++)
+    {
+        colors[3 * c]     = (c >> 16) & 0xff;
+        colors[3 * c + 1] = (c >> 8) & 0xff;
+        colors[3 * c + 2] = c & 0xff;
+    }
+
+    passed = true;
+
+    for(int f = 0; f < 2; f++)
+    {
+        // 3. Temporary Image --------------------------------------------------
+        char path[IFT_STR_DEFAULT_SIZE];
+        FILE *fp;
+
+        sprintf(path, "%s%s", tmp_path, (f == 0) ? ".ppm" : ".jpg");
+
+        fp = fopen(path, "wb");
+        if(fp == NULL) iftError(MSG_FILE_OPEN_ERROR, "main", path);
+
+        if(f == 0)
+        {
+            fprintf(fp, "P6\n4096 4096\n255\n");
+            if(fwrite(colors, 1, 4096 * 4096 * 3, fp) != 4096 * 4096 * 3)
+                iftError("Writing error", "main");
+            fclose(fp);
+
+            memcpy(ref, colors, 4096 * 4096 * 3);
+        }
+        else
+        {
+            // Encoded and decoded by libjpeg alone, as the reference
+            struct jpeg_compress_struct cinfo;
+            struct jpeg_decompress_struct dinfo;
+            struct jpeg_error_mgr jerr;
+            JSAMPROW row;
+
+            cinfo.err = jpeg_std_error(&jerr);
+            jpeg_create_compress(&cinfo);
+            jpeg_stdio_dest(&cinfo, fp);
+            cinfo.image_width      = 4096;
+            cinfo.image_height     = 4096;
+            cinfo.input_components = 3;
+            cinfo.in_color_space   = JCS_RGB;
+            jpeg_set_defaults(&cinfo);
+            jpeg_set_quality(&cinfo, 90, TRUE);
+            jpeg_start_compress(&cinfo, TRUE);
+
+            while(cinfo.next_scanline < cinfo.image_height)
+            {
+                row = &colors[cinfo.next_scanline * 4096 * 3];
+                (void) jpeg_write_scanlines(&cinfo, &row, 1);
+            }
+
+            jpeg_finish_compress(&cinfo);
+            jpeg_destroy_compress(&cinfo);
+            fclose(fp);
+
+            fp = fopen(path, "rb");
+            if(fp == NULL) iftError(MSG_FILE_OPEN_ERROR, "main", path);
+
+            dinfo.err = jpeg_std_error(&jerr);
+            jpeg_create_decompress(&dinfo);
+            jpeg_stdio_src(&dinfo, fp);
+            (void) jpeg_read_header(&dinfo, TRUE);
+            dinfo.out_color_space = JCS_RGB;
+            (void) jpeg_start_decompress(&dinfo);
+
+            while(dinfo.output_scanline < dinfo.output_height)
+            {
+                row = &ref[dinfo.output_scanline * 4096 * 3];
+                (void) jpeg_read_scanlines(&dinfo, &row, 1);
+            }
+
+            (void) jpeg_finish_decompress(&dinfo);
+            jpeg_destroy_decompress(&dinfo);
+            fclose(fp);
+        }
+
+        // 4. Comparison -------------------------------------------------------
+        float max_diff[3];
+        iftMImage *mimg;
+
+        mimg = iftReadLabMImageByExt(path);
+        remove(path);
+
+        if(mimg->m != 3 || mimg->n != 4096 * 4096)
+            iftError("Unexpected multiband image", "main");
+
+        max_diff[0] = max_diff[1] = max_diff[2] = 0.0;
+
+        #ifdef IFT_PARALLEL
+        #pragma omp parallel for reduction(max:max_diff[:3])
+        #endif
+        for(iftIdx p = 0; p < mimg->n; p++)
+        {
+            iftColor RGB;
+            iftFColor Lab;
+
+            RGB.val[0] = ref[3 * p];
+            RGB.val[1] = ref[3 * p + 1];
+            RGB.val[2] = ref[3 * p + 2];
+            Lab = iftRGBtoLabNorm(RGB, 255);
+
+            for(int b = 0; b < 3; b++)
+                max_diff[b] = iftMax(max_diff[b], fabs(mimg->val[p][b] - Lab.val[b]));
+        }
+
+        iftDestroyMImage(&mimg);
+
+        printf("%s L %g\n%s a %g\n%s b %g\n", iftFileExt(path), max_diff[0],
+               iftFileExt(path), max_diff[1], iftFileExt(path), max_diff[2]);
+
+        if(max_diff[0] > tol || max_diff[1] > tol || max_diff[2] > tol)
+            passed = false;
+    }
+
+    iftFree(colors);
+    iftFree(ref);
+
+    if(!passed)
+    {
+        puts("FAILED");
+        return EXIT_FAILURE;
+    }
+
+    puts("PASSED");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,248 @@
+#include "ift.h"
+#include "iftODIFF.h"
+#include "iftOISF.h"
+
+#define UAI_ARGS_SOURCE
+#include "UAIArgs.h"
+
+#define HELP_MSG \
+    "This is a demo program for the OISF-ODIFF algorithm. Usage:\n\n"\
+    "  ./iftOISF_ODIFF [parameters]\n"\
+    "\nRequired parameters:\n"\
+    "  --img=STR      Path to the input image (.png, .jpg, .pgm, .ppm)\n"\
+    "  --objsm=STR    Path to the object saliency map image (.png, .jpg, .pgm, .pfm, .raw)\n"\
+    "  --k=INT        Desired number of superpixels (k > 1)\n"\
+    "  --labels=STR   Path to the output label image (.png, .jpg, .pgm, .lbl)\n"\
+    "\nOptional parameters for ODIFF:\n"\
+    "  --perc=FLT     Object seeds' percentage (0 <= perc <= 1, default:0.9)\n"\
+    "\nOptional parameters for OISF:\n"\
+    "  --alpha=FLT    Regularity factor (alpha > 0, default:0.5)\n"\
+    "  --beta=FLT     Boundary adherence factor (beta > 0, default:12.0)\n"\
+    "  --gamma=FLT    Saliency map confidence factor (gamma > 0, default:2.0)\n"\
+    "  --iters=INT    Number of iterations for segmentation (iters > 0, default:10)\n"\
+    "  --qbits=INT    Bits of the quantized graph features (0, 8 or 16, default:0)\n"\
+    "  --order=STR    Node layout of the graph (raster, tiled or morton, default:raster)\n"\
+    "\nOther optional parameters:\n"\
+    "  --mask=STR     Mask for delimiting a ROI (.png, .jpg, .pgm)\n"\
+    "  --ovlay=STR    Path to the output image with overlayed borders (.png, .jpg, .pgm, .ppm)\n"\
+    "  --help         Prints this message\n"
+
+int main(int argc, char const *argv[])
+{
+    const char *PARAM;
+    // 1. Input Validation -----------------------------------------------------
+    bool has_required;
+    int k;
+    iftImage *objsm;
+    iftFImage *fobjsm;
+    const char *img_path;
+    
+    has_required = UAIArgsExists(argc, argv, "img") &&
+                   UAIArgsExists(argc, argv, "objsm") &&
+                   UAIArgsExists(argc, argv, "k") &&
+                   UAIArgsExists(argc, argv, "labels");
+    if(!has_required || UAIArgsExists(argc, argv, "help"))
+    {
+        puts(HELP_MSG);
+        exit(EXIT_FAILURE);
+    }
+
+    PARAM = UAIArgsGet(argc, argv, "img");
+    if(PARAM == NULL) iftError("No image was given!", "main");
+    img_path = PARAM; // decoded while the graph is built
+
+    PARAM = UAIArgsGet(argc, argv, "objsm");
+    if(PARAM == NULL) iftError("No object saliency map was given!", "main");
+
+    // Float maps (e.g., raw 32-bit floats of the image's size) feed the graph
+    // at full precision, and the samplers with 16 bits
+    if(iftEndsWith(PARAM, ".pfm") || iftEndsWith(PARAM, ".raw"))
+    {
+        if(iftEndsWith(PARAM, ".raw"))
+        {
+            iftLabRowReader *reader;
+
+            // The raw map takes the image's domain
+            reader = iftOpenLabRowReader(img_path);
+            if(reader == NULL)
+                iftError("Raw maps require a .png, .jpg or .ppm image!", "main");
+
+            fobjsm = iftReadRawFImage(PARAM, reader->xsize, reader->ysize, 1);
+            iftCloseLabRowReader(&reader);
+        }
+        else fobjsm = iftReadFImageByExt(PARAM);
+
+        objsm = iftFImageToImage(fobjsm, 65535);
+    }
+    else { fobjsm = NULL; objsm = iftReadImageByExt(PARAM); }
+
+    if(iftIs3DImage(objsm)) iftError("Only 2D images are permitted!", "main");
+
+    PARAM = UAIArgsGet(argc, argv, "k");
+    if(PARAM == NULL) iftError("No superpixel quantity was given!", "main");
+    k = atoi(PARAM);
+
+    if(k <= 1) iftError("Invalid quantity of superpixels!", "main");
+
+    PARAM = UAIArgsGet(argc, argv, "labels");
+    if(PARAM == NULL) iftError("No output path was given!", "main");
+
+    // 2. Graph Creation -------------------------------------------------------
+    iftImage *mask;
+    iftIGraph *graph;
+
+    if(UAIArgsExists(argc, argv, "mask"))
+    {    
+        PARAM = UAIArgsGet(argc, argv, "mask");
+        if(PARAM == NULL) iftError("No mask path was given!", "main");
+        else mask = iftReadImageByExt(PARAM);
+        
+        iftVerifyImageDomains(objsm, mask, "main");
+    }
+    else mask = iftSelectImageDomain(objsm->xsize, objsm->ysize, objsm->zsize);
+
+    if(fobjsm != NULL)
+    {
+        graph = iftInitOISFIGraphByFileFloatSal(img_path, mask, fobjsm);
+        iftDestroyFImage(&fobjsm);
+    }
+    else graph = iftInitOISFIGraphByFile(img_path, mask, objsm);
+
+    if(UAIArgsExists(argc, argv, "qbits"))
+    {
+        int qbits;
+
+        PARAM = UAIArgsGet(argc, argv, "qbits");
+        if(PARAM == NULL)
+            iftError("No number of bits was given!", "main");
+        else qbits = atoi(PARAM);
+
+        if(qbits != 0 && qbits != 8 && qbits != 16)
+            iftError("Invalid number of bits!", "main");
+
+        if(qbits > 0) iftIGraphQuantizeFeats(graph, qbits);
+    }
+
+    if(UAIArgsExists(argc, argv, "order"))
+    {
+        PARAM = UAIArgsGet(argc, argv, "order");
+        if(PARAM == NULL)
+            iftError("No node order was given!", "main");
+        else if(iftCompareStrings(PARAM, "tiled"))
+            iftIGraphSetNodeOrder(graph, IFT_TILED_ORDER);
+        else if(iftCompareStrings(PARAM, "morton"))
+            iftIGraphSetNodeOrder(graph, IFT_MORTON_ORDER);
+        else if(!iftCompareStrings(PARAM, "raster"))
+            iftError("Invalid node order!", "main");
+    }
+    
+    // 3. ODIFF Sampling -------------------------------------------------------
+    iftIntArray *seeds;
+    float perc;
+
+    if(UAIArgsExists(argc, argv, "perc"))
+    {
+        PARAM = UAIArgsGet(argc, argv, "perc");
+        if(PARAM == NULL) 
+            iftError("No percentage value was given!", "main");
+        else perc = atof(PARAM);
+    
+        if(perc < 0.0 || perc > 1.0) 
+            iftError("Invalid percentage of object seeds!", "main");
+    }
+    else perc = 0.9;
+
+    seeds = iftODIFFSeeds(objsm, mask, k, perc);
+
+    iftDestroyImage(&objsm);
+    iftDestroyImage(&mask);
+
+    // 4. OISF Segmentation ----------------------------------------------------
+    int iters;
+    float alpha, beta, gamma;
+
+    if(UAIArgsExists(argc, argv, "alpha"))
+    {    
+        PARAM = UAIArgsGet(argc, argv, "alpha");
+        if(PARAM == NULL) 
+            iftError("No alpha value was given!", "main");
+        else alpha = atof(PARAM);
+    
+        if(alpha <= 0.0) iftError("Invalid alpha value!", "main");
+    }
+    else alpha = 0.5;
+
+    if(UAIArgsExists(argc, argv, "beta"))
+    {
+        PARAM = UAIArgsGet(argc, argv, "beta");
+        if(PARAM == NULL) 
+            iftError("No beta value was given!", "main");
+        else beta = atof(PARAM);
+    
+        if(beta <= 0.0) iftError("Invalid beta value!", "main");
+    }
+    else beta = 12;
+
+    if(UAIArgsExists(argc, argv, "gamma"))
+    {
+        PARAM = UAIArgsGet(argc, argv, "gamma");
+        if(PARAM == NULL) 
+            iftError("No gamma value was given!", "main");
+        else gamma = atof(PARAM);
+    
+        if(gamma <= 0.0) iftError("Invalid gamma value!", "main");
+    }
+    else gamma = 2.0;
+
+    if(UAIArgsExists(argc, argv, "iters"))
+    {
+        PARAM = UAIArgsGet(argc, argv, "iters");
+        if(PARAM == NULL)
+            iftError("No number of iterations was given!", "main");
+        else iters = atoi(PARAM);
+    
+        if(iters < 1) iftError("Invalid number of iterations!", "main");
+    }
+    else iters = 10;
+    iftOISFSeeds(graph, seeds, alpha, beta, gamma, iters);
+
+    iftDestroyIntArray(&seeds);
+
+    // 5. Write Labels ---------------------------------------------------------
+    iftImage *labels;
+
+    labels = iftIGraphLabel(graph);
+
+    iftWriteImageByExt(labels, UAIArgsGet(argc, argv, "labels"));
+
+    if(UAIArgsExists(argc, argv, "ovlay"))
+    {
+        iftColor RGB;
+        iftImage *img;
+        iftAdjRel *A;
+        iftBMap *border;
+
+        PARAM = UAIArgsGet(argc, argv, "ovlay");
+        if(PARAM == NULL)
+            iftError("No overlayed image path was given!", "main");
+        
+        A = iftCircular(1.0);
+
+        border = iftBorderBMap(labels, A);
+
+        RGB.val[0] = RGB.val[1] = RGB.val[2] = 0;
+
+        img = iftReadImageByExt(UAIArgsGet(argc, argv, "img"));
+        iftDrawBorderBMap(img, border, RGB, A, 1.0);
+        iftWriteImageByExt(img, PARAM);
+
+        iftDestroyImage(&img);
+        iftDestroyBMap(&border);
+        iftDestroyAdjRel(&A);
+    }
+
+    iftDestroyImage(&labels);
+    iftDestroyIGraph(&graph);
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -10,9 +10,9 @@
     "  ./iftOISF_OSMOX [parameters]\n"\
     "\nRequired parameters:\n"\
     "  --img=STR      Path to the input image (.png, .jpg, .pgm, .ppm)\n"\
-    "  --objsm=STR    Path to the object saliency map image (.png, .jpg, .pgm)\n"\
+    "  --objsm=STR    Path to the object saliency map image (.png, .jpg, .pgm, .pfm, .raw)\n"\
     "  --k=INT        Desired number of superpixels (k > 1)\n"\
-    "  --labels=STR   Path to the output label image (.png, .jpg, .pgm)\n"\
+    "  --labels=STR   Path to the output label image (.png, .jpg, .pgm, .lbl)\n"\
     "\nOptional parameters for OSMOX:\n"\
     "  --perc=FLT     Object seeds' percentage (0 <= perc <= 1, default:0.9)\n"\
     "  --std=FLT      Seed proximity factor (std > 0, default:6.0)\n"\
@@ -21,6 +21,8 @@
     "  --beta=FLT     Boundary adherence factor (beta > 0, default:12.0)\n"\
     "  --gamma=FLT    Saliency map confidence factor (gamma > 0, default:2.0)\n"\
     "  --iters=INT    Number of iterations for segmentation (iters > 0, default:10)\n"\
+    "  --qbits=INT    Bits of the quantized graph features (0, 8 or 16, default:0)\n"\
+    "  --order=STR    Node layout of the graph (raster, tiled or morton, default:raster)\n"\
     "\nOther optional parameters:\n"\
     "  --mask=STR     Mask for delimiting a ROI (.png, .jpg, .pgm)\n"\
     "  --ovlay=STR    Path to the output image with overlayed borders (.png, .jpg, .pgm, .ppm)\n"\
@@ -32,7 +34,9 @@ int main(int argc, char const *argv[])
     // 1. Input Validation -----------------------------------------------------
     bool has_required;
     int k;
-    iftImage *img, *objsm;
+    iftImage *objsm;
+    iftFImage *fobjsm;
+    const char *img_path;
     
     has_required = UAIArgsExists(argc, argv, "img") &&
                    UAIArgsExists(argc, argv, "objsm") &&
@@ -46,15 +50,34 @@ int main(int argc, char const *argv[])
 
     PARAM = UAIArgsGet(argc, argv, "img");
     if(PARAM == NULL) iftError("No image was given!", "main");
-    img = iftReadImageByExt(PARAM);
-
-    if(iftIs3DImage(img)) iftError("Only 2D images are permitted!", "main");
+    img_path = PARAM; // decoded while the graph is built
 
     PARAM = UAIArgsGet(argc, argv, "objsm");
     if(PARAM == NULL) iftError("No object saliency map was given!", "main");
-    objsm = iftReadImageByExt(PARAM);
 
-    iftVerifyImageDomains(img, objsm, "main");
+    // Float maps (e.g., raw 32-bit floats of the image's size) feed the graph
+    // at full precision, and the samplers with 16 bits
+    if(iftEndsWith(PARAM, ".pfm") || iftEndsWith(PARAM, ".raw"))
+    {
+        if(iftEndsWith(PARAM, ".raw"))
+        {
+            iftLabRowReader *reader;
+
+            // The raw map takes the image's domain
+            reader = iftOpenLabRowReader(img_path);
+            if(reader == NULL)
+                iftError("Raw maps require a .png, .jpg or .ppm image!", "main");
+
+            fobjsm = iftReadRawFImage(PARAM, reader->xsize, reader->ysize, 1);
+            iftCloseLabRowReader(&reader);
+        }
+        else fobjsm = iftReadFImageByExt(PARAM);
+
+        objsm = iftFImageToImage(fobjsm, 65535);
+    }
+    else { fobjsm = NULL; objsm = iftReadImageByExt(PARAM); }
+
+    if(iftIs3DImage(objsm)) iftError("Only 2D images are permitted!", "main");
 
     PARAM = UAIArgsGet(argc, argv, "k");
     if(PARAM == NULL) iftError("No superpixel quantity was given!", "main");
@@ -75,14 +98,47 @@ int main(int argc, char const *argv[])
         if(PARAM == NULL) iftError("No mask path was given!", "main");
         else mask = iftReadImageByExt(PARAM);
         
-        iftVerifyImageDomains(img, mask, "main");
+        iftVerifyImageDomains(objsm, mask, "main");
+    }
+    else mask = iftSelectImageDomain(objsm->xsize, objsm->ysize, objsm->zsize);
+
+    if(fobjsm != NULL)
+    {
+        graph = iftInitOISFIGraphByFileFloatSal(img_path, mask, fobjsm);
+        iftDestroyFImage(&fobjsm);
     }
-    else mask = iftSelectImageDomain(img->xsize, img->ysize, img->zsize);
+    else graph = iftInitOISFIGraphByFile(img_path, mask, objsm);
 
-    graph = iftInitOISFIGraph(img, mask, objsm);
+    if(UAIArgsExists(argc, argv, "qbits"))
+    {
+        int qbits;
+
+        PARAM = UAIArgsGet(argc, argv, "qbits");
+        if(PARAM == NULL)
+            iftError("No number of bits was given!", "main");
+        else qbits = atoi(PARAM);
+
+        if(qbits != 0 && qbits != 8 && qbits != 16)
+            iftError("Invalid number of bits!", "main");
+
+        if(qbits > 0) iftIGraphQuantizeFeats(graph, qbits);
+    }
+
+    if(UAIArgsExists(argc, argv, "order"))
+    {
+        PARAM = UAIArgsGet(argc, argv, "order");
+        if(PARAM == NULL)
+            iftError("No node order was given!", "main");
+        else if(iftCompareStrings(PARAM, "tiled"))
+            iftIGraphSetNodeOrder(graph, IFT_TILED_ORDER);
+        else if(iftCompareStrings(PARAM, "morton"))
+            iftIGraphSetNodeOrder(graph, IFT_MORTON_ORDER);
+        else if(!iftCompareStrings(PARAM, "raster"))
+            iftError("Invalid node order!", "main");
+    }
     
     // 3. OSMOX Sampling -------------------------------------------------------
-    iftImage *seed_img;
+    iftIntArray *seeds;
     float perc, std;
 
     if(UAIArgsExists(argc, argv, "perc"))
@@ -108,7 +164,7 @@ int main(int argc, char const *argv[])
     } 
     else std = 6.0;
 
-    seed_img = iftOSMOX(objsm, mask, k, perc, std);
+    seeds = iftOSMOXSeeds(objsm, mask, k, perc, std);
 
     iftDestroyImage(&objsm);
     iftDestroyImage(&mask);
@@ -160,9 +216,9 @@ int main(int argc, char const *argv[])
         if(iters < 1) iftError("Invalid number of iterations!", "main");
     }
     else iters = 10;
-    iftOISF(graph, seed_img, alpha, beta, gamma, iters);
+    iftOISFSeeds(graph, seeds, alpha, beta, gamma, iters);
 
-    iftDestroyImage(&seed_img);
+    iftDestroyIntArray(&seeds);
 
     // 5. Write Labels ---------------------------------------------------------
     iftImage *labels;
@@ -173,10 +229,10 @@ int main(int argc, char const *argv[])
 
     if(UAIArgsExists(argc, argv, "ovlay"))
     {
-        int norm_value;
-        iftColor RGB, YCbCr;
+        iftColor RGB;
+        iftImage *img;
         iftAdjRel *A;
-        iftImage *added;
+        iftBMap *border;
 
         PARAM = UAIArgsGet(argc, argv, "ovlay");
         if(PARAM == NULL)
@@ -184,20 +240,19 @@ int main(int argc, char const *argv[])
         
         A = iftCircular(1.0);
 
-        added = iftAddValue(labels, 1);
+        border = iftBorderBMap(labels, A);
 
-        norm_value = iftNormalizationValue(iftMaximumValue(img));
         RGB.val[0] = RGB.val[1] = RGB.val[2] = 0;
-        YCbCr = iftRGBtoYCbCr(RGB, norm_value);
 
-        iftDrawBorders(img, labels, A, YCbCr, A);
+        img = iftReadImageByExt(UAIArgsGet(argc, argv, "img"));
+        iftDrawBorderBMap(img, border, RGB, A, 1.0);
         iftWriteImageByExt(img, PARAM);
 
-        iftDestroyImage(&added);
+        iftDestroyImage(&img);
+        iftDestroyBMap(&border);
         iftDestroyAdjRel(&A);
     }
 
-    iftDestroyImage(&img);
     iftDestroyImage(&labels);
     iftDestroyIGraph(&graph);
 
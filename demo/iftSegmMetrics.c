@@ -0,0 +1,65 @@
+#include "ift.h"
+#include "iftMetrics.h"
+
+#define UAI_ARGS_SOURCE
+#include "UAIArgs.h"
+
+#define HELP_MSG \
+    "This is a program for evaluating a segmentation against its ground-truth. Usage:\n\n"\
+    "  ./iftSegmMetrics [parameters]\n"\
+    "\nRequired parameters:\n"\
+    "  --labels=STR   Path to the segmentation label image (.png, .pgm, .lbl)\n"\
+    "  --gt=STR       Path to the ground-truth label image (.png, .pgm)\n"\
+    "\nOptional parameters:\n"\
+    "  --tol=FLT      Boundary recall tolerance (tol >= 0, default:2.0)\n"\
+    "  --help         Prints this message\n"\
+    "\nOutput (one per line): BR, UE, ASA and CO\n"
+
+int main(int argc, char const *argv[])
+{
+    const char *PARAM;
+    // 1. Input Validation -----------------------------------------------------
+    bool has_required;
+    float tol;
+    iftImage *labels, *gt;
+
+    has_required = UAIArgsExists(argc, argv, "labels") &&
+                   UAIArgsExists(argc, argv, "gt");
+    if(!has_required || UAIArgsExists(argc, argv, "help"))
+    {
+        puts(HELP_MSG);
+        exit(EXIT_FAILURE);
+    }
+
+    PARAM = UAIArgsGet(argc, argv, "labels");
+    if(PARAM == NULL) iftError("No label image was given!", "main");
+    labels = iftReadImageByExt(PARAM);
+
+    PARAM = UAIArgsGet(argc, argv, "gt");
+    if(PARAM == NULL) iftError("No ground-truth image was given!", "main");
+    gt = iftReadImageByExt(PARAM);
+
+    iftVerifyImageDomains(labels, gt, "main");
+
+    if(UAIArgsExists(argc, argv, "tol"))
+    {
+        PARAM = UAIArgsGet(argc, argv, "tol");
+        if(PARAM == NULL)
+            iftError("No tolerance value was given!", "main");
+        else tol = atof(PARAM);
+
+        if(tol < 0.0) iftError("Invalid tolerance value!", "main");
+    }
+    else tol = 2.0;
+
+    // 2. Evaluation -----------------------------------------------------------
+    printf("BR  %f\n", iftBoundaryRecall(labels, gt, tol));
+    printf("UE  %f\n", iftUnderSegmentationError(labels, gt));
+    printf("ASA %f\n", iftAchievableSegmentationAccuracy(labels, gt));
+    printf("CO  %f\n", iftCompactness(labels));
+
+    iftDestroyImage(&labels);
+    iftDestroyImage(&gt);
+
+    return EXIT_SUCCESS;
+}
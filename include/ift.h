@@ -10,53 +10,6 @@
 extern "C" {
 #endif
 
-// ---------- iftGQueue.h start 
-
-#define MINVALUE   0
-#define MAXVALUE   1
-#define FIFOBREAK  0
-#define LIFOBREAK  1
-#define IFT_QSIZE      65536
-#define iftSetTieBreak(a,b) a->C.tiebreak=b
-#define iftSetRemovalPolicy(a,b) a->C.removal_policy=b
-
-typedef struct ift_gqnode {
-    int  next;
-    int  prev;
-    char color;
-} iftGQNode;
-
-typedef struct ift_gdoublylinkedlists {
-    iftGQNode *elem;
-    int nelems;
-    int *value;
-} iftGDoublyLinkedLists;
-
-typedef struct ift_gcircularqueue {
-    int  *first;
-    int  *last;
-    int  nbuckets;
-    int  minvalue;
-    int  maxvalue;
-    char tiebreak;
-    char removal_policy;
-} iftGCircularQueue;
-
-typedef struct ift_gqueue {
-    iftGCircularQueue C;
-    iftGDoublyLinkedLists L;
-} iftGQueue;
-
-iftGQueue *iftCreateGQueue(int nbuckets, int nelems, int *value);
-void   iftDestroyGQueue(iftGQueue **Q);
-int    iftEmptyGQueue(iftGQueue *Q);
-void   iftInsertGQueue(iftGQueue **Q, int elem);
-int    iftRemoveGQueue(iftGQueue *Q);
-void   iftRemoveGQueueElem(iftGQueue *Q, int elem);
-void iftResetGQueue(iftGQueue *Q);
-iftGQueue *iftGrowGQueue(iftGQueue **Q, int nbuckets);
-
-// ---------- iftGQueue.h end 
 // ---------- iftBasicDataTypes.h start 
 
 #include <ctype.h>
@@ -102,6 +55,18 @@ typedef long long llong;
 typedef unsigned long long ullong;
 #endif
 
+/* Voxel indexes and image sizes. They are int by default, which keeps
+   the images, queues and graphs compact, and 64-bit integers when the
+   library is built with IFT_LARGE_INDEX (see the Makefile), for volumes
+   above 2^31 voxels. */
+#ifdef IFT_LARGE_INDEX
+typedef long long iftIdx;
+#define IFT_IDX_MAX LLONG_MAX
+#else
+typedef int iftIdx;
+#define IFT_IDX_MAX INT_MAX
+#endif
+
 typedef enum ift_cdata_type {
     IFT_UNTYPED, IFT_BOOL_TYPE, IFT_CHAR_TYPE, IFT_UCHAR_TYPE, IFT_STR_TYPE, IFT_SHORT_TYPE, IFT_USHORT_TYPE,
     IFT_INT_TYPE, IFT_UINT_TYPE, IFT_LONG_TYPE, IFT_ULONG_TYPE, IFT_FLT_TYPE, IFT_DBL_TYPE, IFT_INT_ARRAY_TYPE,
@@ -235,16 +200,63 @@ void *iftGetPtrVal(iftGVal gval);
 void iftCopyVoxel(iftVoxel *src, iftVoxel *dst);
 
 // ---------- iftBasicDataTypes.h end
+// ---------- iftGQueue.h start 
+
+#define MINVALUE   0
+#define MAXVALUE   1
+#define FIFOBREAK  0
+#define LIFOBREAK  1
+#define IFT_QSIZE      65536
+#define iftSetTieBreak(a,b) a->C.tiebreak=b
+#define iftSetRemovalPolicy(a,b) a->C.removal_policy=b
+
+typedef struct ift_gqnode {
+    iftIdx next;
+    iftIdx prev;
+    char   color;
+} iftGQNode;
+
+typedef struct ift_gdoublylinkedlists {
+    iftGQNode *elem;
+    iftIdx nelems;
+    int *value;
+} iftGDoublyLinkedLists;
+
+typedef struct ift_gcircularqueue {
+    iftIdx *first;
+    iftIdx *last;
+    int  nbuckets;
+    int  minvalue;
+    int  maxvalue;
+    char tiebreak;
+    char removal_policy;
+} iftGCircularQueue;
+
+typedef struct ift_gqueue {
+    iftGCircularQueue C;
+    iftGDoublyLinkedLists L;
+} iftGQueue;
+
+iftGQueue *iftCreateGQueue(int nbuckets, iftIdx nelems, int *value);
+void   iftDestroyGQueue(iftGQueue **Q);
+int    iftEmptyGQueue(iftGQueue *Q);
+void   iftInsertGQueue(iftGQueue **Q, iftIdx elem);
+iftIdx iftRemoveGQueue(iftGQueue *Q);
+void   iftRemoveGQueueElem(iftGQueue *Q, iftIdx elem);
+void iftResetGQueue(iftGQueue *Q);
+iftGQueue *iftGrowGQueue(iftGQueue **Q, int nbuckets);
+
+// ---------- iftGQueue.h end 
 // ---------- iftIntArray.h start
 
 struct ift_int_array {
     long n;
-    int *val;
+    iftIdx *val; /* int, unless built with IFT_LARGE_INDEX */
 };
 
 iftIntArray *iftCreateIntArray(long n);
 void iftDestroyIntArray(iftIntArray **iarr);
-void iftShuffleIntArray(int* array, int n);
+void iftShuffleIntArray(iftIdx* array, long n);
 
 // ---------- iftIntArray.h end
 // ---------- iftFloatArray.h start 
@@ -473,6 +485,15 @@ static inline iftFColor iftRGBtoLab(iftColor rgb, int normalization_value)
     return lab;
 }
 iftFColor iftRGBtoLabNorm(iftColor rgb, int normalization_value);
+/* Fast iftRGBtoLabNorm for a row of n pixels, given as interleaved samples
+   of nchannels each (8-bit, or 16-bit big endian when wide), into n CIELAB
+   triplets. With normalization values 255 and 65535, it uses linearization
+   tables, a float cube root by Halley steps and, when built with
+   IFT_AVX2=YES, 8 pixels per AVX2 batch; over all 2^24 8-bit colors, it is
+   within 2e-4 (L, a and b) of iftRGBtoLabNorm. Other values fall back to
+   the latter. */
+void iftRGBRowToLabNorm(const uchar *row, int n, int nchannels, bool wide,
+                        int normalization_value, float *lab);
 static inline iftFColor iftRGBtoLabNorm2(iftColor rgb, int normalization_value)
 {
     /* get lab values*/
@@ -500,46 +521,74 @@ iftColor  iftHSVtoRGB(iftColor cin, int normalization_value);
 
 typedef struct ift_dheap {
     double *value;
-    char  *color;
-    int   *node;
-    int   *pos;
-    int    last;
-    int    n;
+    char   *color;
+    iftIdx *node;
+    iftIdx *pos;
+    iftIdx  last;
+    iftIdx  n;
     char removal_policy;
 } iftDHeap;
 
-iftDHeap *iftCreateDHeap(int n, double *value);
+iftDHeap *iftCreateDHeap(iftIdx n, double *value);
 void      iftDestroyDHeap(iftDHeap **H);
 char      iftFullDHeap(iftDHeap *H);
 char      iftEmptyDHeap(iftDHeap *H);
-char      iftInsertDHeap(iftDHeap *H, int pixel);
-int       iftRemoveDHeap(iftDHeap *H);
-void      iftRemoveDHeapElem(iftDHeap *H, int pixel);
-void      iftGoUpDHeap(iftDHeap *H, int i);
-void      iftGoDownDHeap(iftDHeap *H, int i);
+char      iftInsertDHeap(iftDHeap *H, iftIdx pixel);
+iftIdx    iftRemoveDHeap(iftDHeap *H);
+void      iftRemoveDHeapElem(iftDHeap *H, iftIdx pixel);
+void      iftGoUpDHeap(iftDHeap *H, iftIdx i);
+void      iftGoDownDHeap(iftDHeap *H, iftIdx i);
 void      iftResetDHeap(iftDHeap *H);
 
 // ---------- iftDHeap.h end
 // ---------- iftFIFO.h start 
 
 typedef struct ift_fifo {
-    int *FIFO;
-    int n;
-    int first;
-    int last;
+    iftIdx *FIFO;
+    iftIdx n;
+    iftIdx first;
+    iftIdx last;
     char *color;
 } iftFIFO;
 
-iftFIFO *iftCreateFIFO(int n);
+iftFIFO *iftCreateFIFO(iftIdx n);
 void iftDestroyFIFO(iftFIFO **F);
-char iftInsertFIFO(iftFIFO *F, int elem);
-int iftRemoveFIFO(iftFIFO *F);
+char iftInsertFIFO(iftFIFO *F, iftIdx elem);
+iftIdx iftRemoveFIFO(iftFIFO *F);
 bool iftFullFIFO(iftFIFO *F);
 bool iftEmptyFIFO(iftFIFO *F);
 void iftResetFIFO(iftFIFO *F);
-int iftColorFIFO(iftFIFO *F, int pos);
+int iftColorFIFO(iftFIFO *F, iftIdx pos);
 
 // ---------- iftFIFO.h end
+// ---------- iftStack.h start
+
+/* LIFO of integers, over an array which grows on demand */
+typedef struct ift_stack {
+    iftIdx *val;
+    iftIdx n;
+    iftIdx capacity;
+} iftStack;
+
+iftStack *iftCreateStack(iftIdx capacity);
+void iftDestroyStack(iftStack **S);
+void iftGrowStack(iftStack *S);
+static inline void iftPushStack(iftStack *S, iftIdx elem) {
+    if (S->n == S->capacity)
+        iftGrowStack(S);
+    S->val[S->n++] = elem;
+}
+static inline iftIdx iftPopStack(iftStack *S) {
+    return S->val[--S->n];
+}
+static inline bool iftEmptyStack(const iftStack *S) {
+    return (S->n == 0);
+}
+static inline void iftResetStack(iftStack *S) {
+    S->n = 0;
+}
+
+// ---------- iftStack.h end
 // ---------- iftFile.h start
 
 #if defined(__WIN32) || defined(__WIN64)
@@ -602,8 +651,8 @@ typedef struct ift_image {
     float dx;
     float dy;
     float dz;
-    int *tby, *tbz;
-    int n;
+    iftIdx *tby, *tbz;
+    iftIdx n;
 } iftImage;
 
 iftImage *iftReadImageByExt(const char *filename, ...);
@@ -619,23 +668,58 @@ int iftMinimumValue(const iftImage *img);
 static inline bool iftIs3DImage(const iftImage *img) {
     return (img->zsize > 1);
 }
-iftVoxel iftGetVoxelCoord(const iftImage *img, int p);
+iftVoxel iftGetVoxelCoord(const iftImage *img, iftIdx p);
 iftImage *iftSelectImageDomain(int xsize, int ysize, int zsize);
 iftBoundingBox iftMinBoundingBox(const iftImage *img, iftVoxel *gc_out);
+/* Crop support: iftMaskROIBoundingBox returns true when the non-zero
+   voxels of the mask lie in a bounding box smaller than its domain (i.e.,
+   cropping pays off); iftExtractROI copies such box into a new image;
+   iftInsertROI pastes an image back with its first voxel at begin; and
+   iftROIIndexesToImage converts voxel indexes of the ROI to the image. */
+bool iftMaskROIBoundingBox(const iftImage *mask, iftBoundingBox *bb);
+iftImage *iftExtractROI(const iftImage *img, iftBoundingBox bb);
+void iftInsertROI(const iftImage *roi, iftImage *target, iftVoxel begin);
+void iftROIIndexesToImage(iftIntArray *idx, const iftImage *roi, iftVoxel begin, const iftImage *img);
 iftImage *iftReadImage(const char *filename, ...);
 iftImage* iftReadImagePNG(const char* format, ...);
 iftImage* iftReadImageJPEG(const char* format, ...);
+/* Decodes at 1/scale_denom (1, 2, 4 or 8) of the size within libjpeg's
+   IDCT, which is much cheaper than a full decode followed by downsampling
+   (e.g., for previews or the coarse levels of a pyramid). The sizes are
+   rounded up. */
+iftImage *iftReadScaledImageJPEG(int scale_denom, const char *format, ...);
 iftImage *iftReadImageP5(const char *filename, ...);
 iftImage *iftReadImageP6(const char *filename, ...);
 iftImage *iftReadImageP2(const char *filename, ...);
 iftImage  *iftCreateImageFromBuffer(int xsize,int ysize,int zsize, int *val);
+/* Image of the given domain (sizes, voxel size 1 and the row/slice tables)
+   without voxel values, i.e., its val is NULL */
+iftImage  *iftCreateImageDomain(int xsize,int ysize,int zsize);
 void iftCopyImageInplace(const iftImage *src, iftImage *dst);
 void iftWriteImage(const iftImage *img, const char *filename, ...);
 void iftWriteImageP5(const iftImage *img, const char *filename, ...);
 void iftWriteImageP6(const iftImage *img, const char *filename, ...);
 void iftWriteImageP2(const iftImage *img, const char *filename, ...);
 void iftWriteImagePNG(const iftImage* img, const char* format, ...);
+/* Same as iftWriteImagePNG, but the rows are filtered and deflated in
+   groups of about 1 MB concurrently, as independent zlib (deflate) streams
+   stitched into a single valid IDAT sequence. The level is zlib's (0 to 9,
+   Z_DEFAULT_COMPRESSION being 6), and the filter is one of the PNG types
+   below, or the adaptive choice per row (as libpng's default). */
+#define IFT_PNG_FILTER_NONE     0
+#define IFT_PNG_FILTER_SUB      1
+#define IFT_PNG_FILTER_UP       2
+#define IFT_PNG_FILTER_AVG      3
+#define IFT_PNG_FILTER_PAETH    4
+#define IFT_PNG_FILTER_ADAPTIVE 5
+void iftWriteImagePNGParallel(const iftImage *img, int level, int filter, const char *format, ...);
 void iftWriteImageJPEG(const iftImage* img, const char* format, ...);
+/* Label maps (.lbl, also through iftReadImageByExt/iftWriteImageByExt):
+   the raster-order runs of equal labels, each as the label, in 8, 16 or 32
+   bits (as the maximum label requires), and its LEB128 length, optionally
+   deflated by zlib. Labels must be non-negative. */
+void iftWriteLabelImage(const iftImage *label, bool compress, const char *format, ...);
+iftImage *iftReadLabelImage(const char *format, ...);
 int iftMaximumValueInRegion(const iftImage *img, iftBoundingBox bb);
 void iftSetImage(iftImage *img, int value);
 void  iftSetAlpha(iftImage *img, ushort value);
@@ -646,7 +730,7 @@ static inline long iftMaxImageRange(uchar img_depth) {
     return (1L << (img_depth)) - 1; // 2^img_depth -1
 }
 void iftMinMaxValues(const iftImage *img, int *min, int *max);
-int iftNumberOfElements(const iftImage *mask);
+iftIdx iftNumberOfElements(const iftImage *mask);
 iftImage *iftImageGradientMagnitude(const iftImage *img, iftAdjRel *Ain);
 iftImage *iftCreateImageFromImage(const iftImage *src);
 iftImage *iftCreateColorImage(int xsize, int ysize, int zsize, int depth);
@@ -666,14 +750,25 @@ typedef struct ift_fimage {
   float *val;
   int    xsize,ysize,zsize;
   float  dx,dy,dz;
-  int   *tby, *tbz;
-  int    n;
+  iftIdx *tby, *tbz;
+  iftIdx  n;
+  void  *map;      /* file mapping holding val (see iftReadRawFImage), or NULL */
+  size_t map_size;
 } iftFImage;
 
 iftFImage *iftCreateFImage(int xsize,int ysize,int zsize);
 void iftDestroyFImage(iftFImage **img);
-iftVoxel    iftFGetVoxelCoord(const iftFImage *img, int p);
+iftVoxel    iftFGetVoxelCoord(const iftFImage *img, iftIdx p);
 char iftFValidVoxel(const iftFImage *img, iftVoxel v);
+/* Float maps (e.g., saliency maps straight from a network, without
+   quantization): iftReadRawFImage memory-maps a headerless buffer of
+   native float32 values in raster order, whose dimensions are given;
+   iftReadFImageByExt reads gray .pfm files, and the other formats through
+   iftReadImageByExt (e.g., 16-bit .png); and iftFImageToImage linearly
+   maps [min,max] to [0,Imax]. */
+iftFImage *iftReadRawFImage(const char *filename, int xsize, int ysize, int zsize);
+iftFImage *iftReadFImageByExt(const char *filename, ...);
+iftImage *iftFImageToImage(const iftFImage *img, int Imax);
 
 // ---------- iftFImage.h end 
 // ---------- iftGraphics.h start
@@ -686,7 +781,7 @@ void iftDrawBordersSingleLabel(iftImage *img, iftImage *labelMap, const int labe
 // ---------- iftMatrix.h start 
 
 typedef struct ift_matrix {
-    int nrows;
+    iftIdx nrows;
     int ncols;
     long n;
     float *val;
@@ -700,7 +795,7 @@ struct ift_str_matrix {
     int n;
 };
 
-iftMatrix *iftCreateMatrix(int ncols, int nrows);
+iftMatrix *iftCreateMatrix(int ncols, iftIdx nrows);
 iftMatrix *iftCopyMatrix(const iftMatrix *A);
 void iftDestroyMatrix(iftMatrix **M);
 void iftDestroyStrMatrix(iftStrMatrix **sM);
@@ -721,8 +816,9 @@ typedef struct ift_mimage {
     float **val;
     int xsize,ysize,zsize;
     float dx,dy,dz; 
-    int *tby, *tbz;
-    int n,m;
+    iftIdx *tby, *tbz;
+    iftIdx n;
+    int m;
 } iftMImage;
 
 #define iftMGetVoxelIndex(s,v) ((v.x)+(s)->tby[(v.y)]+(s)->tbz[(v.z)])
@@ -731,6 +827,32 @@ iftMImage  *iftCreateMImage(int xsize,int ysize,int zsize, int nbands);
 void iftDestroyMImage(iftMImage **img);
 iftMImage *iftImageToMImage(const iftImage *img, char color_space);
 iftImage *iftMImageToImage(const iftMImage *img, int Imax, int band);
+/* Reads a .png, .jpg or .ppm color image straight into CIELAB bands (as
+   LABNorm_CSPACE, but from the decoded RGB rather than through the YCbCr
+   planes of an iftImage); grayscale images yield their GRAY_CSPACE band,
+   and the other formats go through iftReadImageByExt. iftMExtractROI is
+   the multiband counterpart of iftExtractROI. */
+iftMImage *iftReadLabMImageByExt(const char *filename, ...);
+/* Row-by-row counterpart of iftReadLabMImageByExt, for consumers that
+   never hold the whole image (e.g., iftInitOISFIGraphByFile): each call of
+   iftReadLabRow decodes the next row into xsize*nbands floats. Rows may be
+   left unread. iftOpenLabRowReader returns NULL for the formats that the
+   generic path handles. */
+typedef struct ift_lab_row_reader {
+    int   xsize, ysize;
+    int   nbands;  /* 3 (CIELAB) or 1 (gray) */
+    int   y;       /* next row */
+    void *state;   /* decoder */
+} iftLabRowReader;
+
+iftLabRowReader *iftOpenLabRowReader(const char *filename);
+/* Reads the rows of a caller-owned 8-bit buffer of interleaved gray (1),
+   RGB (3) or RGBA (4) samples, whose rows lie stride bytes apart, in
+   place; the buffer must outlive the reader. */
+iftLabRowReader *iftOpenLabRowReaderByBuffer(const uchar *buf, int xsize, int ysize, int nchannels, long stride);
+void iftReadLabRow(iftLabRowReader *reader, float *lab);
+void iftCloseLabRowReader(iftLabRowReader **reader);
+iftMImage *iftMExtractROI(const iftMImage *img, iftBoundingBox bb);
 iftImage *iftGridSampling(iftMImage *img, iftImage *mask, int nsamples);
 iftImage *iftAltMixedSampling(iftMImage *img, iftImage *mask, int nsamples);
 static inline bool iftIs3DMImage(const iftMImage *img) {
@@ -738,11 +860,87 @@ static inline bool iftIs3DMImage(const iftMImage *img) {
 }
 iftImage   *iftBorderProbImage(iftMImage *img);
 iftImage   *iftMImageBasins(const iftMImage *img, iftAdjRel *A);
-iftVoxel    iftMGetVoxelCoord(const iftMImage *img, int p);
+iftVoxel    iftMGetVoxelCoord(const iftMImage *img, iftIdx p);
 char iftMValidVoxel(const iftMImage *img, iftVoxel v);
 float iftMMaximumValue(const iftMImage *img, int band);
 
 // ---------- iftMImage.h end
+// ---------- iftCompactImage.h start 
+
+/* Compact image: 8- or 16-bit samples (uchar or ushort, by nbits) of one
+   (gray) or three (interleaved RGB) bands, i.e., 1 to 6 bytes per pixel
+   instead of the 4 to 8 of iftImage. It is meant for the inputs (saliency
+   maps, masks, seed images) of the samplers, which widen only the mask's
+   bounding box to an iftImage (e.g., iftOSMOXSeedsByCompact). */
+typedef struct ift_compact_image {
+    void  *val;
+    int    nbits;
+    int    nbands;
+    int    xsize, ysize, zsize;
+    float  dx, dy, dz;
+    iftIdx n;
+    bool   swap;     /* 16-bit samples are byte-swapped on access (e.g., the
+                        big-endian data of a mapped PNM file) */
+    void  *map;      /* file mapping holding val (see iftMapCompactImage) */
+    size_t map_size;
+    bool   borrowed; /* val is owned by the caller (see iftWrapCompactImage) */
+} iftCompactImage;
+
+/* i-th sample, i.e., band b of pixel p at i = p*nbands + b. The 16-bit
+   samples are moved by memcpy, since a mapped file (or a wrapped buffer)
+   may place them at an odd address, e.g., after the header "P5\n512
+   512\n65535\n"; compilers still emit a single load or store. */
+static inline int iftCompactSample(const iftCompactImage *img, iftIdx i) {
+    ushort v;
+
+    if (img->nbits == 8) return ((const uchar *)img->val)[i];
+    memcpy(&v, (const uchar *)img->val + 2*i, sizeof(ushort));
+    return img->swap ? (ushort)((v << 8) | (v >> 8)) : v;
+}
+static inline void iftSetCompactSample(iftCompactImage *img, iftIdx i, int v) {
+    ushort w;
+
+    if (img->nbits == 8) { ((uchar *)img->val)[i] = (uchar)v; return; }
+    if (img->swap) w = (ushort)(((v & 0xff) << 8) | ((v >> 8) & 0xff));
+    else w = (ushort)v;
+    memcpy((uchar *)img->val + 2*i, &w, sizeof(ushort));
+}
+
+iftCompactImage *iftCreateCompactImage(int xsize, int ysize, int zsize, int nbands, int nbits);
+void iftDestroyCompactImage(iftCompactImage **img);
+/* Reads .png, .pgm (P5), .ppm and .jpg files straight into their 8- or
+   16-bit samples; the other formats go through iftReadImageByExt. */
+iftCompactImage *iftReadCompactImageByExt(const char *filename, ...);
+/* Maps a .scn (8 or 16 bits), .pgm (P5) or .ppm (P6) file into memory,
+   pointing val at its pixel data: pages are read on first access, and
+   copied only when written. Hence, opening a large volume costs neither a
+   read nor a copy, and only the regions widened by iftCompactROIToImage
+   (or iftCompactImageToImage) are converted to int. */
+iftCompactImage *iftMapCompactImage(const char *filename, ...);
+/* Wraps a caller-owned buffer of packed samples (e.g., a saliency map or a
+   mask of an embedding application) without copying it; the buffer must
+   outlive the image, and iftDestroyCompactImage leaves it untouched. */
+iftCompactImage *iftWrapCompactImage(void *data, int xsize, int ysize, int zsize, int nbands, int nbits);
+/* Conversions from/to iftImage (color images as RGB bands); the values of a
+   gray image must lie in [0,65535], in as few bits as they fit. */
+iftCompactImage *iftImageToCompactImage(const iftImage *img);
+iftImage *iftCompactImageToImage(const iftCompactImage *img);
+void iftVerifyCompactImageDomains(const iftCompactImage *img1, const iftCompactImage *img2, const char *function);
+void iftCompactMinMaxValues(const iftCompactImage *img, int *min, int *max);
+/* Same as iftThreshold and iftComplement, for gray images (the result of
+   iftCompactThreshold has 8 bits when value fits in it) */
+iftCompactImage *iftCompactThreshold(const iftCompactImage *img, int lowest, int highest, int value);
+iftCompactImage *iftCompactComplement(const iftCompactImage *img);
+/* Mask handling, as iftMaskROIBoundingBox and iftExtractROI; and
+   iftCompactROIToImage widens the box (the whole image, if bb is NULL)
+   to an iftImage, whose voxel indexes iftCompactROIIndexesToImage
+   converts back to the compact image. */
+bool iftCompactMaskROIBoundingBox(const iftCompactImage *mask, iftBoundingBox *bb);
+iftCompactImage *iftCompactExtractROI(const iftCompactImage *img, iftBoundingBox bb);
+iftImage *iftCompactROIToImage(const iftCompactImage *img, const iftBoundingBox *bb);
+void iftCompactROIIndexesToImage(iftIntArray *idx, const iftImage *roi, iftVoxel begin, const iftCompactImage *img);
+
+// ---------- iftCompactImage.h end
 // ---------- iftKernel.h start
 typedef struct ift_kernel {
   iftAdjRel *A;
@@ -755,6 +953,7 @@ void         iftDestroyKernel(iftKernel **K);
 // ---------- iftMemory.h start 
 
 int *iftAllocIntArray(long n);
+iftIdx *iftAllocIdxArray(long n);
 void iftCopyIntArray(int *array_dst, const int *array_src, int nelems);
 #ifndef  __cplusplus
 long long *iftAllocLongLongIntArray(long n);
@@ -768,6 +967,11 @@ ushort *iftAllocUShortArray(long n);
 uchar *iftAllocUCharArray(long n);
 char *iftAllocCharArray(long n);
 char *iftAllocString(long n);
+/* Zeroed array, as iftAlloc, but whose pages are first touched by the
+   threads of a static OpenMP partition (NUMA placement), and advised as
+   transparent huge pages when built with IFT_HUGEPAGES. It is released
+   by iftFree. */
+void *iftAllocFirstTouch(long n, size_t size);
 #define iftSwap(x, y) do { __typeof__(x) _IFT_SWAP_ = x; x = y; y = _IFT_SWAP_; } while (0)
 
 // ---------- iftMemory.h end
@@ -784,21 +988,21 @@ iftFImage *iftWeightNormFactor(const iftFImage *weight, iftAdjRel *A);
 // ---------- iftSet.h start 
 
 typedef struct ift_set {
-    int elem;
+    iftIdx elem;
     struct ift_set *next;
 } iftSet;
 
-void iftInsertSet(iftSet **S, int elem);
-int iftRemoveSet(iftSet **S);
-void    iftRemoveSetElem(iftSet **S, int elem);
+void iftInsertSet(iftSet **S, iftIdx elem);
+iftIdx iftRemoveSet(iftSet **S);
+void    iftRemoveSetElem(iftSet **S, iftIdx elem);
 void    iftDestroySet(iftSet **S);
 iftSet* iftSetUnion(iftSet *S1,iftSet *S2);
 iftSet* iftSetConcat(iftSet *S1,iftSet *S2);
-char    iftUnionSetElem(iftSet **S, int elem);
+char    iftUnionSetElem(iftSet **S, iftIdx elem);
 void    iftInvertSet(iftSet **S);
 int 	iftSetSize(const iftSet* S);
 iftSet* iftSetCopy(iftSet* S);
-int     iftSetHasElement(iftSet *S, int elem);
+int     iftSetHasElement(iftSet *S, iftIdx elem);
 
 // ---------- iftSet.h end
 // ---------- iftSList.h start
@@ -870,6 +1074,22 @@ static inline void iftCopyData(void *dst, const void *src, size_t n, size_t chun
 char *iftGetLine(FILE *stream);
 
 // ---------- iftStream.h end
+// ---------- iftPool.h start
+
+/* Size-class pool of large buffers (e.g., image-sized ones). While it is
+   enabled, freed buffers are cached and handed back to the next request
+   of the same class, instead of being returned to the system. Stages
+   which repeatedly create and destroy temporaries opt in by enabling it
+   (calls may be nested). The buffers are plain heap blocks, so they may
+   be released by iftPoolFree with the pool either enabled or not. */
+void iftEnableBufferPool(void);
+void iftDisableBufferPool(void);
+void *iftPoolAlloc(size_t nbytes, bool zero);
+void iftPoolFree(void *buf, size_t nbytes);
+iftImage *iftCreatePooledImage(int xsize, int ysize, int zsize, bool zero);
+void iftDestroyPooledImage(iftImage **img);
+
+// ---------- iftPool.h end
 // ---------- iftString.h start 
 
 void iftRightTrim(char* s, char c);
@@ -891,47 +1111,107 @@ char *iftRemovePrefix(const char *str, const char *prefix);
 #define   EXPLICIT 1 /* graph with adjacency list of the nodes */
 #define   IMPLICIT 2 /* graph with translation-invariant adjacency relation */
 
+#define   IFT_RASTER_ORDER 0 /* nodes in raster order of their voxels */
+#define   IFT_TILED_ORDER  1 /* nodes in raster order of tiles, and of voxels within them */
+#define   IFT_MORTON_ORDER 2 /* nodes in Z-order (Morton order) of their voxels */
+#define   IFT_NODE_TILE    16 /* tile side, in voxels, of IFT_TILED_ORDER */
+
 typedef struct ift_inode {
-  int voxel; 
+  iftIdx voxel; 
   float weight;
   iftSet *adj;
 } iftINode;
 
 typedef struct ift_igraph {
   iftINode *node;
-  int nnodes;
+  iftIdx nnodes;
   int nfeats;
-  iftImage *index;
-  float **feat;
-  int *label, *marker, *root, *pred;
+  iftImage *index;     /* domain of the graph (its val is NULL, see nindex) */
+  iftIdx *nindex;      /* node of each voxel of the domain, or IFT_NIL */
+  float **feat;        /* node attributes, indexed by node (see index) */
+  int qbits;           /* 0, or 8/16 when the attributes are quantized into qfeat */
+  float qmin, qstep;   /* a quantized attribute q stands for qmin + q*qstep */
+  void *qfeat;         /* uchar or ushort attributes, nnodes x nfeats (feat is NULL) */
+  iftIdx *label, *root, *pred; /* root and pred are node indexes */
   double *pvalue;
   iftAdjRel *A;
   char type;
+  char order;          /* layout of the node attributes (see iftIGraphSetNodeOrder) */
+  iftIdx *raster;      /* nodes in raster order of their voxels, unless order is
+                          IFT_RASTER_ORDER (in which they are 0..nnodes-1) */
+  iftStack *stack[2]; /* scratch stacks of the tree removals */
+  struct ift_bitmap *inFrontier; /* scratch bitmap of the tree removal, kept clear */
+  iftVoxel origin;      /* position of the index domain within the frame */
+  iftImageDomain frame; /* domain of the image from which the graph was built */
 } iftIGraph;
 
+/* Node attribute access, for both the float and the quantized graphs */
+static inline float iftIGraphFeat(const iftIGraph *igraph, iftIdx s, int j) {
+    if (igraph->qbits == 8)
+        return igraph->qmin + igraph->qstep*((const uchar *)igraph->qfeat)[(long)s*igraph->nfeats+j];
+    if (igraph->qbits == 16)
+        return igraph->qmin + igraph->qstep*((const ushort *)igraph->qfeat)[(long)s*igraph->nfeats+j];
+    return igraph->feat[s][j];
+}
+
+/* Euclidean distance between the first n attributes of nodes s and t.
+   The quantized attributes are compared by integer kernels. */
+static inline float iftIGraphFeatDistance(const iftIGraph *igraph, iftIdx s, iftIdx t, int n) {
+    if (igraph->qbits == 8) {
+        const uchar *a = (const uchar *)igraph->qfeat + (long)s*igraph->nfeats;
+        const uchar *b = (const uchar *)igraph->qfeat + (long)t*igraph->nfeats;
+        int dist = 0;
+        for (int j = 0; j < n; j++)
+            dist += (a[j]-b[j])*(a[j]-b[j]);
+        return igraph->qstep*sqrtf((float)dist);
+    }
+    if (igraph->qbits == 16) {
+        const ushort *a = (const ushort *)igraph->qfeat + (long)s*igraph->nfeats;
+        const ushort *b = (const ushort *)igraph->qfeat + (long)t*igraph->nfeats;
+        llong dist = 0;
+        for (int j = 0; j < n; j++)
+            dist += (llong)(a[j]-b[j])*(a[j]-b[j]);
+        return igraph->qstep*sqrtf((float)dist);
+    }
+    return iftFeatDistance(igraph->feat[s], igraph->feat[t], n);
+}
+
 void iftIGraphEvalAndAssignNewSeeds
-(iftIGraph *igraph, int* center, int *seed, int nseeds, iftSet **trees_rm, iftSet **new_seeds );
-int *iftIGraphSuperpixelCenters(iftIGraph *igraph, int *seed, int nseeds);
-void iftIGraphSubTreeRemoval(iftIGraph *igraph, int s, double *pvalue, double INITIAL_PATH_VALUE, iftDHeap *Q);
-iftSet *iftIGraphTreeRemoval(iftIGraph *igraph, iftSet **trees_for_removal, double *pvalue, double INITIAL_PATH_VALUE);
+(iftIGraph *igraph, iftIdx *center, iftIdx *seed, iftIdx nseeds, iftStack *trees_rm, iftStack *new_seeds );
+iftIdx *iftIGraphSuperpixelCenters(iftIGraph *igraph, iftIdx *seed, iftIdx nseeds);
+void iftIGraphSubTreeRemoval(iftIGraph *igraph, iftIdx s, double *pvalue, double INITIAL_PATH_VALUE, iftDHeap *Q);
+void iftIGraphTreeRemoval(iftIGraph *igraph, iftStack *trees_for_removal, double *pvalue, double INITIAL_PATH_VALUE, iftStack *frontier);
+/* Creates the nodes of the mask's voxels with nfeats attributes, which are
+   left for the caller to fill (as iftMImageToIGraph does) */
+iftIGraph *iftCreateIGraph(const iftImage *mask, int nfeats);
 iftIGraph *iftMImageToIGraph(const iftMImage *img, const iftImage *mask);
 iftIGraph *iftImplicitIGraph(iftMImage *img, const iftImage *mask, iftAdjRel *A);
 void iftIGraphSetWeightForRegionSmoothing(iftIGraph *igraph, const iftImage *img);
 void iftIGraphSmoothRegions(iftIGraph *igraph, int num_smooth_iterations);
 void iftDestroyIGraph(iftIGraph **igraph);
+void iftIGraphSetFrame(iftIGraph *igraph, iftVoxel origin, int xsize, int ysize, int zsize);
+iftIdx iftIGraphFrameVoxelToNode(const iftIGraph *igraph, iftIdx p);
 iftImage *iftIGraphLabel(iftIGraph *igraph);
+/* Same as iftIGraphLabel, but into a caller-owned buffer of the frame's
+   rows (int32 or uint16, by nbits), which lie stride bytes apart. */
+void iftIGraphLabelToBuffer(const iftIGraph *igraph, void *label, int nbits, long stride);
 void iftIGraphSetFWeight(iftIGraph *igraph, iftFImage *weight);
 iftFImage *iftIGraphWeight(iftIGraph *igraph);
   float iftIGraphMaximumFeatureValue (iftIGraph * igraph, int feature);
+void iftIGraphQuantizeFeats(iftIGraph *igraph, int nbits);
+void iftIGraphSetNodeOrder(iftIGraph *igraph, char order);
 
 // ---------- iftIGraph.h end
 // ---------- iftSeeds.h start
 iftImage *iftFastLabelComp(const iftImage *bin, const iftAdjRel *Ain);
 iftIntArray * iftGridSamplingOnMask(const iftImage *bin_mask, float radius,
-                                   int initial_obj_voxel_idx, long n_samples);
-float iftEstimateGridOnMaskSamplingRadius(const iftImage *binMask, int initialObjVoxelIdx, int nSamples);
+                                   iftIdx initial_obj_voxel_idx, long n_samples);
+float iftEstimateGridOnMaskSamplingRadius(const iftImage *binMask, iftIdx initialObjVoxelIdx, int nSamples);
 iftSet * iftObjectBorderSet(const iftImage *label_img, iftAdjRel *Ain);
 iftImage * iftSelectKLargestRegionsAndPropagateTheirLabels(iftImage *label, iftAdjRel *A, int K);
+iftImage * iftSelectRegionsAboveAreaAndPropagateTheirLabels(iftImage *label, iftAdjRel *A, int min_area);
+iftIntArray *iftSeedImageToIntArray(const iftImage *seed_img);
+iftImage *iftIntArrayToSeedImage(const iftIntArray *seeds, int xsize, int ysize, int zsize);
 
 // ---------- iftSeeds.h end
 // ---------- iftDir.h start 
@@ -979,24 +1259,29 @@ void iftBucketSort(int *value, int *index, int nelems, uchar order);
 
 typedef struct ift_bitmap {
     char *val;
-    int nbytes;
-    int n;
+    iftIdx nbytes;
+    iftIdx n;
 } iftBMap;
 
-iftBMap *iftCreateBMap(int n);
+iftBMap *iftCreateBMap(iftIdx n);
 void iftDestroyBMap(iftBMap **bmap);
-static inline void iftBMapSet1(iftBMap *bmap, int b) {
+static inline void iftBMapSet1(iftBMap *bmap, iftIdx b) {
     bmap->val[b >> 3] |= (1 << (b & 0x07));
 }
-static inline bool iftBMapValue(const iftBMap *bmap, int b) {
+static inline void iftBMapSet0(iftBMap *bmap, iftIdx b) {
+    bmap->val[b >> 3] &= ~(1 << (b & 0x07));
+}
+static inline bool iftBMapValue(const iftBMap *bmap, iftIdx b) {
     return ((bmap->val[b >> 3] & (1 << (b & 0x07))) != 0);
 }
+iftBMap *iftBorderBMap(const iftImage *label, const iftAdjRel *A);
+void iftDrawBorderBMap(iftImage *img, const iftBMap *border, iftColor RGB, const iftAdjRel *B, float alpha);
 
 // ---------- iftBMap.h end
 // ---------- iftList.h start 
 
 typedef struct _ift_node {
-    int elem;
+    iftIdx elem;
     struct _ift_node *previous;
     struct _ift_node *next;
 } iftNode;
@@ -1013,8 +1298,8 @@ typedef struct _ift_list {
 iftList *iftCreateList();
 void iftDestroyList(iftList **L);
 bool iftIsEmptyList(const iftList *L);
-void iftInsertListIntoTail(iftList *L, int elem);
-int iftRemoveListTail(iftList *L);
+void iftInsertListIntoTail(iftList *L, iftIdx elem);
+iftIdx iftRemoveListTail(iftList *L);
 iftIntArray *iftListToIntArray(const iftList *L);
 
 // ---------- iftList.h end
@@ -0,0 +1,95 @@
+#ifndef _IFT_METRICS_H
+#define _IFT_METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "ift.h"
+
+/**
+* BRIEF
+*    Computes the boundary recall of a segmentation
+*
+* DESCRIPTION
+*     This function computes the fraction of the ground-truth boundary
+*     pixels which have a segmentation boundary pixel within the given
+*     tolerance distance. The boundaries are obtained by the 4-neighborhood
+*     (6-neighborhood, in 3D) and every label, including zero, is
+*     considered a region.
+*
+* PARAMETERS
+*     label     - Segmentation label image (e.g., from iftIGraphLabel)
+*     gt        - Ground-truth label image
+*     tol       - Tolerance distance, in pixels (x >= 0, often 2)
+*
+* RETURN
+*     Boundary recall, in [0,1]
+*/
+float iftBoundaryRecall
+(const iftImage *label, const iftImage *gt, float tol);
+
+/**
+* BRIEF
+*    Computes the under-segmentation error of a segmentation
+*
+* DESCRIPTION
+*     This function computes the corrected under-segmentation error of
+*     Neubert and Protzel, in which each region leaking to a ground-truth
+*     region is penalized by the smallest part of it, either inside or
+*     outside such region, normalized by the number of pixels.
+*
+* PARAMETERS
+*     label     - Segmentation label image (e.g., from iftIGraphLabel)
+*     gt        - Ground-truth label image
+*
+* RETURN
+*     Under-segmentation error, in [0,1]
+*/
+float iftUnderSegmentationError
+(const iftImage *label, const iftImage *gt);
+
+/**
+* BRIEF
+*    Computes the achievable segmentation accuracy of a segmentation
+*
+* DESCRIPTION
+*     This function computes the fraction of pixels correctly labeled
+*     when each region is assigned to the ground-truth region with which
+*     it has the largest overlap.
+*
+* PARAMETERS
+*     label     - Segmentation label image (e.g., from iftIGraphLabel)
+*     gt        - Ground-truth label image
+*
+* RETURN
+*     Achievable segmentation accuracy, in [0,1]
+*/
+float iftAchievableSegmentationAccuracy
+(const iftImage *label, const iftImage *gt);
+
+/**
+* BRIEF
+*    Computes the compactness of a segmentation
+*
+* DESCRIPTION
+*     This function computes the isoperimetric quotient of each region
+*     (i.e., 4*pi*A/P^2 in 2D, and 36*pi*V^2/S^3 in 3D), weighted by the
+*     region's size. The perimeter (surface) is the number of pixel edges
+*     (faces) between the region and the other regions or the image
+*     border.
+*
+* PARAMETERS
+*     label     - Segmentation label image (e.g., from iftIGraphLabel)
+*
+* RETURN
+*     Compactness, in [0,1]
+*/
+float iftCompactness
+(const iftImage *label);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif //_IFT_METRICS_H
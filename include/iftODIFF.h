@@ -0,0 +1,89 @@
+#ifndef _IFT_ODIFF_H
+#define _IFT_ODIFF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "ift.h"
+
+/**
+* BRIEF
+*    Samples approximately the desired number of seeds using the ODIFF
+*    algorithm
+*
+* DESCRIPTION
+*     This algorithm distributes the seeds such that their local density
+*     follows the object saliency map: the object seeds are spread
+*     proportionally to the saliency, whereas the background ones, to its
+*     complement. The density is accumulated in a grid of cells (about four
+*     cells per seed), which is then quantized by serpentine Floyd-Steinberg
+*     error diffusion, and each seed is placed at the ROI pixel closest to
+*     the density centroid of its cell. Therefore, the seeds present a
+*     blue-noise distribution and the sampling runs in linear time, with the
+*     pixel passes running in parallel over the cells. The user may control
+*     the percentage of object seeds, and may provide a mask image defining
+*     the ROI where all seeds can be placed.
+*
+* PARAMETERS
+*     objsm     - Object saliency map
+*     mask      - ROI image (can be set to NULL)
+*     num_seeds - Number of seeds to be sampled (x > 0)
+*     obj_perc  - Percentage of object seeds (x in [0,1])
+*
+* RETURN
+*     Image whose non-black values (i.e., non-zero luminosity) indicate a seed
+*     position
+*/
+iftImage *iftODIFF
+(iftImage* objsm, iftImage *mask, int num_seeds, float obj_perc);
+
+/**
+* BRIEF
+*    Samples approximately the desired number of seeds using the ODIFF
+*    algorithm
+*
+* DESCRIPTION
+*     Same as iftODIFF, but the seeds are returned as a compact array of
+*     distinct pixel indexes, avoiding the creation (and later scanning) of a
+*     full-size seed image.
+*
+* PARAMETERS
+*     objsm     - Object saliency map
+*     mask      - ROI image (can be set to NULL)
+*     num_seeds - Number of seeds to be sampled (x > 0)
+*     obj_perc  - Percentage of object seeds (x in [0,1])
+*
+* RETURN
+*     Array of the seeds' pixel indexes
+*/
+iftIntArray *iftODIFFSeeds
+(iftImage* objsm, iftImage *mask, int num_seeds, float obj_perc);
+
+/**
+* BRIEF
+*    Samples the desired number of seeds using the ODIFF algorithm
+*
+* DESCRIPTION
+*     Same as iftODIFFSeeds, but for compact (8- or 16-bit) images, which
+*     are widened to an iftImage only for the sampling, so the seeds are the
+*     same. Therefore, the inputs may be kept at 1 or 2 bytes per pixel
+*     (e.g., as read by iftReadCompactImageByExt).
+*
+* PARAMETERS
+*     objsm     - Object saliency map (gray)
+*     mask      - ROI image (gray, can be set to NULL)
+*     num_seeds - Number of seeds to be sampled (x > 0)
+*     obj_perc  - Percentage of object seeds (x in [0,1])
+*
+* RETURN
+*     Array of the seeds' pixel indexes
+*/
+iftIntArray *iftODIFFSeedsByCompact
+(const iftCompactImage *objsm, const iftCompactImage *mask, int num_seeds, float obj_perc);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif //_IFT_ODIFF_H
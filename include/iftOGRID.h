@@ -1,5 +1,5 @@
-#ifndef _IFT_OSMOX_H
-#define _IFT_OSMOX_H
+#ifndef _IFT_OGRID_H
+#define _IFT_OGRID_H
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,8 +32,53 @@ extern "C" {
 iftImage *iftOGRID
 (iftImage* objsm, iftImage *mask, int num_seeds, float obj_perc, float thr);
 
+/**
+* BRIEF
+*    Samples the desired number of seeds using the OGRID algorithm
+*
+* DESCRIPTION 
+*     Same as iftOGRID, but the seeds are returned as a compact array of
+*     distinct pixel indexes (in increasing order), avoiding the creation
+*     (and later scanning) of a full-size seed image.
+*
+* PARAMETERS
+*     objsm     - Object saliency map
+*     mask      - ROI image (can be set to NULL)
+*     num_seeds - Number of seeds to be sampled (x > 0)
+*     obj_perc  - Percentage of object seeds (x in [0,1])
+*     thr       - Threshold value (x in [0,1])
+*
+* RETURN
+*     Array of the seeds' pixel indexes
+*/
+iftIntArray *iftOGRIDSeeds
+(iftImage* objsm, iftImage *mask, int num_seeds, float obj_perc, float thr);
+
+/**
+* BRIEF
+*    Samples the desired number of seeds using the OGRID algorithm
+*
+* DESCRIPTION
+*     Same as iftOGRIDSeeds, but for compact (8- or 16-bit) images, which
+*     are widened to an iftImage only for the sampling, so the seeds are the
+*     same. Therefore, the inputs may be kept at 1 or 2 bytes per pixel
+*     (e.g., as read by iftReadCompactImageByExt).
+*
+* PARAMETERS
+*     objsm     - Object saliency map (gray)
+*     mask      - ROI image (gray, can be set to NULL)
+*     num_seeds - Number of seeds to be sampled (x > 0)
+*     obj_perc  - Percentage of object seeds (x in [0,1])
+*     thr       - Threshold value (x in [0,1])
+*
+* RETURN
+*     Array of the seeds' pixel indexes
+*/
+iftIntArray *iftOGRIDSeedsByCompact
+(const iftCompactImage *objsm, const iftCompactImage *mask, int num_seeds, float obj_perc, float thr);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
 
-#endif //_IFT_OSMOX_H
\ No newline at end of file
+#endif //_IFT_OGRID_H
\ No newline at end of file
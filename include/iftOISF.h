@@ -13,11 +13,23 @@ extern "C" {
 *
 * DESCRIPTION 
 *     This method creates a graph derived from the image for a proper 
-*     execution of the OISF algorithm. It converts the image to CIELAB 
-*     (D65 whitepoint reference) and normalizes the object saliency
-*     map features in order to avoid feature domination. The user may 
-*     provide a mask image defining the ROI delimiting the segmentation 
-*     limits.
+*     execution of the OISF algorithm. It converts the image to CIELAB (D65
+*     whitepoint reference) from its YCbCr planes (see
+*     iftInitOISFIGraphByMImage for the exact CIELAB) and normalizes the
+*     object saliency map features in order to avoid feature domination. The
+*     user may provide a mask image defining the ROI delimiting the
+*     segmentation limits. In such case, the graph is built only from the
+*     mask's bounding box (i.e., the conversion and segmentation cost is
+*     proportional to it), whereas the normalization values are taken over the
+*     whole image, and the seeds and the output labels (see iftIGraphLabel)
+*     remain in the domain of the original image. Thus, the result is the same
+*     as without cropping. The features are kept as floats, but they may be
+*     quantized to 8 or 16 bits afterwards (see iftIGraphQuantizeFeats), which
+*     reduces their memory by 4 or 2 times, respectively, at the cost of small
+*     changes in the resulting superpixels. Likewise, the nodes may be laid
+*     out in tiles or in Z-order (see iftIGraphSetNodeOrder), which keeps the
+*     vertical neighbors of wide images close in memory without changing the
+*     result.
 *
 * PARAMETERS
 *     img     - Original image
@@ -30,6 +42,134 @@ extern "C" {
 iftIGraph *iftInitOISFIGraph
 (iftImage *img, iftImage *mask, iftImage *objsm);
 
+/**
+* BRIEF
+*    Creates an image graph for the OISF algorithm from precomputed features
+*
+* DESCRIPTION 
+*     Same as iftInitOISFIGraph, but the image is given as its CIELAB (or 
+*     gray) multiband image, such as the one decoded straight from the file
+*     by iftReadLabMImageByExt. Therefore, the YCbCr planes of an iftImage
+*     and the conversions back to RGB are avoided altogether. Note that the
+*     rounded YCbCr planes do not recover the original RGB colors, so the
+*     features (and hence the superpixels) differ from those obtained by
+*     iftInitOISFIGraph on the same file; only this function yields the
+*     exact CIELAB of the stored colors. As in iftInitOISFIGraph, when a
+*     mask is given, only its bounding box is copied from the features,
+*     whereas the normalization values are taken over the whole image.
+*
+* PARAMETERS
+*     mimg    - CIELAB (LABNorm_CSPACE) or gray multiband image
+*     objsm   - Object saliency map
+*     mask    - ROI image (can be set to NULL)
+*
+* RETURN
+*     Image graph with normalized features
+*/
+iftIGraph *iftInitOISFIGraphByMImage
+(iftMImage *mimg, iftImage *mask, iftImage *objsm);
+
+/**
+* BRIEF
+*    Creates an image graph for the OISF algorithm from precomputed features
+*    and a float saliency map
+*
+* DESCRIPTION 
+*     Same as iftInitOISFIGraphByMImage, but the object saliency map is kept
+*     in floating point, such as the one read by iftReadFImageByExt (e.g., a
+*     PFM file, or a raw file mapped in memory). Therefore, the saliency band
+*     is normalized from the map's full precision, and the map is read in
+*     place within the mask's bounding box, rather than copied.
+*
+* PARAMETERS
+*     mimg    - CIELAB (LABNorm_CSPACE) or gray multiband image
+*     objsm   - Float object saliency map
+*     mask    - ROI image (can be set to NULL)
+*
+* RETURN
+*     Image graph with normalized features
+*/
+iftIGraph *iftInitOISFIGraphByFloatSal
+(iftMImage *mimg, iftImage *mask, iftFImage *objsm);
+
+/**
+* BRIEF
+*    Creates an image graph for the OISF algorithm straight from an image
+*    file
+*
+* DESCRIPTION 
+*     Same as iftInitOISFIGraphByMImage, but the graph is built while the
+*     image is decoded: each row of the mask's bounding box is converted to
+*     CIELAB (or gray) and written, with its normalized saliency, into the
+*     node attributes. The other rows are only decoded for the maximum
+*     CIELAB value of the whole image, as in iftInitOISFIGraphByMImage.
+*     Therefore, neither the image nor its multiband image is ever held as
+*     a whole, and the features are written once. Formats other than .png,
+*     .jpg and .ppm are read by iftReadLabMImageByExt instead.
+*
+* PARAMETERS
+*     filename - Path to the image
+*     objsm    - Object saliency map
+*     mask     - ROI image (can be set to NULL)
+*
+* RETURN
+*     Image graph with normalized features
+*/
+iftIGraph *iftInitOISFIGraphByFile
+(const char *filename, iftImage *mask, iftImage *objsm);
+
+/**
+* BRIEF
+*    Creates an image graph for the OISF algorithm straight from an image
+*    file and a float saliency map
+*
+* DESCRIPTION 
+*     Same as iftInitOISFIGraphByFile, for a float object saliency map (see
+*     iftInitOISFIGraphByFloatSal).
+*
+* PARAMETERS
+*     filename - Path to the image
+*     objsm    - Float object saliency map
+*     mask     - ROI image (can be set to NULL)
+*
+* RETURN
+*     Image graph with normalized features
+*/
+iftIGraph *iftInitOISFIGraphByFileFloatSal
+(const char *filename, iftImage *mask, iftFImage *objsm);
+
+/**
+* BRIEF
+*    Creates an image graph for the OISF algorithm straight from caller-owned
+*    buffers
+*
+* DESCRIPTION 
+*     Same as iftInitOISFIGraphByFile, but the image is an interleaved 8-bit
+*     buffer (gray, RGB or RGBA) of the calling application, whose rows lie 
+*     stride bytes apart, and which is converted to CIELAB (or gray) in 
+*     place, row by row. The saliency map and the mask are compact images, 
+*     which may wrap the application's packed 8- or 16-bit buffers (see 
+*     iftWrapCompactImage), and may be given as they are to the compact 
+*     samplers (e.g., iftOSMOXSeedsByCompact). Along with iftOISFSeeds and
+*     iftIGraphLabelToBuffer, a frame is thus segmented without any file,
+*     decoding or iftImage copy of its inputs and labels.
+*
+* PARAMETERS
+*     rgb       - Image buffer (xsize*ysize pixels)
+*     xsize     - Width of the image
+*     ysize     - Height of the image
+*     nchannels - Samples per pixel (1, 3 or 4)
+*     stride    - Bytes between the starts of consecutive rows
+*     mask      - ROI image (can be set to NULL)
+*     objsm     - Object saliency map (gray)
+*
+* RETURN
+*     Image graph with normalized features
+*/
+iftIGraph *iftInitOISFIGraphByBuffer
+(const uchar *rgb, int xsize, int ysize, int nchannels, long stride,
+ const iftCompactImage *mask, const iftCompactImage *objsm);
+
 /**
 * BRIEF
 *    Segments inplace the image graph using the OISF algorithm
@@ -57,6 +197,29 @@ iftIGraph *iftInitOISFIGraph
 void iftOISF
 (iftIGraph *igraph, iftImage *seeds, double alpha, double beta, double gamma, int iters);
 
+/**
+* BRIEF
+*    Segments inplace the image graph using the OISF algorithm
+*
+* DESCRIPTION 
+*     Same as iftOISF, but the seeds are given as an array of distinct pixel
+*     indexes (e.g., see iftOSMOXSeeds and iftOGRIDSeeds). As in iftOISF,
+*     the seeds within the ROI are labeled from 1 in decreasing order of 
+*     their indexes, whichever their order in the array, and seeds outside 
+*     the ROI are ignored. Thus, the seed handoff costs O(k log k) instead 
+*     of O(n).
+*
+* PARAMETERS
+*     igraph    - Image graph (see iftInitOISFIGraph)
+*     seeds     - Array of the seeds' pixel indexes
+*     alpha     - Regularization factor (x > 0)
+*     beta      - Boundary adherence factor (x > 0)
+*     gamma     - Saliency map confidence factor (x > 0)
+*     iters     - Number of iterations for segmentation (x > 0)
+*/
+void iftOISFSeeds
+(iftIGraph *igraph, const iftIntArray *seeds, double alpha, double beta, double gamma, int iters);
+
 #ifdef __cplusplus
 }
 #endif
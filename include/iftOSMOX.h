@@ -16,7 +16,8 @@ extern "C" {
 *     value, assuring the exact the total quantity desired by the user. The 
 *     user may control the percentage of object seeds and their proximity to 
 *     each other. Finally, the user can provide a mask image defining the ROI 
-*     where all seeds can be placed. 
+*     where all seeds can be placed, in which case the sampling is computed 
+*     only within the mask's bounding box.
 *
 * PARAMETERS
 *     objsm     - Object saliency map
@@ -32,6 +33,51 @@ extern "C" {
 iftImage *iftOSMOX
 (iftImage* objsm, iftImage *mask, int num_seeds, float obj_perc, float stddev);
 
+/**
+* BRIEF
+*    Samples the desired number of seeds using the OSMOX algorithm
+*
+* DESCRIPTION 
+*     Same as iftOSMOX, but the seeds are returned as a compact array of 
+*     pixel indexes, avoiding the creation (and later scanning) of a 
+*     full-size seed image.
+*
+* PARAMETERS
+*     objsm     - Object saliency map
+*     mask      - ROI image (can be set to NULL)
+*     num_seeds - Number of seeds to be sampled (x > 0)
+*     obj_perc  - Percentage of object seeds (x in [0,1])
+*     stddev    - Seed proximity factor (x > 0)
+*
+* RETURN
+*     Array of the seeds' pixel indexes
+*/
+iftIntArray *iftOSMOXSeeds
+(iftImage* objsm, iftImage *mask, int num_seeds, float obj_perc, float stddev);
+
+/**
+* BRIEF
+*    Samples the desired number of seeds using the OSMOX algorithm
+*
+* DESCRIPTION
+*     Same as iftOSMOXSeeds, but for compact (8- or 16-bit) images, which
+*     are widened to an iftImage only for the sampling, so the seeds are the
+*     same. Therefore, the inputs may be kept at 1 or 2 bytes per pixel
+*     (e.g., as read by iftReadCompactImageByExt).
+*
+* PARAMETERS
+*     objsm     - Object saliency map (gray)
+*     mask      - ROI image (gray, can be set to NULL)
+*     num_seeds - Number of seeds to be sampled (x > 0)
+*     obj_perc  - Percentage of object seeds (x in [0,1])
+*     stddev    - Seed proximity factor (x > 0)
+*
+* RETURN
+*     Array of the seeds' pixel indexes
+*/
+iftIntArray *iftOSMOXSeedsByCompact
+(const iftCompactImage *objsm, const iftCompactImage *mask, int num_seeds, float obj_perc, float stddev);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -2,7 +2,7 @@
 
 // ---------- iftGQueue.c start 
 
-iftGQueue *iftCreateGQueue(int nbuckets, int nelems, int *value)
+iftGQueue *iftCreateGQueue(int nbuckets, iftIdx nelems, int *value)
 {
     iftGQueue *Q=NULL;
     
@@ -10,8 +10,8 @@ iftGQueue *iftCreateGQueue(int nbuckets, int nelems, int *value)
     
     if (Q != NULL)
     {
-        Q->C.first = (int *)iftAlloc((nbuckets+1), sizeof(int));
-        Q->C.last  = (int *)iftAlloc((nbuckets+1), sizeof(int));
+        Q->C.first = (iftIdx *)iftAlloc((nbuckets+1), sizeof(iftIdx));
+        Q->C.last  = (iftIdx *)iftAlloc((nbuckets+1), sizeof(iftIdx));
         Q->C.nbuckets = nbuckets;
         if ( (Q->C.first != NULL) && (Q->C.last != NULL) )
         {
@@ -87,7 +87,7 @@ int iftEmptyGQueue(iftGQueue *Q)
     return (0);
 }
 
-void iftInsertGQueue(iftGQueue **Q, int elem)
+void iftInsertGQueue(iftGQueue **Q, iftIdx elem)
 {
     int bucket,minvalue=(*Q)->C.minvalue,maxvalue=(*Q)->C.maxvalue;
     
@@ -131,9 +131,9 @@ void iftInsertGQueue(iftGQueue **Q, int elem)
     (*Q)->L.elem[elem].color = IFT_GRAY;
 }
 
-int iftRemoveGQueue(iftGQueue *Q)
+iftIdx iftRemoveGQueue(iftGQueue *Q)
 {
-    int elem= IFT_NIL, next, prev;
+    iftIdx elem= IFT_NIL, next, prev;
     int last, current;
     
     if (Q->C.removal_policy==MINVALUE)
@@ -212,9 +212,10 @@ int iftRemoveGQueue(iftGQueue *Q)
     return elem;
 }
 
-void iftRemoveGQueueElem(iftGQueue *Q, int elem)
+void iftRemoveGQueueElem(iftGQueue *Q, iftIdx elem)
 {
-    int prev,next,bucket;
+    iftIdx prev,next;
+    int bucket;
     
     if ((Q->L.value[elem] == IFT_INFINITY_INT) || (Q->L.value[elem] == IFT_INFINITY_INT_NEG))
         bucket = Q->C.nbuckets;
@@ -253,7 +254,7 @@ void iftRemoveGQueueElem(iftGQueue *Q, int elem)
 
 void iftResetGQueue(iftGQueue *Q)
 {
-    int i;
+    iftIdx i;
     
     Q->C.minvalue = IFT_INFINITY_INT;
     Q->C.maxvalue = IFT_INFINITY_INT_NEG;
@@ -274,7 +275,8 @@ void iftResetGQueue(iftGQueue *Q)
 iftGQueue *iftGrowGQueue(iftGQueue **Q, int nbuckets)
 {
     iftGQueue *Q1=iftCreateGQueue(nbuckets,(*Q)->L.nelems,(*Q)->L.value);
-    int i,bucket;
+    iftIdx i;
+    int bucket;
     
     Q1->C.minvalue  = (*Q)->C.minvalue;
     Q1->C.maxvalue  = (*Q)->C.maxvalue;
@@ -591,7 +593,7 @@ iftGVal iftCopyGVal(iftGVal gval)
             break;
         case IFT_INT_ARRAY_TYPE:
             out.int_array_val = iftCreateIntArray(gval.int_array_val->n);
-            iftCopyIntArray(out.int_array_val->val, gval.int_array_val->val, gval.int_array_val->n);
+            memcpy(out.int_array_val->val, gval.int_array_val->val, gval.int_array_val->n * sizeof(iftIdx));
             break;
         case IFT_DBL_ARRAY_TYPE:
             out.dbl_array_val = iftCopyDblArray(gval.dbl_array_val->val, gval.dbl_array_val->n);
@@ -708,7 +710,7 @@ iftIntArray *iftCreateIntArray(long n)
     iftIntArray *iarr = (iftIntArray*) iftAlloc(1, sizeof(iftIntArray));
     
     iarr->n = n;
-    iarr->val = iftAllocIntArray(n);
+    iarr->val = iftAllocIdxArray(n);
     
     return iarr;
 }
@@ -725,12 +727,12 @@ void iftDestroyIntArray(iftIntArray **iarr)
     }
 }
 
-void iftShuffleIntArray(int* array, int n) 
+void iftShuffleIntArray(iftIdx* array, long n) 
 {
     // Start from the last element and swap one by one. We don't
     // need to run for the first element that's why i > 0
-    int j;
-    for (int i = n-1; i > 0; i--)
+    long j;
+    for (long i = n-1; i > 0; i--)
     {
         // Pick a random index from 0 to i
         j = rand() % (i+1);
@@ -1135,19 +1137,21 @@ iftAdjRel *iftSpheric(float r)
     for (int i = 0; i < A->n; i++)
         dr[i] = A->dx[i]*A->dx[i] + A->dy[i]*A->dy[i] + A->dz[i]*A->dz[i];
 
-    iftIntArray *idxs = iftIntRange(0, A->n-1, 1);
-    iftFQuickSort(dr, idxs->val, 0, A->n-1, IFT_INCREASING);
+    int *idxs = iftAllocIntArray(A->n);
+    for (int i = 0; i < A->n; i++)
+        idxs[i] = i;
+    iftFQuickSort(dr, idxs, 0, A->n-1, IFT_INCREASING);
     iftAdjRel *Asort = iftCreateAdjRel(A->n);
 
     for (int i = 0; i < A->n; i++) {
-        int idx = idxs->val[i];
+        int idx = idxs[i];
         Asort->dx[i] = A->dx[idx];
         Asort->dy[i] = A->dy[idx];
         Asort->dz[i] = A->dz[idx];
     }
 
     iftFree(dr);
-    iftDestroyIntArray(&idxs);
+    iftFree(idxs);
     iftDestroyAdjRel(&A);
 
     return Asort;
@@ -1196,19 +1200,21 @@ iftAdjRel *iftCircular(float r)
         dr[i] = A->dx[i]*A->dx[i] + A->dy[i]*A->dy[i];
 
 
-    iftIntArray *idxs = iftIntRange(0, A->n-1, 1);
-    iftFQuickSort(dr, idxs->val, 0, A->n-1, IFT_INCREASING);
+    int *idxs = iftAllocIntArray(A->n);
+    for (int i = 0; i < A->n; i++)
+        idxs[i] = i;
+    iftFQuickSort(dr, idxs, 0, A->n-1, IFT_INCREASING);
     iftAdjRel *Asort = iftCreateAdjRel(A->n);
 
     for (int i = 0; i < A->n; i++) {
-        int idx = idxs->val[i];
+        int idx = idxs[i];
         Asort->dx[i] = A->dx[idx];
         Asort->dy[i] = A->dy[idx];
         Asort->dz[i] = A->dz[idx];
     }
 
     iftFree(dr);
-    iftDestroyIntArray(&idxs);
+    iftFree(idxs);
     iftDestroyAdjRel(&A);
 
     return Asort;
@@ -1275,7 +1281,8 @@ iftAdjRel *iftAdjacencyBoundaries(const iftAdjRel *A, const iftAdjRel *B_in)
     float max_dist = sqrtf(A->dx[A->n-1]*A->dx[A->n-1] + A->dy[A->n-1]*A->dy[A->n-1] + A->dz[A->n-1]*A->dz[A->n-1]);
 
     int xsize, ysize, zsize;
-    xsize = ysize = zsize = (3 * ceil(max_dist)); // find out a given size to create an image that fits A
+    // find out a given size to create an image that fits A (and B, when A is only its center)
+    xsize = ysize = zsize = (3 * iftMax(ceil(max_dist), 1));
     if (!is_3D_adj)
         zsize = 1;
 
@@ -1522,6 +1529,9 @@ void iftDestroyCSV(iftCSV **csv)
 
 // ---------- iftCSV.c end
 // ---------- iftColor.c start 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 iftColor iftRGBColor(int R, int G, int B)
 {
@@ -1788,6 +1798,176 @@ iftFColor iftRGBtoLabNorm(iftColor rgb, int normalization_value)
     return lab;
 }
 
+/* The fast CIELAB kernel: RGB to XYZ, with the whitepoint folded in */
+#define IFT_LAB_EPSILON 8.85645167903563082e-3f
+
+static const float _iftXYZn[3][3] = {
+  {0.4123955889674142161/WHITEPOINT_X, 0.3575834307637148171/WHITEPOINT_X, 0.1804926473817015735/WHITEPOINT_X},
+  {0.2125862307855955516/WHITEPOINT_Y, 0.7151703037034108499/WHITEPOINT_Y, 0.07220049864333622685/WHITEPOINT_Y},
+  {0.01929721549174694484/WHITEPOINT_Z, 0.1191838645808485318/WHITEPOINT_Z, 0.9504971251315797660/WHITEPOINT_Z}
+};
+
+/* Linearized sRGB values of every 8- or 16-bit sample (NULL for the other
+   normalization values), built on first use exactly as iftRGBtoLabNorm
+   computes them */
+const float *_iftSRGBLinearTable(int normalization_value)
+{
+    static float *lut8 = NULL, *lut16 = NULL;
+    float **lut;
+
+    if (normalization_value == 255) lut = &lut8;
+    else if (normalization_value == 65535) lut = &lut16;
+    else return NULL;
+
+    #pragma omp critical(iftSRGBLinearTable)
+    if (*lut == NULL) {
+        float *tab = iftAllocFloatArray(normalization_value + 1);
+
+        for (int v = 0; v <= normalization_value; v++) {
+            float c = v/(float)normalization_value;
+
+            if (c <= 0.04045) tab[v] = c/12.92;
+            else              tab[v] = pow((c+0.055)/1.055,2.4);
+        }
+        *lut = tab;
+    }
+
+    return *lut;
+}
+
+/* Cube root of t > 0 by a bit-level guess (within 4%) refined by two Halley
+   steps, whose cubic convergence reaches the float precision */
+float _iftFastCbrt(float t)
+{
+    union { float f; unsigned int i; } u;
+    float y, y3;
+
+    u.f = t;
+    u.i = u.i/3 + 0x2a514067;
+    y   = u.f;
+
+    y3 = y*y*y; y = y*(y3 + 2.0f*t)/(2.0f*y3 + t);
+    y3 = y*y*y; y = y*(y3 + 2.0f*t)/(2.0f*y3 + t);
+
+    return y;
+}
+
+void _iftLinearRGBtoLabNorm(float R, float G, float B, float *lab)
+{
+    float f[3];
+
+    for (int i = 0; i < 3; i++) {
+        float t = _iftXYZn[i][0]*R + _iftXYZn[i][1]*G + _iftXYZn[i][2]*B;
+
+        if (t >= IFT_LAB_EPSILON) f[i] = _iftFastCbrt(t);
+        else f[i] = (841.0f/108.0f)*t + (4.0f/29.0f);
+    }
+
+    lab[0] = 116.0f*f[1] - 16.0f;
+    lab[1] = 500.0f*(f[0] - f[1]);
+    lab[2] = 200.0f*(f[1] - f[2]);
+}
+
+#ifdef __AVX2__
+/* Same as _iftLinearRGBtoLabNorm, for 8 pixels at once */
+void _iftLinearRGBtoLabNorm8(const float *R, const float *G, const float *B, float *lab)
+{
+    __m256 rgb[3], f[3];
+    float L[8], a[8], b[8];
+
+    rgb[0] = _mm256_loadu_ps(R);
+    rgb[1] = _mm256_loadu_ps(G);
+    rgb[2] = _mm256_loadu_ps(B);
+
+    for (int i = 0; i < 3; i++) {
+        __m256 t, y, y3, two_t, lin, big;
+        __m256i bits;
+
+        t = _mm256_mul_ps(_mm256_set1_ps(_iftXYZn[i][0]), rgb[0]);
+        t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_set1_ps(_iftXYZn[i][1]), rgb[1]));
+        t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_set1_ps(_iftXYZn[i][2]), rgb[2]));
+
+        // Bit-level guess (the division by 3 goes through floats, which is
+        // accurate enough for it) and two Halley steps
+        bits = _mm256_castps_si256(t);
+        bits = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(bits), _mm256_set1_ps(1.0f/3.0f)));
+        y    = _mm256_castsi256_ps(_mm256_add_epi32(bits, _mm256_set1_epi32(0x2a514067)));
+
+        two_t = _mm256_add_ps(t, t);
+        for (int it = 0; it < 2; it++) {
+            y3 = _mm256_mul_ps(_mm256_mul_ps(y, y), y);
+            y  = _mm256_div_ps(_mm256_mul_ps(y, _mm256_add_ps(y3, two_t)),
+                               _mm256_add_ps(_mm256_add_ps(y3, y3), t));
+        }
+
+        lin  = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(841.0f/108.0f), t), _mm256_set1_ps(4.0f/29.0f));
+        big  = _mm256_cmp_ps(t, _mm256_set1_ps(IFT_LAB_EPSILON), _CMP_GE_OQ);
+        f[i] = _mm256_blendv_ps(lin, y, big);
+    }
+
+    _mm256_storeu_ps(L, _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(116.0f), f[1]), _mm256_set1_ps(16.0f)));
+    _mm256_storeu_ps(a, _mm256_mul_ps(_mm256_set1_ps(500.0f), _mm256_sub_ps(f[0], f[1])));
+    _mm256_storeu_ps(b, _mm256_mul_ps(_mm256_set1_ps(200.0f), _mm256_sub_ps(f[1], f[2])));
+
+    for (int i = 0; i < 8; i++) {
+        lab[3*i]   = L[i];
+        lab[3*i+1] = a[i];
+        lab[3*i+2] = b[i];
+    }
+}
+#endif
+
+void iftRGBRowToLabNorm(const uchar *row, int n, int nchannels, bool wide,
+                        int normalization_value, float *lab)
+{
+    const float *lut;
+    int step, x;
+
+    lut  = _iftSRGBLinearTable(normalization_value);
+    step = nchannels * (wide ? 2 : 1);
+    x    = 0;
+
+    if (lut == NULL) { // Other depths: reference conversion
+        for (; x < n; x++, row += step) {
+            iftColor RGB;
+            iftFColor Lab;
+
+            for (int c = 0; c < 3; c++)
+                RGB.val[c] = wide ? ((row[2*c] << 8) | row[2*c+1]) : row[c];
+
+            Lab = iftRGBtoLabNorm(RGB, normalization_value);
+            lab[3*x]   = Lab.val[0];
+            lab[3*x+1] = Lab.val[1];
+            lab[3*x+2] = Lab.val[2];
+        }
+        return;
+    }
+
+#ifdef __AVX2__
+    for (; x + 8 <= n; x += 8) {
+        float R[8], G[8], B[8];
+
+        for (int i = 0; i < 8; i++, row += step) {
+            if (wide) {
+                R[i] = lut[(row[0] << 8) | row[1]];
+                G[i] = lut[(row[2] << 8) | row[3]];
+                B[i] = lut[(row[4] << 8) | row[5]];
+            }
+            else { R[i] = lut[row[0]]; G[i] = lut[row[1]]; B[i] = lut[row[2]]; }
+        }
+
+        _iftLinearRGBtoLabNorm8(R, G, B, &lab[3*x]);
+    }
+#endif
+
+    for (; x < n; x++, row += step) {
+        if (wide)
+            _iftLinearRGBtoLabNorm(lut[(row[0] << 8) | row[1]], lut[(row[2] << 8) | row[3]],
+                                   lut[(row[4] << 8) | row[5]], &lab[3*x]);
+        else _iftLinearRGBtoLabNorm(lut[row[0]], lut[row[1]], lut[row[2]], &lab[3*x]);
+    }
+}
+
 iftColor iftRGBtoHSV(iftColor cin, int normalization_value) 
 {
     float r = ((float)cin.val[0]/normalization_value),
@@ -1863,10 +2043,10 @@ iftColor iftHSVtoRGB(iftColor cin, int normalization_value)
 // ---------- iftColor.c end
 // ---------- iftDHeap.c start
 
-iftDHeap *iftCreateDHeap(int n, double *value) 
+iftDHeap *iftCreateDHeap(iftIdx n, double *value) 
 {
     iftDHeap *H = NULL;
-    int i;
+    iftIdx i;
     
     if (value == NULL) {
         iftError("Cannot create heap without priority value map", "iftCreateDHeap");
@@ -1877,8 +2057,8 @@ iftDHeap *iftCreateDHeap(int n, double *value)
         H->n       = n;
         H->value   = value;
         H->color   = (char *) iftAlloc(sizeof(char), n);
-        H->node    = (int *) iftAlloc(sizeof(int), n);
-        H->pos     = (int *) iftAlloc(sizeof(int), n);
+        H->node    = (iftIdx *) iftAlloc(sizeof(iftIdx), n);
+        H->pos     = (iftIdx *) iftAlloc(sizeof(iftIdx), n);
         H->last    = -1;
         H->removal_policy = MINVALUE;
         if (H->color == NULL || H->pos == NULL || H->node == NULL)
@@ -1924,7 +2104,7 @@ char iftEmptyDHeap(iftDHeap *H)
     }
 }
 
-char iftInsertDHeap(iftDHeap *H, int node) 
+char iftInsertDHeap(iftDHeap *H, iftIdx node) 
 {
     
     if (!iftFullDHeap(H)) {
@@ -1941,9 +2121,9 @@ char iftInsertDHeap(iftDHeap *H, int node)
     
 }
 
-int iftRemoveDHeap(iftDHeap *H) 
+iftIdx iftRemoveDHeap(iftDHeap *H) 
 {
-    int node= IFT_NIL;
+    iftIdx node= IFT_NIL;
     
     if (!iftEmptyDHeap(H)) {
         node = H->node[0];
@@ -1962,7 +2142,7 @@ int iftRemoveDHeap(iftDHeap *H)
     
 }
 
-void    iftRemoveDHeapElem(iftDHeap *H, int pixel)
+void    iftRemoveDHeapElem(iftDHeap *H, iftIdx pixel)
 {
     
     if(H->pos[pixel] == -1)
@@ -1983,9 +2163,9 @@ void    iftRemoveDHeapElem(iftDHeap *H, int pixel)
     
 }
 
-void  iftGoUpDHeap(iftDHeap *H, int i) 
+void  iftGoUpDHeap(iftDHeap *H, iftIdx i) 
 {
-    int j = iftDad(i);
+    iftIdx j = iftDad(i);
     
     if(H->removal_policy == MINVALUE){
         
@@ -2009,9 +2189,9 @@ void  iftGoUpDHeap(iftDHeap *H, int i)
     }
 }
 
-void iftGoDownDHeap(iftDHeap *H, int i) 
+void iftGoDownDHeap(iftDHeap *H, iftIdx i) 
 {
-    int j, left = iftLeftSon(i), right = iftRightSon(i);
+    iftIdx j, left = iftLeftSon(i), right = iftRightSon(i);
     
     j = i;
     if(H->removal_policy == MINVALUE){
@@ -2043,7 +2223,7 @@ void iftGoDownDHeap(iftDHeap *H, int i)
 
 void iftResetDHeap(iftDHeap *H)
 {
-    int i;
+    iftIdx i;
     
     for (i=0; i < H->n; i++) {
         H->color[i] = IFT_WHITE;
@@ -2056,11 +2236,11 @@ void iftResetDHeap(iftDHeap *H)
 // ---------- iftDHeap.c end
 // ---------- iftFIFO.c start 
 
-iftFIFO *iftCreateFIFO(int n)
+iftFIFO *iftCreateFIFO(iftIdx n)
 {
     iftFIFO *F=(iftFIFO *)iftAlloc(1,sizeof(iftFIFO));
     
-    F->FIFO  = iftAllocIntArray(n);
+    F->FIFO  = iftAllocIdxArray(n);
     F->color = iftAllocCharArray(n);
     F->n     = n;
     F->first=F->last=0;
@@ -2082,7 +2262,7 @@ void iftDestroyFIFO(iftFIFO **F)
     }
 }
 
-char iftInsertFIFO(iftFIFO *F, int elem)
+char iftInsertFIFO(iftFIFO *F, iftIdx elem)
 {
     if (iftFullFIFO(F)){
         iftWarning("FIFO is full","iftInsertFIFO");
@@ -2094,9 +2274,9 @@ char iftInsertFIFO(iftFIFO *F, int elem)
     return 1;
 }
 
-int      iftRemoveFIFO(iftFIFO *F)
+iftIdx   iftRemoveFIFO(iftFIFO *F)
 {
-    int node= IFT_NIL;
+    iftIdx node= IFT_NIL;
     
     if (!iftEmptyFIFO(F)){
         node = F->FIFO[F->first];  F->first++;
@@ -2128,18 +2308,56 @@ bool iftEmptyFIFO(iftFIFO *F)
 
 void     iftResetFIFO(iftFIFO *F)
 {
-    int p;
+    iftIdx p;
     for (p=0; p < F->n; p++)
         F->color[p] = IFT_WHITE;
     F->first=F->last=0;
 }
 
-int    iftColorFIFO(iftFIFO *F, int pos)
+int    iftColorFIFO(iftFIFO *F, iftIdx pos)
 {
     return F->color[pos];
 }
 
 // ---------- iftFIFO.c end
+// ---------- iftStack.c start
+
+iftStack *iftCreateStack(iftIdx capacity)
+{
+    iftStack *S = (iftStack *)iftAlloc(1,sizeof(iftStack));
+
+    S->capacity = iftMax(capacity,1);
+    S->val      = iftAllocIdxArray(S->capacity);
+    S->n        = 0;
+
+    return(S);
+}
+
+void iftDestroyStack(iftStack **S)
+{
+    if (S != NULL) {
+        iftStack *aux = *S;
+
+        if (aux != NULL) {
+            iftFree(aux->val);
+            iftFree(aux);
+            *S = NULL;
+        }
+    }
+}
+
+void iftGrowStack(iftStack *S)
+{
+    iftIdx *val = (iftIdx *)iftRealloc(S->val, 2*(size_t)S->capacity*sizeof(iftIdx));
+
+    if (val == NULL)
+        iftError(MSG_MEMORY_ALLOC_ERROR, "iftGrowStack");
+
+    S->val       = val;
+    S->capacity *= 2;
+}
+
+// ---------- iftStack.c end
 // ---------- iftFile.c start
 
 bool iftFileExists(const char *pathname) 
@@ -2242,6 +2460,7 @@ void iftDestroyFile(iftFile **f) {
 // ---------- iftImage.c start
 #include "iftPng.h"
 #include "jpeglib.h"
+#include "zlib.h"
 
 iftImage *iftReadImageByExt(const char *format, ...) 
 {
@@ -2278,8 +2497,10 @@ iftImage *iftReadImageByExt(const char *format, ...)
         img   = iftReadImage(filename);
     } else if (iftCompareStrings(ext, ".jpg") || iftCompareStrings(ext, ".jpeg")){
         img = iftReadImageJPEG(filename);
+    } else if (iftCompareStrings(ext, ".lbl")){
+        img = iftReadLabelImage(filename);
     } else {
-        iftError("Invalid image format: \"%s\" - Try .scn, .zscn, .scn.gz, .ppm, .pgm, .jpg, .png",
+        iftError("Invalid image format: \"%s\" - Try .scn, .zscn, .scn.gz, .ppm, .pgm, .jpg, .png, .lbl",
                  "iftReadImageByExt", ext);
     }
 
@@ -2289,7 +2510,7 @@ iftImage *iftReadImageByExt(const char *format, ...)
 
 iftImage  *iftCreateImage(int xsize,int ysize,int zsize) 
 {
-    int *val = iftAllocIntArray(xsize*ysize*zsize);
+    int *val = iftAllocIntArray((iftIdx)xsize*ysize*zsize);
 
     return iftCreateImageFromBuffer(xsize, ysize, zsize, val);
 }
@@ -2345,9 +2566,12 @@ void iftWriteImageByExt(const iftImage *img, const char *format, ...)
         char *ext = iftLowerString(iftFileExt(filename));
 
         if(iftCompareStrings(ext, ".png")) {
-            iftWriteImagePNG(img,filename);
+            // libpng's default level and filtering, in concurrent row groups
+            iftWriteImagePNGParallel(img, 6, IFT_PNG_FILTER_ADAPTIVE, filename);
         } else if (iftCompareStrings(ext, ".scn")) {
             iftWriteImage(img, filename);
+        } else if (iftCompareStrings(ext, ".lbl")) {
+            iftWriteLabelImage(img, true, filename);
         }else if (iftCompareStrings(ext, ".pgm")) {
             if (iftMaximumValue(img)>255)
                 iftWriteImageP2(img,filename);
@@ -2365,7 +2589,7 @@ void iftWriteImageByExt(const iftImage *img, const char *format, ...)
         } else if(iftCompareStrings(ext, ".jpg") || iftCompareStrings(ext, ".jpeg")) {
             iftWriteImageJPEG(img,filename);
         } else {
-            printf("Invalid image format: %s. Please select among the accepted ones: .scn, .zscn, .scn.gz, .ppm, .pgm, .png, .img\n",ext);
+            printf("Invalid image format: %s. Please select among the accepted ones: .scn, .zscn, .scn.gz, .ppm, .pgm, .png, .lbl, .img\n",ext);
             exit(-1);
         }
 
@@ -2392,14 +2616,14 @@ int iftMinimumValue(const iftImage *img)
 {
     int img_min_val = IFT_INFINITY_INT;
 
-    for (int p = 0; p < img->n; p++)
+    for (iftIdx p = 0; p < img->n; p++)
         if (img_min_val > img->val[p])
             img_min_val = img->val[p];
 
     return img_min_val;
 }
 
-inline iftVoxel iftGetVoxelCoord(const iftImage *img, int p)
+inline iftVoxel iftGetVoxelCoord(const iftImage *img, iftIdx p)
 {
     /* old
      * u.x = (((p) % (((img)->xsize)*((img)->ysize))) % (img)->xsize)
@@ -2407,12 +2631,12 @@ inline iftVoxel iftGetVoxelCoord(const iftImage *img, int p)
      * u.z = ((p) / (((img)->xsize)*((img)->ysize)))
      */
     iftVoxel u;
-    div_t res1 = div(p, img->xsize * img->ysize);
-    div_t res2 = div(res1.rem, img->xsize);
-
-    u.x = res2.rem;
-    u.y = res2.quot;
-    u.z = res1.quot;
+    iftIdx   xysize = (iftIdx)img->xsize * img->ysize;
+    iftIdx   rem    = p % xysize; /* the compiler merges it with p / xysize */
+    
+    u.x = (int)(rem % img->xsize);
+    u.y = (int)(rem / img->xsize);
+    u.z = (int)(p / xysize);
 
     return u;
 }
@@ -2471,6 +2695,95 @@ iftBoundingBox iftMinBoundingBox(const iftImage *img, iftVoxel *gc_out)
     return mbb;
 }
 
+bool iftMaskROIBoundingBox(const iftImage *mask, iftBoundingBox *bb)
+{
+    *bb = iftMinBoundingBox(mask, NULL);
+
+    if (bb->begin.x < 0) /* empty mask */
+        return false;
+
+    return ((bb->end.x - bb->begin.x + 1) < mask->xsize ||
+            (bb->end.y - bb->begin.y + 1) < mask->ysize ||
+            (bb->end.z - bb->begin.z + 1) < mask->zsize);
+}
+
+iftImage *iftExtractROI(const iftImage *img, iftBoundingBox bb)
+{
+    iftVoxel  v;
+    iftImage *roi;
+    iftIdx    p, q;
+
+    if (!iftValidVoxel(img, bb.begin) || !iftValidVoxel(img, bb.end) ||
+        bb.begin.x > bb.end.x || bb.begin.y > bb.end.y || bb.begin.z > bb.end.z)
+        iftError("Invalid bounding box", "iftExtractROI");
+
+    roi = iftCreateImage(bb.end.x - bb.begin.x + 1, bb.end.y - bb.begin.y + 1,
+                         bb.end.z - bb.begin.z + 1);
+    iftCopyVoxelSize(img, roi);
+
+    if (iftIsColorImage(img)) {
+        roi->Cb = iftAllocUShortArray(roi->n);
+        roi->Cr = iftAllocUShortArray(roi->n);
+    }
+
+    /* rows are contiguous in both images */
+    q = 0;
+    for (v.z = bb.begin.z; v.z <= bb.end.z; v.z++)
+        for (v.y = bb.begin.y; v.y <= bb.end.y; v.y++) {
+            v.x = bb.begin.x;
+            p   = iftGetVoxelIndex(img, v);
+            memcpy(&roi->val[q], &img->val[p], roi->xsize * sizeof(int));
+            if (roi->Cb != NULL) {
+                memcpy(&roi->Cb[q], &img->Cb[p], roi->xsize * sizeof(ushort));
+                memcpy(&roi->Cr[q], &img->Cr[p], roi->xsize * sizeof(ushort));
+            }
+            q += roi->xsize;
+        }
+
+    return roi;
+}
+
+void iftInsertROI(const iftImage *roi, iftImage *target, iftVoxel begin)
+{
+    iftVoxel u, v;
+    iftIdx   p, q;
+
+    u.x = begin.x + roi->xsize - 1;
+    u.y = begin.y + roi->ysize - 1;
+    u.z = begin.z + roi->zsize - 1;
+
+    if (!iftValidVoxel(target, begin) || !iftValidVoxel(target, u))
+        iftError("The ROI does not fit in the target image", "iftInsertROI");
+
+    if (iftIsColorImage(roi) && !iftIsColorImage(target))
+        iftSetCbCr(target, (iftMaxImageRange(iftImageDepth(roi))+1)/2);
+
+    q = 0;
+    for (v.z = begin.z; v.z <= u.z; v.z++)
+        for (v.y = begin.y; v.y <= u.y; v.y++) {
+            v.x = begin.x;
+            p   = iftGetVoxelIndex(target, v);
+            memcpy(&target->val[p], &roi->val[q], roi->xsize * sizeof(int));
+            if (iftIsColorImage(roi)) {
+                memcpy(&target->Cb[p], &roi->Cb[q], roi->xsize * sizeof(ushort));
+                memcpy(&target->Cr[p], &roi->Cr[q], roi->xsize * sizeof(ushort));
+            }
+            q += roi->xsize;
+        }
+}
+
+void iftROIIndexesToImage(iftIntArray *idx, const iftImage *roi, iftVoxel begin, const iftImage *img)
+{
+    for (long i = 0; i < idx->n; i++) {
+        iftVoxel u = iftGetVoxelCoord(roi, idx->val[i]);
+
+        u.x += begin.x;
+        u.y += begin.y;
+        u.z += begin.z;
+        idx->val[i] = iftGetVoxelIndex(img, u);
+    }
+}
+
 iftImage *iftReadImage(const char *format, ...) 
 {
     iftImage *img    = NULL;
@@ -2479,7 +2792,8 @@ iftImage *iftReadImage(const char *format, ...)
     ushort   *data16 = NULL;
     int      *data32 = NULL;
     char     type[10];
-    int      p, v, xsize, ysize, zsize;
+    iftIdx   p;
+    int      v, xsize, ysize, zsize;
 
     va_list args;
     char    filename[IFT_STR_DEFAULT_SIZE];
@@ -2543,6 +2857,160 @@ iftImage *iftReadImage(const char *format, ...)
     return (img);
 }
 
+/* Size of the LEB128 varint of a run length */
+int _iftVarintSize(iftIdx len)
+{
+    int size = 1;
+
+    for (; len >= 0x80; len >>= 7) size++;
+
+    return size;
+}
+
+void iftWriteLabelImage(const iftImage *label, bool compress, const char *format, ...)
+{
+    va_list args;
+    char filename[IFT_STR_DEFAULT_SIZE];
+    FILE *fp;
+    int min, max, nbytes;
+    size_t raw_size, k;
+    uLong stored_size;
+    uchar *raw, *stored;
+    iftIdx p, q;
+
+    va_start(args, format);
+    vsprintf(filename, format, args);
+    va_end(args);
+
+    iftMinMaxValues(label, &min, &max);
+    if (min < 0)
+        iftError("Negative labels are not permitted", "iftWriteLabelImage");
+
+    nbytes = (max <= 255) ? 1 : ((max <= 65535) ? 2 : 4);
+
+    // 1. Runs of equal labels, in raster order --------------------------------
+    raw_size = 0;
+    for (p = 0; p < label->n; p = q) {
+        for (q = p + 1; q < label->n && label->val[q] == label->val[p]; q++);
+        raw_size += nbytes + _iftVarintSize(q - p);
+    }
+
+    raw = iftAllocUCharArray(raw_size);
+    k = 0;
+    for (p = 0; p < label->n; p = q) {
+        iftIdx len;
+
+        for (q = p + 1; q < label->n && label->val[q] == label->val[p]; q++);
+
+        for (int b = 0; b < nbytes; b++) // little endian
+            raw[k++] = (label->val[p] >> (8*b)) & 0xff;
+        for (len = q - p; len >= 0x80; len >>= 7)
+            raw[k++] = (len & 0x7f) | 0x80;
+        raw[k++] = len;
+    }
+
+    // 2. Compression ----------------------------------------------------------
+    if (compress) {
+        stored_size = compressBound(raw_size);
+        stored = iftAllocUCharArray(stored_size);
+        if (compress2(stored, &stored_size, raw, raw_size, Z_BEST_SPEED) != Z_OK)
+            iftError("Compression error", "iftWriteLabelImage");
+        iftFree(raw);
+    }
+    else { stored = raw; stored_size = raw_size; }
+
+    // 3. Writing --------------------------------------------------------------
+    fp = fopen(filename, "wb");
+    if (fp == NULL)
+        iftError(MSG_FILE_OPEN_ERROR, "iftWriteLabelImage", filename);
+
+    fprintf(fp, "LBL\n%d %d %d\n%f %f %f\n%d %s %lu %lu\n", label->xsize, label->ysize,
+            label->zsize, label->dx, label->dy, label->dz, 8*nbytes,
+            compress ? "zlib" : "raw", (unsigned long)raw_size, (unsigned long)stored_size);
+    if (fwrite(stored, 1, stored_size, fp) != stored_size)
+        iftError("Writing error", "iftWriteLabelImage");
+
+    fclose(fp);
+    iftFree(stored);
+}
+
+iftImage *iftReadLabelImage(const char *format, ...)
+{
+    va_list args;
+    char filename[IFT_STR_DEFAULT_SIZE];
+    char type[10], codec[10];
+    FILE *fp;
+    int xsize, ysize, zsize, nbits;
+    unsigned long raw_size, stored_size;
+    uchar *raw, *stored;
+    size_t k;
+    iftIdx p;
+    iftImage *label;
+
+    va_start(args, format);
+    vsprintf(filename, format, args);
+    va_end(args);
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL)
+        iftError(MSG_FILE_OPEN_ERROR, "iftReadLabelImage", filename);
+
+    if (fscanf(fp, "%9s\n", type) != 1 || !iftCompareStrings(type, "LBL"))
+        iftError("Invalid file type", "iftReadLabelImage");
+    if (fscanf(fp, "%d %d %d\n", &xsize, &ysize, &zsize) != 3)
+        iftError("Reading error: Image resolution/size", "iftReadLabelImage");
+
+    label = iftCreateImage(xsize, ysize, zsize);
+    if (fscanf(fp, "%f %f %f\n", &label->dx, &label->dy, &label->dz) != 3)
+        iftError("Reading error: Pixel/Voxel size", "iftReadLabelImage");
+    if (fscanf(fp, "%d %9s %lu %lu", &nbits, codec, &raw_size, &stored_size) != 4 ||
+        (nbits != 8 && nbits != 16 && nbits != 32))
+        iftError("Reading error", "iftReadLabelImage");
+
+    while (fgetc(fp) != '\n');
+
+    stored = iftAllocUCharArray(stored_size);
+    if (fread(stored, 1, stored_size, fp) != stored_size)
+        iftError("Reading error", "iftReadLabelImage");
+    fclose(fp);
+
+    if (iftCompareStrings(codec, "zlib")) {
+        uLong size = raw_size;
+
+        raw = iftAllocUCharArray(raw_size);
+        if (uncompress(raw, &size, stored, stored_size) != Z_OK || size != raw_size)
+            iftError("Decompression error", "iftReadLabelImage");
+        iftFree(stored);
+    }
+    else if (iftCompareStrings(codec, "raw") && raw_size == stored_size) raw = stored;
+    else iftError("Invalid codec: %s", "iftReadLabelImage", codec);
+
+    // Runs of equal labels, in raster order
+    for (k = 0, p = 0; k < raw_size; ) {
+        int lb = 0, shift;
+        iftIdx len = 0;
+
+        if (k + nbits/8 > raw_size) break;
+        for (int b = 0; b < nbits/8; b++)
+            lb |= raw[k++] << (8*b);
+        for (shift = 0; k < raw_size; shift += 7) {
+            len |= (iftIdx)(raw[k] & 0x7f) << shift;
+            if (!(raw[k++] & 0x80)) break;
+        }
+
+        if (len > label->n - p)
+            iftError("Runs beyond the image", "iftReadLabelImage");
+        for (iftIdx q = p + len; p < q; p++) label->val[p] = lb;
+    }
+
+    if (p != label->n)
+        iftError("Runs do not cover the image", "iftReadLabelImage");
+
+    iftFree(raw);
+
+    return label;
+}
+
 png_bytep* iftReadPngImageAux(const char *file_name, png_structp *png_ptr, png_infop *info_ptr)
 {
     png_byte header[8];    // 8 is the maximum size that can be checked
@@ -2751,15 +3219,10 @@ iftImage* iftReadImagePNG(const char* format, ...)
     return img;
 }
 
-iftImage* iftReadImageJPEG(const char* format, ...) 
+/* Decodes a JPEG file at 1/scale_denom of its size, which libjpeg does
+   within the IDCT (i.e., at a fraction of the cost of the full decode) */
+iftImage *_iftReadImageJPEG(const char *filename, int scale_denom)
 {
-    va_list args;
-    char filename[IFT_STR_DEFAULT_SIZE];
-
-    va_start(args, format);
-    vsprintf(filename, format, args);
-    va_end(args);
-
     iftImage* image = NULL;
     //code based on externals/libjpeg/source/example.c
     /* This struct contains the JPEG decompression parameters and pointers to
@@ -2819,9 +3282,11 @@ iftImage* iftReadImageJPEG(const char* format, ...)
 
     /* Step 4: set parameters for decompression */
 
-    /* In this example, we don't need to change any of the defaults set by
-     * jpeg_read_header(), so we do nothing here.
+    /* The output is scaled by scale_num/scale_denom, and the sizes below are
+     * those of the scaled image (rounded up)
      */
+    cinfo.scale_num   = 1;
+    cinfo.scale_denom = scale_denom;
 
     /* Step 5: Start decompressor */
     (void) jpeg_start_decompress(&cinfo);
@@ -3001,6 +3466,34 @@ iftImage* iftReadImageJPEG(const char* format, ...)
     return image;
 }
 
+iftImage* iftReadImageJPEG(const char* format, ...) 
+{
+    va_list args;
+    char filename[IFT_STR_DEFAULT_SIZE];
+
+    va_start(args, format);
+    vsprintf(filename, format, args);
+    va_end(args);
+
+    return _iftReadImageJPEG(filename, 1);
+}
+
+iftImage *iftReadScaledImageJPEG(int scale_denom, const char *format, ...)
+{
+    va_list args;
+    char filename[IFT_STR_DEFAULT_SIZE];
+
+    va_start(args, format);
+    vsprintf(filename, format, args);
+    va_end(args);
+
+    if (scale_denom != 1 && scale_denom != 2 && scale_denom != 4 && scale_denom != 8)
+        iftError("Invalid scale denominator: %d (1, 2, 4 or 8)", "iftReadScaledImageJPEG",
+                 scale_denom);
+
+    return _iftReadImageJPEG(filename, scale_denom);
+}
+
 iftImage *iftReadImageP5(const char *format, ...) 
 {
     iftImage *img    = NULL;
@@ -3008,7 +3501,8 @@ iftImage *iftReadImageP5(const char *format, ...)
     uchar    *data8  = NULL;
     ushort   *data16 = NULL;
     char     type[10];
-    int      p, v, xsize, ysize, zsize, hi, lo;
+    iftIdx   p;
+    int      v, xsize, ysize, zsize, hi, lo;
 
     va_list args;
     char    filename[IFT_STR_DEFAULT_SIZE];
@@ -3086,7 +3580,8 @@ iftImage *iftReadImageP6(const char *format, ...)
     iftImage  *img=NULL;
     FILE    *fp=NULL;
     char    type[10];
-    int     p,v,xsize,ysize,zsize;
+    iftIdx  p;
+    int     v,xsize,ysize,zsize;
     ushort rgb16[3];
     iftColor RGB,YCbCr;
 
@@ -3174,7 +3669,8 @@ iftImage *iftReadImageP2(const char *format, ...)
     iftImage *img = NULL;
     FILE     *fp  = NULL;
     char     type[10];
-    int      p, v, xsize, ysize, zsize;
+    iftIdx   p;
+    int      v, xsize, ysize, zsize;
 
     va_list args;
     char    filename[IFT_STR_DEFAULT_SIZE];
@@ -3218,17 +3714,18 @@ iftImage *iftReadImageP2(const char *format, ...)
     return (img);
 }
 
-iftImage *iftCreateImageFromBuffer(int xsize, int ysize, int zsize, int *val) 
+iftImage *iftCreateImageDomain(int xsize, int ysize, int zsize)
 {
     iftImage *img = NULL;
-    int      y, z, xysize;
+    int      y, z;
+    iftIdx   xysize;
 
     img = (iftImage *) iftAlloc(1, sizeof(iftImage));
     if (img == NULL) {
-        iftError(MSG_MEMORY_ALLOC_ERROR, "iftCreateImage");
+        iftError(MSG_MEMORY_ALLOC_ERROR, "iftCreateImageDomain");
     }
 
-    img->val   = val;
+    img->val   = NULL;
     img->Cb    = img->Cr = NULL;
     img->alpha = NULL;
     img->xsize = xsize;
@@ -3237,12 +3734,12 @@ iftImage *iftCreateImageFromBuffer(int xsize, int ysize, int zsize, int *val)
     img->dx    = 1.0;
     img->dy    = 1.0;
     img->dz    = 1.0;
-    img->tby   = iftAllocIntArray(ysize);
-    img->tbz   = iftAllocIntArray(zsize);
-    img->n     = xsize * ysize * zsize;
+    img->tby   = iftAllocIdxArray(ysize);
+    img->tbz   = iftAllocIdxArray(zsize);
+    img->n     = (iftIdx)xsize * ysize * zsize;
 
-    if (img->val == NULL || img->tbz == NULL || img->tby == NULL) {
-        iftError(MSG_MEMORY_ALLOC_ERROR, "iftCreateImage");
+    if (img->tbz == NULL || img->tby == NULL) {
+        iftError(MSG_MEMORY_ALLOC_ERROR, "iftCreateImageDomain");
     }
 
     img->tby[0] = 0;
@@ -3250,16 +3747,30 @@ iftImage *iftCreateImageFromBuffer(int xsize, int ysize, int zsize, int *val)
         img->tby[y] = img->tby[y - 1] + xsize;
 
     img->tbz[0] = 0;
-    xysize = xsize * ysize;
+    xysize = (iftIdx)xsize * ysize;
     for (z = 1; z < zsize; z++)
         img->tbz[z] = img->tbz[z - 1] + xysize;
 
     return (img);
 }
 
+iftImage *iftCreateImageFromBuffer(int xsize, int ysize, int zsize, int *val) 
+{
+    iftImage *img = NULL;
+
+    if (val == NULL) {
+        iftError(MSG_MEMORY_ALLOC_ERROR, "iftCreateImage");
+    }
+
+    img      = iftCreateImageDomain(xsize, ysize, zsize);
+    img->val = val;
+
+    return (img);
+}
+
 void iftCopyImageInplace(const iftImage *src, iftImage *dest) 
 {
-    int p;
+    iftIdx p;
 
     iftVerifyImageDomains(src, dest, "iftCopyImageInplace");
 
@@ -3283,7 +3794,7 @@ void iftCopyImageInplace(const iftImage *src, iftImage *dest)
 void iftWriteImage(const iftImage *img, const char *format, ...) 
 {
     FILE   *fp     = NULL;
-    int    p;
+    iftIdx p;
     uchar  *data8  = NULL;
     ushort *data16 = NULL;
     int    *data32 = NULL;
@@ -3347,7 +3858,8 @@ void iftWriteImage(const iftImage *img, const char *format, ...)
 void iftWriteImageP5(const iftImage *img, const char *format, ...) 
 {
     FILE   *fp     = NULL;
-    int    p, hi, lo;
+    iftIdx p;
+    int    hi, lo;
     uchar  *data8  = NULL;
     ushort *data16 = NULL;
 
@@ -3404,7 +3916,7 @@ void iftWriteImageP5(const iftImage *img, const char *format, ...)
 void iftWriteImageP6(const iftImage *img, const char *format, ...) 
 {
     FILE     *fp = NULL;
-    int      p;
+    iftIdx   p;
     ushort   rgb16[3];
     iftColor YCbCr, RGB;
 
@@ -3479,7 +3991,7 @@ void iftWriteImageP6(const iftImage *img, const char *format, ...)
 void iftWriteImageP2(const iftImage *img, const char *format, ...) 
 {
     FILE *fp = NULL;
-    int  p;
+    iftIdx p;
 
     va_list args;
     char    filename[IFT_STR_DEFAULT_SIZE];
@@ -3565,18 +4077,14 @@ void iftWritePngImageAux(const char *file_name, png_bytep *row_pointers, int wid
     fclose(fp);
 }
 
-void iftWriteImagePNG(const iftImage* img, const char* format, ...) 
+/* Builds the PNG rows of the image (gray or RGB, with or without alpha, in
+   8 or 16 bits big endian, as iftWriteImagePNG stores them) */
+png_bytep *_iftImageToPNGRows(const iftImage *img, int *depth_out, png_byte *color_type_out,
+                              int *nchannels_out)
 {
     png_bytep *row_pointers;
     int width, height, depth, byteshift;
 
-    va_list args;
-    char filename[IFT_STR_DEFAULT_SIZE];
-
-    va_start(args, format);
-    vsprintf(filename, format, args);
-    va_end(args);
-
     width = img->xsize;
     height = img->ysize;
     png_byte color_type;
@@ -3728,11 +4236,20 @@ void iftWriteImagePNG(const iftImage* img, const char* format, ...)
     };
 
 
-    iftWritePngImageAux(filename, row_pointers, width, height, depth, color_type);
+
+    *depth_out      = depth;
+    *color_type_out = color_type;
+    *nchannels_out  = numberOfChannels;
+
+    return row_pointers;
 }
 
-void iftWriteImageJPEG(const iftImage* img, const char* format, ...)
+void iftWriteImagePNG(const iftImage* img, const char* format, ...) 
 {
+    png_bytep *row_pointers;
+    png_byte color_type;
+    int depth, nchannels;
+
     va_list args;
     char filename[IFT_STR_DEFAULT_SIZE];
 
@@ -3740,24 +4257,264 @@ void iftWriteImageJPEG(const iftImage* img, const char* format, ...)
     vsprintf(filename, format, args);
     va_end(args);
 
-    //code based on external/libjpeg/source/example.c
-    /* This struct contains the JPEG compression parameters and pointers to
- * working space (which is allocated as needed by the JPEG library).
- * It is possible to have several such structures, representing multiple
- * compression/decompression processes, in existence at once.  We refer
- * to any one struct (and its associated working data) as a "JPEG object".
- */
-    struct jpeg_compress_struct cinfo;
+    row_pointers = _iftImageToPNGRows(img, &depth, &color_type, &nchannels);
 
-    /* This struct represents a JPEG error handler.  It is declared separately
- * because applications often want to supply a specialized error handler
- * (see the second half of this file for an example).  But here we just
- * take the easy way out and use the standard error handler, which will
- * print a message on stderr and call exit() if compression fails.
- * Note that this struct must live as long as the main JPEG parameter
- * struct, to avoid dangling-pointer problems.
- */
-    struct jpeg_error_mgr jerr;
+    iftWritePngImageAux(filename, row_pointers, img->xsize, img->ysize, depth, color_type);
+}
+
+/* Paeth predictor of the PNG filter type 4 */
+static inline int _iftPaeth(int a, int b, int c)
+{
+    int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+
+    if (pa <= pb && pa <= pc) return a;
+    if (pb <= pc) return b;
+    return c;
+}
+
+/* Filters a PNG row by the given type (0 to 4) into out, whose first byte
+   is the type. prev is the previous row, or NULL for the first one. The
+   result is the sum of absolute (signed) filtered bytes. */
+long _iftFilterPNGRow(const uchar *row, const uchar *prev, int rowbytes, int bpp,
+                      int type, uchar *out)
+{
+    long sum = 0;
+    int i;
+
+    if (prev == NULL) { // i.e., a row of zeros: UP is NONE, and AVG and PAETH ~ SUB
+        if (type == IFT_PNG_FILTER_UP) type = IFT_PNG_FILTER_NONE;
+        else if (type == IFT_PNG_FILTER_PAETH) type = IFT_PNG_FILTER_SUB;
+    }
+
+    out[0] = type;
+    out++;
+
+    switch (type) {
+        case IFT_PNG_FILTER_SUB:
+            for (i = 0; i < bpp; i++) out[i] = row[i];
+            for (; i < rowbytes; i++) out[i] = row[i] - row[i - bpp];
+            break;
+        case IFT_PNG_FILTER_UP:
+            for (i = 0; i < rowbytes; i++) out[i] = row[i] - prev[i];
+            break;
+        case IFT_PNG_FILTER_AVG:
+            if (prev == NULL) {
+                for (i = 0; i < bpp; i++) out[i] = row[i];
+                for (; i < rowbytes; i++) out[i] = row[i] - (row[i - bpp] >> 1);
+            } else {
+                for (i = 0; i < bpp; i++) out[i] = row[i] - (prev[i] >> 1);
+                for (; i < rowbytes; i++) out[i] = row[i] - ((row[i - bpp] + prev[i]) >> 1);
+            }
+            break;
+        case IFT_PNG_FILTER_PAETH:
+            for (i = 0; i < bpp; i++) out[i] = row[i] - prev[i];
+            for (; i < rowbytes; i++)
+                out[i] = row[i] - _iftPaeth(row[i - bpp], prev[i], prev[i - bpp]);
+            break;
+        default:
+            memcpy(out, row, rowbytes);
+    }
+
+    for (i = 0; i < rowbytes; i++)
+        sum += (out[i] < 128) ? out[i] : 256 - out[i];
+
+    return sum;
+}
+
+/* As libpng's heuristic, the adaptive filter picks for each row the type
+   of minimum sum of absolute (signed) filtered bytes */
+void _iftAdaptiveFilterPNGRow(const uchar *row, const uchar *prev, int rowbytes, int bpp,
+                              uchar *out, uchar *tmp)
+{
+    long best_sum;
+    uchar *best;
+
+    best_sum = _iftFilterPNGRow(row, prev, rowbytes, bpp, IFT_PNG_FILTER_NONE, out);
+    best     = out;
+
+    for (int type = IFT_PNG_FILTER_SUB; type <= IFT_PNG_FILTER_PAETH; type++) {
+        uchar *cand = (best == out) ? tmp : out;
+        long sum;
+
+        if (prev == NULL && type != IFT_PNG_FILTER_SUB && type != IFT_PNG_FILTER_AVG)
+            continue; // the same as NONE or SUB
+
+        sum = _iftFilterPNGRow(row, prev, rowbytes, bpp, type, cand);
+        if (sum < best_sum) { best_sum = sum; best = cand; }
+    }
+
+    if (best != out) memcpy(out, best, rowbytes + 1);
+}
+
+void _iftWritePNGChunk(FILE *fp, const char *type, const uchar *data, size_t size)
+{
+    uchar be[4] = { (size >> 24) & 0xff, (size >> 16) & 0xff, (size >> 8) & 0xff, size & 0xff };
+    uLong crc;
+
+    crc = crc32(0L, (const Bytef *)type, 4);
+    if (size > 0) crc = crc32(crc, data, size); // a NULL buffer would reset it
+
+    if (fwrite(be, 1, 4, fp) != 4 || fwrite(type, 1, 4, fp) != 4 ||
+        (size > 0 && fwrite(data, 1, size, fp) != size))
+        iftError("Writing error", "_iftWritePNGChunk");
+
+    be[0] = (crc >> 24) & 0xff; be[1] = (crc >> 16) & 0xff;
+    be[2] = (crc >> 8) & 0xff;  be[3] = crc & 0xff;
+    if (fwrite(be, 1, 4, fp) != 4)
+        iftError("Writing error", "_iftWritePNGChunk");
+}
+
+void iftWriteImagePNGParallel(const iftImage *img, int level, int filter, const char *format, ...)
+{
+    va_list args;
+    char filename[IFT_STR_DEFAULT_SIZE];
+    png_bytep *rows;
+    png_byte color_type;
+    int depth, nchannels, bpp, rowbytes, rows_per_chunk, nchunks;
+    uchar **zdata, header[13], zhead[2], trailer[4];
+    size_t *zsize;
+    uLong *adler, *ilen, total_adler;
+    FILE *fp;
+
+    va_start(args, format);
+    vsprintf(filename, format, args);
+    va_end(args);
+
+    if (level < 0 || level > 9)
+        iftError("Invalid compression level: %d (0 to 9)", "iftWriteImagePNGParallel", level);
+    if (filter < IFT_PNG_FILTER_NONE || filter > IFT_PNG_FILTER_ADAPTIVE)
+        iftError("Invalid filter: %d", "iftWriteImagePNGParallel", filter);
+
+    rows     = _iftImageToPNGRows(img, &depth, &color_type, &nchannels);
+    bpp      = nchannels * depth/8;
+    rowbytes = img->xsize * bpp;
+
+    // 1. Row groups of about 1 MB, each an independent raw deflate stream --
+    // Every group but the last ends with a sync flush, i.e., on a byte
+    // boundary, so that their concatenation is a single deflate stream
+    rows_per_chunk = iftMax(1, (1 << 20) / (rowbytes + 1));
+    nchunks        = (img->ysize + rows_per_chunk - 1) / rows_per_chunk;
+    zdata          = (uchar **) iftAlloc(nchunks, sizeof(uchar *));
+    zsize          = (size_t *) iftAlloc(nchunks, sizeof(size_t));
+    adler          = (uLong *) iftAlloc(nchunks, sizeof(uLong));
+    ilen           = (uLong *) iftAlloc(nchunks, sizeof(uLong));
+
+#pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < nchunks; c++) {
+        int y0 = c * rows_per_chunk, y1 = iftMin(img->ysize, y0 + rows_per_chunk);
+        uchar *filtered, *tmp;
+        z_stream zs;
+
+        ilen[c]  = (uLong)(y1 - y0) * (rowbytes + 1);
+        filtered = iftAllocUCharArray(ilen[c]);
+        tmp      = iftAllocUCharArray(rowbytes + 1);
+
+        for (int y = y0; y < y1; y++) {
+            uchar *out = filtered + (size_t)(y - y0) * (rowbytes + 1);
+            const uchar *prev = (y > 0) ? rows[y - 1] : NULL;
+
+            if (filter == IFT_PNG_FILTER_ADAPTIVE)
+                _iftAdaptiveFilterPNGRow(rows[y], prev, rowbytes, bpp, out, tmp);
+            else _iftFilterPNGRow(rows[y], prev, rowbytes, bpp, filter, out);
+        }
+        adler[c] = adler32(adler32(0L, Z_NULL, 0), filtered, ilen[c]);
+
+        memset(&zs, 0, sizeof(zs));
+        if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            iftError("Compression error", "iftWriteImagePNGParallel");
+
+        zsize[c]     = deflateBound(&zs, ilen[c]) + 16; // room for the flush marker
+        zdata[c]     = iftAllocUCharArray(zsize[c]);
+        zs.next_in   = filtered;
+        zs.avail_in  = ilen[c];
+        zs.next_out  = zdata[c];
+        zs.avail_out = zsize[c];
+
+        if (deflate(&zs, (c == nchunks - 1) ? Z_FINISH : Z_SYNC_FLUSH) == Z_STREAM_ERROR ||
+            zs.avail_in != 0)
+            iftError("Compression error", "iftWriteImagePNGParallel");
+
+        zsize[c] = zsize[c] - zs.avail_out;
+        deflateEnd(&zs);
+
+        iftFree(filtered);
+        iftFree(tmp);
+    }
+
+    for (int y = 0; y < img->ysize; y++)
+        iftFree(rows[y]);
+    iftFree(rows);
+
+    // 2. PNG chunks, with the groups stitched into a single zlib stream -----
+    fp = fopen(filename, "wb");
+    if (fp == NULL)
+        iftError(MSG_FILE_OPEN_ERROR, "iftWriteImagePNGParallel", filename);
+
+    if (fwrite("\211PNG\r\n\032\n", 1, 8, fp) != 8)
+        iftError("Writing error", "iftWriteImagePNGParallel");
+
+    for (int i = 0; i < 4; i++) {
+        header[i]     = (img->xsize >> (24 - 8*i)) & 0xff;
+        header[4 + i] = (img->ysize >> (24 - 8*i)) & 0xff;
+    }
+    header[8]  = depth;
+    header[9]  = color_type;
+    header[10] = header[11] = header[12] = 0; // deflate, adaptive filtering, no interlace
+    _iftWritePNGChunk(fp, "IHDR", header, 13);
+
+    // zlib header: 32K window, and the level hint
+    zhead[0] = 0x78;
+    zhead[1] = ((level <= 1) ? 0 : ((level <= 5) ? 1 : ((level == 6) ? 2 : 3))) << 6;
+    zhead[1] += 31 - ((zhead[0] << 8) + zhead[1]) % 31;
+    _iftWritePNGChunk(fp, "IDAT", zhead, 2);
+
+    total_adler = adler[0];
+    for (int c = 0; c < nchunks; c++) {
+        if (c > 0) total_adler = adler32_combine(total_adler, adler[c], ilen[c]);
+        _iftWritePNGChunk(fp, "IDAT", zdata[c], zsize[c]);
+        iftFree(zdata[c]);
+    }
+
+    for (int i = 0; i < 4; i++)
+        trailer[i] = (total_adler >> (24 - 8*i)) & 0xff;
+    _iftWritePNGChunk(fp, "IDAT", trailer, 4);
+    _iftWritePNGChunk(fp, "IEND", NULL, 0);
+
+    fclose(fp);
+
+    iftFree(zdata);
+    iftFree(zsize);
+    iftFree(adler);
+    iftFree(ilen);
+}
+
+void iftWriteImageJPEG(const iftImage* img, const char* format, ...)
+{
+    va_list args;
+    char filename[IFT_STR_DEFAULT_SIZE];
+
+    va_start(args, format);
+    vsprintf(filename, format, args);
+    va_end(args);
+
+    //code based on external/libjpeg/source/example.c
+    /* This struct contains the JPEG compression parameters and pointers to
+ * working space (which is allocated as needed by the JPEG library).
+ * It is possible to have several such structures, representing multiple
+ * compression/decompression processes, in existence at once.  We refer
+ * to any one struct (and its associated working data) as a "JPEG object".
+ */
+    struct jpeg_compress_struct cinfo;
+
+    /* This struct represents a JPEG error handler.  It is declared separately
+ * because applications often want to supply a specialized error handler
+ * (see the second half of this file for an example).  But here we just
+ * take the easy way out and use the standard error handler, which will
+ * print a message on stderr and call exit() if compression fails.
+ * Note that this struct must live as long as the main JPEG parameter
+ * struct, to avoid dangling-pointer problems.
+ */
+    struct jpeg_error_mgr jerr;
 
     /* More stuff */
     FILE * outfile;		/* target file */
@@ -3882,7 +4639,7 @@ int iftMaximumValueInRegion(const iftImage *img, iftBoundingBox bb)
     for (v.z = bb.begin.z; v.z <= bb.end.z; v.z++) {
         for (v.y = bb.begin.y; v.y <= bb.end.y; v.y++) {
             for (v.x = bb.begin.x; v.x <= bb.end.x; v.x++) {
-                int p = iftGetVoxelIndex(img, v);
+                iftIdx p = iftGetVoxelIndex(img, v);
                 if (img_max_val < img->val[p]) {
                     img_max_val = img->val[p];
                 }
@@ -3895,13 +4652,13 @@ int iftMaximumValueInRegion(const iftImage *img, iftBoundingBox bb)
 
 void iftSetImage(iftImage *img, int value) 
 {
-    for (int p = 0; p < img->n; p++)
+    for (iftIdx p = 0; p < img->n; p++)
         img->val[p] = value;
 }
 
 void  iftSetAlpha(iftImage *img, ushort value)
 {
-    int p;
+    iftIdx p;
     if(img->alpha == NULL){
         img->alpha = iftAllocUShortArray(img->n);
     }
@@ -3913,7 +4670,7 @@ void  iftSetAlpha(iftImage *img, ushort value)
 
 void    iftSetCbCr(iftImage *img, ushort value)
 {
-    int p;
+    iftIdx p;
 
     if (!iftIsColorImage(img)){
         img->Cb = iftAllocUShortArray(img->n);
@@ -3963,9 +4720,9 @@ void iftMinMaxValues(const iftImage *img, int *min, int *max)
     }
 }
 
-int iftNumberOfElements(const iftImage *mask)
+iftIdx iftNumberOfElements(const iftImage *mask)
 {
-    int p, nnodes = 0;
+    iftIdx p, nnodes = 0;
 
     for (p=0; p < mask->n; p++)
         if (mask->val[p]>0){
@@ -4008,14 +4765,14 @@ iftImage *iftImageGradientMagnitude(const iftImage *img, iftAdjRel *Ain)
 #pragma omp parallel for shared(z,y,A,img,weight,grad) private(u,v,gx,gy,gz,i,dist)
                     for (int x=0; x < img->xsize; x++) {
                         u.x=x; u.y=y; u.z=z;
-                        int p = iftGetVoxelIndex(img,u);
+                        iftIdx p = iftGetVoxelIndex(img,u);
                         gx = gy = gz = 0.0;
                         for (i=1; i < A->n; i++) {
                             v.x = u.x + A->dx[i];
                             v.y = u.y + A->dy[i];
                             v.z = u.z + A->dz[i];
                             if (iftValidVoxel(img,v)){
-                                int q = iftGetVoxelIndex(img,v);
+                                iftIdx q = iftGetVoxelIndex(img,v);
                                 dist = img->val[q]-img->val[p];
                                 gx  += dist*A->dx[i]*weight[i];
                                 gy  += dist*A->dy[i]*weight[i];
@@ -4030,7 +4787,7 @@ iftImage *iftImageGradientMagnitude(const iftImage *img, iftAdjRel *Ain)
 #pragma omp parallel for shared(z,y,A,img,weight,grad) private(u,v,gx,gy,gz,i,dist,gxCb,gyCb,gzCb,gxCr,gyCr,gzCr,gmax,g)
                     for (int x=0; x < img->xsize; x++) {
                         u.x=x; u.y=y; u.z=z;
-                        int p = iftGetVoxelIndex(img,u);
+                        iftIdx p = iftGetVoxelIndex(img,u);
                         gx = gy = gz = 0.0;
                         gxCb = gyCb = gzCb = 0.0;
                         gxCr = gyCr = gzCr = 0.0;
@@ -4039,7 +4796,7 @@ iftImage *iftImageGradientMagnitude(const iftImage *img, iftAdjRel *Ain)
                             v.y = u.y + A->dy[i];
                             v.z = u.z + A->dz[i];
                             if (iftValidVoxel(img,v)){
-                                int q = iftGetVoxelIndex(img,v);
+                                iftIdx q = iftGetVoxelIndex(img,v);
                                 dist = img->val[q]-img->val[p];
                                 gx  += dist*A->dx[i]*weight[i];
                                 gy  += dist*A->dy[i]*weight[i];
@@ -4107,7 +4864,8 @@ iftImage  *iftCreateColorImage(int xsize,int ysize,int zsize, int depth)
 iftImage *iftComplement(const iftImage *img)
 {
   iftImage *cimg=NULL;
-  int p, maxval;
+  iftIdx p;
+  int maxval;
 
   if (iftIsColorImage(img)){
     cimg   = iftCreateColorImage(img->xsize,img->ysize,img->zsize, iftImageDepth(img));
@@ -4131,10 +4889,17 @@ iftImage *iftComplement(const iftImage *img)
 // ---------- iftImageMath.c end
 // ---------- iftFImage.c start 
 
+#ifndef _WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 iftFImage *iftCreateFImage(int xsize, int ysize, int zsize) 
 {
     iftFImage *img = NULL;
-    int       y, z, xysize;
+    int       y, z;
+    iftIdx    xysize;
 
 
     img = (iftFImage *) iftAlloc(1, sizeof(iftFImage));
@@ -4142,16 +4907,16 @@ iftFImage *iftCreateFImage(int xsize, int ysize, int zsize)
         iftError(MSG_MEMORY_ALLOC_ERROR, "iftCreateFImage");
     }
 
-    img->val   = iftAllocFloatArray(xsize * ysize * zsize);
+    img->val   = iftAllocFloatArray((iftIdx)xsize * ysize * zsize);
     img->xsize = xsize;
     img->ysize = ysize;
     img->zsize = zsize;
     img->dx    = 1.0;
     img->dy    = 1.0;
     img->dz    = 1.0;
-    img->tby   = iftAllocIntArray(ysize);
-    img->tbz   = iftAllocIntArray(zsize);
-    img->n     = xsize * ysize * zsize;
+    img->tby   = iftAllocIdxArray(ysize);
+    img->tbz   = iftAllocIdxArray(zsize);
+    img->n     = (iftIdx)xsize * ysize * zsize;
 
     if (img->val == NULL || img->tbz == NULL || img->tby == NULL) {
         iftError(MSG_MEMORY_ALLOC_ERROR, "iftCreateFImage");
@@ -4162,7 +4927,7 @@ iftFImage *iftCreateFImage(int xsize, int ysize, int zsize)
         img->tby[y] = img->tby[y - 1] + xsize;
 
     img->tbz[0] = 0;
-    xysize = xsize * ysize;
+    xysize = (iftIdx)xsize * ysize;
     for (z = 1; z < zsize; z++)
         img->tbz[z] = img->tbz[z - 1] + xysize;
 
@@ -4175,6 +4940,10 @@ void iftDestroyFImage(iftFImage **img)
 
     aux = *img;
     if (aux != NULL) {
+#ifndef _WINDOWS
+        if (aux->map != NULL) munmap(aux->map, aux->map_size);
+        else
+#endif
         if (aux->val != NULL) iftFree(aux->val);
         if (aux->tby != NULL) iftFree(aux->tby);
         if (aux->tbz != NULL) iftFree(aux->tbz);
@@ -4183,13 +4952,13 @@ void iftDestroyFImage(iftFImage **img)
     }
 }
 
-iftVoxel iftFGetVoxelCoord(const iftFImage *img, int p) 
+iftVoxel iftFGetVoxelCoord(const iftFImage *img, iftIdx p) 
 {
     iftVoxel u;
 
-    u.x = iftFGetXCoord(img, p);
-    u.y = iftFGetYCoord(img, p);
-    u.z = iftFGetZCoord(img, p);
+    u.x = (int)iftFGetXCoord(img, p);
+    u.y = (int)iftFGetYCoord(img, p);
+    u.z = (int)iftFGetZCoord(img, p);
 
     return (u);
 }
@@ -4204,12 +4973,157 @@ char iftFValidVoxel(const iftFImage *img, iftVoxel v)
         return (0);
 }
 
+iftFImage *iftReadRawFImage(const char *filename, int xsize, int ysize, int zsize)
+{
+    iftFImage *img;
+    size_t size;
+
+    img  = iftCreateFImage(xsize, ysize, zsize);
+    size = img->n * sizeof(float);
+    iftFree(img->val); // replaced by the file's pages
+
+#ifndef _WINDOWS
+    int fd;
+    struct stat st;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        iftError(MSG_FILE_OPEN_ERROR, "iftReadRawFImage", filename);
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != size)
+        iftError("File %s does not hold %d x %d x %d floats", "iftReadRawFImage",
+                 filename, xsize, ysize, zsize);
+
+    // Private (i.e., copy-on-write) mapping, so val may still be modified
+    img->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (img->map == MAP_FAILED)
+        iftError("Could not map file %s", "iftReadRawFImage", filename);
+
+    img->val      = (float *)img->map;
+    img->map_size = size;
+#else
+    FILE *fp;
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL)
+        iftError(MSG_FILE_OPEN_ERROR, "iftReadRawFImage", filename);
+
+    img->val = iftAllocFloatArray(img->n);
+    if (fread(img->val, sizeof(float), img->n, fp) != (size_t)img->n || fgetc(fp) != EOF)
+        iftError("File %s does not hold %d x %d x %d floats", "iftReadRawFImage",
+                 filename, xsize, ysize, zsize);
+    fclose(fp);
+#endif
+
+    return img;
+}
+
+/* Gray PFM, whose rows are stored bottom-to-top and whose negative scale
+   indicates little-endian values */
+iftFImage *_iftReadFImagePFM(const char *filename)
+{
+    FILE *fp;
+    char type[3];
+    int xsize, ysize;
+    float scale;
+    bool swap;
+    union { unsigned int i; uchar c[4]; } endian = { 1 };
+    iftFImage *img;
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL)
+        iftError(MSG_FILE_OPEN_ERROR, "_iftReadFImagePFM", filename);
+
+    if (fscanf(fp, "%2s", type) != 1 || fscanf(fp, "%d %d", &xsize, &ysize) != 2 ||
+        fscanf(fp, "%f", &scale) != 1)
+        iftError("Reading error", "_iftReadFImagePFM");
+    if (!iftCompareStrings(type, "Pf"))
+        iftError("Only gray (Pf) PFM files are supported", "_iftReadFImagePFM");
+
+    fgetc(fp); // single whitespace before the data
+
+    img  = iftCreateFImage(xsize, ysize, 1);
+    swap = ((scale < 0.0) != (endian.c[0] == 1));
+
+    for (int y = ysize - 1; y >= 0; y--) {
+        float *row = &img->val[img->tby[y]];
+
+        if (fread(row, sizeof(float), xsize, fp) != (size_t)xsize)
+            iftError("Reading error", "_iftReadFImagePFM");
+
+        if (swap)
+            for (int x = 0; x < xsize; x++) {
+                uchar *b = (uchar *)&row[x], t;
+
+                t = b[0]; b[0] = b[3]; b[3] = t;
+                t = b[1]; b[1] = b[2]; b[2] = t;
+            }
+    }
+
+    fclose(fp);
+
+    return img;
+}
+
+iftFImage *iftReadFImageByExt(const char *format, ...)
+{
+    va_list args;
+    char filename[IFT_STR_DEFAULT_SIZE];
+    iftFImage *fimg;
+
+    va_start(args, format);
+    vsprintf(filename, format, args);
+    va_end(args);
+
+    if (!iftFileExists(filename))
+        iftError("Image %s does not exist", "iftReadFImageByExt", filename);
+
+    if (iftEndsWith(filename, ".pfm") || iftEndsWith(filename, ".PFM"))
+        fimg = _iftReadFImagePFM(filename);
+    else {
+        iftImage *img = iftReadImageByExt(filename);
+
+        fimg = iftCreateFImage(img->xsize, img->ysize, img->zsize);
+        iftCopyVoxelSize(img, fimg);
+        for (iftIdx p = 0; p < img->n; p++)
+            fimg->val[p] = img->val[p];
+
+        iftDestroyImage(&img);
+    }
+
+    return fimg;
+}
+
+iftImage *iftFImageToImage(const iftFImage *img, int Imax)
+{
+    iftImage *out;
+    float min, max;
+
+    min = IFT_INFINITY_FLT;
+    max = IFT_INFINITY_FLT_NEG;
+    for (iftIdx p = 0; p < img->n; p++) {
+        if (img->val[p] < min) min = img->val[p];
+        if (img->val[p] > max) max = img->val[p];
+    }
+
+    out = iftCreateImage(img->xsize, img->ysize, img->zsize);
+    iftCopyVoxelSize(img, out);
+
+    if (max > min)
+        for (iftIdx p = 0; p < img->n; p++)
+            out->val[p] = iftRound(Imax * (img->val[p] - min) / (max - min));
+
+    return out;
+}
+
 // ---------- iftFImage.c end 
 // ---------- iftGraphics.c start
 
 void iftDrawPoint(iftImage *img, iftVoxel u, iftColor YCbCr, iftAdjRel *B, int normValue)
 {
-    int q,i;
+    iftIdx q;
+    int i;
     iftVoxel v;
 
     if (!iftValidVoxel(img,u))
@@ -4238,42 +5152,105 @@ void iftDrawPoint(iftImage *img, iftVoxel u, iftColor YCbCr, iftAdjRel *B, int n
 
 }
 
-void iftDrawBorders(iftImage *img, iftImage *label, iftAdjRel *A, iftColor YCbCr, iftAdjRel *B)
+/* Paints every voxel reached by the brush B from a voxel of the bitmap,
+   by blending its YCbCr values with the given color. The loop runs over
+   the painted voxels, so each one is written only once. */
+void _iftPaintBMap(iftImage *img, const iftBMap *bmap, iftColor YCbCr, const iftAdjRel *B, float alpha, int maxRangeValue)
 {
-    iftVoxel u,v;
-    int i,p,q;
-    int maxRangeValue = iftNormalizationValue(iftMaximumValue(img));
-
-    if ((img->xsize != label->xsize)||
-        (img->ysize != label->ysize)||
-        (img->zsize != label->zsize))
-        iftError("Images must have the same domain", "iftDrawBorders");
-
-
     if (!iftIsColorImage(img))
         iftSetCbCr(img,maxRangeValue/2);
 
-    if (A->n > 1){
-        for (p=0; p < img->n; p++) {
-            u = iftGetVoxelCoord(label,p);
-            for (i=0; i < A->n; i++) {
-                v = iftGetAdjacentVoxel(A,u,i);
-                if (iftValidVoxel(label,v)){
-                    q = iftGetVoxelIndex(label,v);
-                    if (label->val[p] != label->val[q]){
-                        iftDrawPoint(img, u, YCbCr, B, maxRangeValue);
-                        break;
-                    }
-                }
+    #pragma omp parallel for
+    for (iftIdx q=0; q < img->n; q++) {
+        bool painted = false;
+
+        if (B->n == 1 && B->dx[0] == 0 && B->dy[0] == 0 && B->dz[0] == 0)
+            painted = iftBMapValue(bmap,q);
+        else {
+            iftVoxel v = iftGetVoxelCoord(img,q);
+            for (int i=0; i < B->n && !painted; i++) {
+                iftVoxel u;
+                u.x = v.x - B->dx[i];
+                u.y = v.y - B->dy[i];
+                u.z = v.z - B->dz[i];
+                if (iftValidVoxel(img,u))
+                    painted = iftBMapValue(bmap,iftGetVoxelIndex(img,u));
             }
         }
-    } else {
-        for (p=0; p < img->n; p++)
-            if (label->val[p] != 0){
-                u = iftGetVoxelCoord(label,p);
-                iftDrawPoint(img, u, YCbCr, B, maxRangeValue);
+
+        if (painted) {
+            if (alpha >= 1.0) {
+                img->val[q] = YCbCr.val[0];
+                img->Cb[q]  = (ushort) YCbCr.val[1];
+                img->Cr[q]  = (ushort) YCbCr.val[2];
+            } else {
+                img->val[q] = iftRound((1.0-alpha)*img->val[q] + alpha*YCbCr.val[0]);
+                img->Cb[q]  = (ushort) iftRound((1.0-alpha)*img->Cb[q] + alpha*YCbCr.val[1]);
+                img->Cr[q]  = (ushort) iftRound((1.0-alpha)*img->Cr[q] + alpha*YCbCr.val[2]);
             }
+        }
+    }
+}
+
+iftBMap *iftBorderBMap(const iftImage *label, const iftAdjRel *A)
+{
+    iftBMap *border = iftCreateBMap(label->n);
+
+    /* each thread fills whole bytes, so no bit is shared among threads */
+    #pragma omp parallel for
+    for (int b=0; b < border->nbytes; b++) {
+        char byte = 0;
+
+        for (int j=0; j < 8 && 8*b+j < label->n; j++) {
+            int  p        = 8*b+j;
+            bool isBorder = false;
+
+            if (A->n > 1) {
+                iftVoxel u = iftGetVoxelCoord(label,p);
+                for (int i=0; i < A->n && !isBorder; i++) {
+                    iftVoxel v = iftGetAdjacentVoxel(A,u,i);
+                    if (iftValidVoxel(label,v))
+                        isBorder = (label->val[p] != label->val[iftGetVoxelIndex(label,v)]);
+                }
+            } else
+                isBorder = (label->val[p] != 0);
+
+            if (isBorder)
+                byte |= (1 << j);
+        }
+        border->val[b] = byte;
     }
+
+    return border;
+}
+
+void iftDrawBorderBMap(iftImage *img, const iftBMap *border, iftColor RGB, const iftAdjRel *B, float alpha)
+{
+    if (img->n != border->n)
+        iftError("Image and bitmap must have the same size", "iftDrawBorderBMap");
+    if ((alpha < 0.0)||(alpha > 1.0))
+        iftError("Invalid opacity %f", "iftDrawBorderBMap", alpha);
+
+    /* the RGB to YCbCr conversion is affine, so blending in YCbCr is
+       the same as blending in RGB */
+    int      maxRangeValue = iftNormalizationValue(iftMaximumValue(img));
+    iftColor YCbCr         = iftRGBtoYCbCr(RGB, maxRangeValue);
+
+    _iftPaintBMap(img, border, YCbCr, B, alpha, maxRangeValue);
+}
+
+void iftDrawBorders(iftImage *img, iftImage *label, iftAdjRel *A, iftColor YCbCr, iftAdjRel *B)
+{
+    if ((img->xsize != label->xsize)||
+        (img->ysize != label->ysize)||
+        (img->zsize != label->zsize))
+        iftError("Images must have the same domain", "iftDrawBorders");
+
+    int      maxRangeValue = iftNormalizationValue(iftMaximumValue(img));
+    iftBMap *border        = iftBorderBMap(label,A);
+
+    _iftPaintBMap(img, border, YCbCr, B, 1.0, maxRangeValue);
+    iftDestroyBMap(&border);
 }
 
 void iftDrawBordersSingleLabel(iftImage *img, iftImage *labelMap, const int label, iftColor YCbCr)
@@ -4290,7 +5267,7 @@ void iftDrawBordersSingleLabel(iftImage *img, iftImage *labelMap, const int labe
   iftAdjRel *A = iftCircular(1.0);
   iftAdjRel *brushShape = iftCircular(1.0);
   
-  for (int p = 0; p < img->n; ++p) {
+  for (iftIdx p = 0; p < img->n; ++p) {
     if (labelMap->val[p] != label)
       continue;
 
@@ -4299,7 +5276,7 @@ void iftDrawBordersSingleLabel(iftImage *img, iftImage *labelMap, const int labe
     for (int i = 1; i < A->n; ++i) {
       iftVoxel v = iftGetAdjacentVoxel(A, u, i);
       if (iftValidVoxel(labelMap, v)) {
-        int q = iftGetVoxelIndex(labelMap, v);
+        iftIdx q = iftGetVoxelIndex(labelMap, v);
 
         if (label != labelMap->val[q]) {
           iftDrawPoint(img, u, YCbCr, brushShape, maxRangeValue);
@@ -4313,21 +5290,22 @@ void iftDrawBordersSingleLabel(iftImage *img, iftImage *labelMap, const int labe
 // ---------- iftGraphics.c end
 // ---------- iftMatrix.c start 
 
-iftMatrix *iftCreateMatrix(int ncols, int nrows) 
+iftMatrix *iftCreateMatrix(int ncols, iftIdx nrows) 
 {
     iftMatrix *M = (iftMatrix *) iftAlloc(1, sizeof(iftMatrix));
     
     M->ncols = ncols;
     M->nrows = nrows;
-    M->tbrow = (long*)iftAlloc(nrows,sizeof(long));
+    M->tbrow = (long*)iftAllocFirstTouch(nrows,sizeof(long));
     //M->tbrow = iftAllocIntArray(nrows);
+#pragma omp parallel for schedule(static)
     for (long r = 0; r < (long)nrows; r++) {
         M->tbrow[r] = r * ncols;
     }
     M->n = (long) ncols * (long) nrows;
     M->allocated = true;
     
-    M->val = iftAllocFloatArray(M->n);
+    M->val = (float *)iftAllocFirstTouch(M->n, sizeof(float));
     
     return (M);
 }
@@ -4412,17 +5390,19 @@ iftStrMatrix *iftCreateStrMatrix(int ncols, int nrows)
 iftMImage * iftCreateMImage(int xsize,int ysize,int zsize, int nbands)
 {
   iftMImage *img=NULL;
-  int        i,y,z,xysize;
+  int        y,z;
+  iftIdx     i,xysize;
 
   img = (iftMImage *) iftAlloc(1,sizeof(iftMImage));
   if (img == NULL){
       iftError(MSG_MEMORY_ALLOC_ERROR, "iftCreateMImage");
   }
 
-  img->n       = xsize*ysize*zsize;
+  img->n       = (iftIdx)xsize*ysize*zsize;
   img->m       = nbands;
   img->data    = iftCreateMatrix(img->m, img->n);
-  img->val     = iftAlloc(img->n, sizeof *img->val);
+  img->val     = iftAllocFirstTouch(img->n, sizeof *img->val);
+#pragma omp parallel for schedule(static)
   for (i = 0; i < img->n; i++)
       img->val[i] = iftMatrixRowPointer(img->data, i);
   img->xsize   = xsize;
@@ -4431,14 +5411,14 @@ iftMImage * iftCreateMImage(int xsize,int ysize,int zsize, int nbands)
   img->dx      = 1.0;
   img->dy      = 1.0;
   img->dz      = 1.0;
-  img->tby     = iftAllocIntArray(ysize);
-  img->tbz     = iftAllocIntArray(zsize);
+  img->tby     = iftAllocIdxArray(ysize);
+  img->tbz     = iftAllocIdxArray(zsize);
 
   img->tby[0]=0;
   for (y=1; y < ysize; y++)
     img->tby[y]=img->tby[y-1] + xsize;
 
-  img->tbz[0]=0; xysize = xsize*ysize;
+  img->tbz[0]=0; xysize = (iftIdx)xsize*ysize;
   for (z=1; z < zsize; z++)
     img->tbz[z]=img->tbz[z-1] + xysize;
 
@@ -4474,7 +5454,7 @@ iftMImage * iftImageToMImage(const iftImage *img1, char color_space)
   case YCbCr_CSPACE:
     img2=iftCreateMImage(img1->xsize,img1->ysize,img1->zsize,3);
 #pragma omp parallel for shared(img1, img2, normalization_value)
-    for (int p=0; p < img2->n; p++) {
+    for (iftIdx p=0; p < img2->n; p++) {
       img2->val[p][0]=((float)img1->val[p]);
       img2->val[p][1]=((float)img1->Cb[p]);
       img2->val[p][2]=((float)img1->Cr[p]);
@@ -4485,7 +5465,7 @@ iftMImage * iftImageToMImage(const iftImage *img1, char color_space)
 
     img2=iftCreateMImage(img1->xsize,img1->ysize,img1->zsize,3);
 #pragma omp parallel for shared(img1, img2, normalization_value)
-    for (int p=0; p < img2->n; p++) {
+    for (iftIdx p=0; p < img2->n; p++) {
       img2->val[p][0]=((float)img1->val[p])/(float)normalization_value;
       img2->val[p][1]=((float)img1->Cb[p])/(float)normalization_value;
       img2->val[p][2]=((float)img1->Cr[p])/(float)normalization_value;
@@ -4496,7 +5476,7 @@ iftMImage * iftImageToMImage(const iftImage *img1, char color_space)
 
     img2=iftCreateMImage(img1->xsize,img1->ysize,img1->zsize,3);
 #pragma omp parallel for shared(img1, img2, normalization_value)
-    for (int p=0; p < img2->n; p++) {
+    for (iftIdx p=0; p < img2->n; p++) {
       iftColor  YCbCr,RGB;
       iftFColor Lab;
       YCbCr.val[0] = img1->val[p];
@@ -4510,29 +5490,35 @@ iftMImage * iftImageToMImage(const iftImage *img1, char color_space)
     }
     break;
 
-    case LABNorm_CSPACE:
+    case LABNorm_CSPACE: {
+      const float *lut = _iftSRGBLinearTable(normalization_value);
 
       img2=iftCreateMImage(img1->xsize,img1->ysize,img1->zsize,3);
 #pragma omp parallel for shared(img1, img2, normalization_value)
-      for (int p=0; p < img2->n; p++) {
+      for (iftIdx p=0; p < img2->n; p++) {
         iftColor  YCbCr,RGB;
         iftFColor Lab;
         YCbCr.val[0] = img1->val[p];
         YCbCr.val[1] = img1->Cb[p];
         YCbCr.val[2] = img1->Cr[p];
         RGB = iftYCbCrtoRGB(YCbCr,normalization_value);
+        if (lut != NULL) { // 8- or 16-bit: fast kernel
+          _iftLinearRGBtoLabNorm(lut[RGB.val[0]], lut[RGB.val[1]], lut[RGB.val[2]], img2->val[p]);
+          continue;
+        }
         Lab = iftRGBtoLabNorm(RGB,normalization_value);
         img2->val[p][0]=Lab.val[0];
         img2->val[p][1]=Lab.val[1];
         img2->val[p][2]=Lab.val[2];
       }
       break;
+    }
 
   case LABNorm2_CSPACE:
 
     img2=iftCreateMImage(img1->xsize,img1->ysize,img1->zsize,3);
 #pragma omp parallel for shared(img1, img2, normalization_value)
-    for (int p=0; p < img2->n; p++) {
+    for (iftIdx p=0; p < img2->n; p++) {
       iftColor  YCbCr,RGB;
       iftFColor LabNorm;
       YCbCr.val[0] = img1->val[p];
@@ -4550,7 +5536,7 @@ iftMImage * iftImageToMImage(const iftImage *img1, char color_space)
 
     img2=iftCreateMImage(img1->xsize,img1->ysize,img1->zsize,3);
 #pragma omp parallel for shared(img1, img2, normalization_value)
-    for (int p=0; p < img2->n; p++) {
+    for (iftIdx p=0; p < img2->n; p++) {
       iftColor YCbCr,RGB;
       YCbCr.val[0] = img1->val[p];
       YCbCr.val[1] = img1->Cb[p];
@@ -4566,7 +5552,7 @@ iftMImage * iftImageToMImage(const iftImage *img1, char color_space)
 
     img2=iftCreateMImage(img1->xsize,img1->ysize,img1->zsize,3);
 #pragma omp parallel for shared(img1, img2, normalization_value)
-    for (int p=0; p < img2->n; p++) {
+    for (iftIdx p=0; p < img2->n; p++) {
       iftColor YCbCr,RGB;
       YCbCr.val[0] = img1->val[p];
       YCbCr.val[1] = img1->Cb[p];
@@ -4582,7 +5568,7 @@ iftMImage * iftImageToMImage(const iftImage *img1, char color_space)
 
     img2=iftCreateMImage(img1->xsize,img1->ysize,img1->zsize,1);
 #pragma omp parallel for shared(img1, img2, normalization_value)
-    for (int p=0; p < img2->n; p++) {
+    for (iftIdx p=0; p < img2->n; p++) {
       img2->val[p][0]=((float)img1->val[p]);
     }
     break;
@@ -4591,7 +5577,7 @@ iftMImage * iftImageToMImage(const iftImage *img1, char color_space)
 
     img2=iftCreateMImage(img1->xsize,img1->ysize,img1->zsize,1);
 #pragma omp parallel for shared(img1, img2, normalization_value)
-    for (int p=0; p < img2->n; p++) {
+    for (iftIdx p=0; p < img2->n; p++) {
       img2->val[p][0]=((float)img1->val[p])/(float)normalization_value;
     }
 
@@ -4602,7 +5588,7 @@ iftMImage * iftImageToMImage(const iftImage *img1, char color_space)
     img2=iftCreateMImage(img1->xsize,img1->ysize,img1->zsize,3);
 
 #pragma omp parallel for shared(img1, img2, normalization_value)
-    for (int p=0; p < img2->n; p++) {
+    for (iftIdx p=0; p < img2->n; p++) {
       img2->val[p][0]=(0.2/2.2)*((float)img1->val[p]/(float)normalization_value);
       img2->val[p][1]=(1.0/2.2)*((float)img1->Cb[p]/(float)normalization_value);
       img2->val[p][2]=(1.0/2.2)*((float)img1->Cr[p]/(float)normalization_value);
@@ -4613,7 +5599,7 @@ iftMImage * iftImageToMImage(const iftImage *img1, char color_space)
 
     img2=iftCreateMImage(img1->xsize,img1->ysize,img1->zsize,3);
 #pragma omp parallel for shared(img1, img2, normalization_value)
-    for (int p=0; p < img2->n; p++) {
+    for (iftIdx p=0; p < img2->n; p++) {
       iftColor  YCbCr,RGB;
       iftColor HSV;
       YCbCr.val[0] = img1->val[p];
@@ -4638,58 +5624,378 @@ iftMImage * iftImageToMImage(const iftImage *img1, char color_space)
   return(img2);
 }
 
-iftImage * iftMImageToImage(const iftMImage *img1, int Imax, int band)
+/* Decoder state of an iftLabRowReader */
+typedef struct _ift_lab_row_decoder {
+  char format;             /* 'p' (PNG), 'j' (JPEG), 'm' (binary PPM) or
+                              'b' (caller's buffer) */
+  FILE *fp;
+  png_structp png_ptr;
+  png_infop info_ptr;
+  struct jpeg_decompress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+  int nchannels;           /* interleaved samples per pixel */
+  bool wide;               /* 16-bit big endian samples */
+  int normalization_value;
+  uchar *row;              /* decoded row */
+  const uchar *buf;        /* caller's buffer, read in place */
+  long stride;
+} _iftLabRowDecoder;
+
+/* Converts a decoded row of interleaved samples (8-bit, or 16-bit big
+   endian when wide) into bands: the first three channels go to CIELAB, or
+   the first one to gray */
+void _iftDecodedRowToLab(const uchar *row, int width, int nchannels, bool wide,
+                         int normalization_value, int nbands, float *lab)
+{
+  int step = nchannels * (wide ? 2 : 1);
+
+  if (nbands == 3) {
+    iftRGBRowToLabNorm(row, width, nchannels, wide, normalization_value, lab);
+    return;
+  }
+
+  for (int x = 0; x < width; x++, row += step)
+    lab[x] = wide ? ((row[0] << 8) | row[1]) : row[0];
+}
+
+/* Interlaced and palette PNGs are left to the generic path */
+bool _iftOpenLabRowDecoderPNG(const char *filename, iftLabRowReader *reader,
+                              _iftLabRowDecoder *dec)
 {
-  iftImage *img2=iftCreateImage(img1->xsize,img1->ysize,img1->zsize);
-  int p,b=band;
-  double min = IFT_INFINITY_FLT, max = IFT_INFINITY_FLT_NEG;
+  png_byte header[8];
+  int color_type;
 
-  if ((band < 0)||(band >= img1->m))
-      iftError("Invalid band", "iftMImageToImage");
+  dec->fp = fopen(filename, "rb");
+  if (dec->fp == NULL)
+    iftError(MSG_FILE_OPEN_ERROR, "_iftOpenLabRowDecoderPNG", filename);
+  if (fread(header, 1, 8, dec->fp) != 8 || png_sig_cmp(header, 0, 8))
+    iftError("File %s is not recognized as a PNG file", "_iftOpenLabRowDecoderPNG", filename);
 
-  for (p=0; p < img1->n; p++) {
-    if (img1->val[p][b] < min)
-      min = img1->val[p][b];
-    if (img1->val[p][b] > max)
-      max = img1->val[p][b];
-  }
+  dec->png_ptr  = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  dec->info_ptr = (dec->png_ptr != NULL) ? png_create_info_struct(dec->png_ptr) : NULL;
+  if (dec->info_ptr == NULL)
+    iftError("Internal error: png_create_read_struct failed", "_iftOpenLabRowDecoderPNG");
 
-  //printf("min %lf max %lf\n",min,max);
+  if (setjmp(png_jmpbuf(dec->png_ptr)))
+    iftError("Internal error: Error during init_io", "_iftOpenLabRowDecoderPNG");
 
-  if (max > min){
-    for (p=0; p < img2->n; p++) {
-      img2->val[p]=(int)(Imax*(img1->val[p][b]-min)/(max-min));
-    }
-  }else{
-    char msg[100];
-    sprintf(msg,"Image is empty: max = %f and min = %f\n",max,min);
-    // iftWarning(msg,"iftMImageToImage");
-  }
+  png_init_io(dec->png_ptr, dec->fp);
+  png_set_sig_bytes(dec->png_ptr, 8);
+  png_read_info(dec->png_ptr, dec->info_ptr);
 
-  img2->dx = img1->dx;
-  img2->dy = img1->dy;
-  img2->dz = img1->dz;
+  color_type = png_get_color_type(dec->png_ptr, dec->info_ptr);
+  if (color_type == PNG_COLOR_TYPE_PALETTE ||
+      png_get_interlace_type(dec->png_ptr, dec->info_ptr) != PNG_INTERLACE_NONE)
+    return false;
 
-  return(img2);
+  if (png_get_bit_depth(dec->png_ptr, dec->info_ptr) < 8)
+    png_set_expand_gray_1_2_4_to_8(dec->png_ptr);
+  png_read_update_info(dec->png_ptr, dec->info_ptr);
+
+  reader->xsize   = png_get_image_width(dec->png_ptr, dec->info_ptr);
+  reader->ysize   = png_get_image_height(dec->png_ptr, dec->info_ptr);
+  reader->nbands  = (color_type & PNG_COLOR_MASK_COLOR) ? 3 : 1;
+  dec->nchannels  = png_get_channels(dec->png_ptr, dec->info_ptr);
+  dec->wide       = (png_get_bit_depth(dec->png_ptr, dec->info_ptr) == 16);
+  dec->normalization_value = dec->wide ? 65535 : 255;
+  dec->row        = iftAllocUCharArray(png_get_rowbytes(dec->png_ptr, dec->info_ptr));
+
+  return true;
 }
 
-iftImage *iftGridSampling(iftMImage *img, iftImage *mask1, int nsamples)
+/* CMYK and YCCK JPEGs are left to the generic path */
+bool _iftOpenLabRowDecoderJPEG(const char *filename, iftLabRowReader *reader,
+                               _iftLabRowDecoder *dec)
 {
-  iftImage  *mask2 = iftCreateImage(img->xsize,img->ysize,img->zsize);
-  iftImage  *prob  = iftBorderProbImage(img);
-  int        p, q, i, qmin, xsize,ysize,zsize;
-  float      xspacing,yspacing,zspacing,deltax,deltay,deltaz;
-  iftAdjRel *A;
-  iftVoxel   u, v, m, uo, uf;
+  dec->fp = fopen(filename, "rb");
+  if (dec->fp == NULL)
+    iftError(MSG_FILE_OPEN_ERROR, "_iftOpenLabRowDecoderJPEG", filename);
 
-  /* Compute the extreme voxels that define the region of interest in
-     mask1, and then compute the xsize, ysize, and zsize of that
-     ROI. */
-  iftBoundingBox mbb = iftMinBoundingBox(mask1, NULL);
-  uo = mbb.begin;
-  uf = mbb.end;
-  xsize = uf.x - uo.x + 1;
-  ysize = uf.y - uo.y + 1;
+  dec->cinfo.err = jpeg_std_error(&dec->jerr);
+  jpeg_create_decompress(&dec->cinfo);
+  jpeg_stdio_src(&dec->cinfo, dec->fp);
+  (void) jpeg_read_header(&dec->cinfo, TRUE);
+
+  // The decoder's own YCbCr to RGB step is all it takes
+  if (dec->cinfo.jpeg_color_space == JCS_YCbCr || dec->cinfo.jpeg_color_space == JCS_RGB)
+    dec->cinfo.out_color_space = JCS_RGB;
+  else if (dec->cinfo.jpeg_color_space == JCS_GRAYSCALE)
+    dec->cinfo.out_color_space = JCS_GRAYSCALE;
+  else return false;
+
+  (void) jpeg_start_decompress(&dec->cinfo);
+
+  reader->xsize   = dec->cinfo.output_width;
+  reader->ysize   = dec->cinfo.output_height;
+  reader->nbands  = (dec->cinfo.out_color_space == JCS_RGB) ? 3 : 1;
+  dec->nchannels  = dec->cinfo.output_components;
+  dec->wide       = false;
+  dec->normalization_value = (1 << dec->cinfo.data_precision) - 1;
+  dec->row        = iftAllocUCharArray((long)reader->xsize * dec->nchannels);
+
+  return true;
+}
+
+bool _iftOpenLabRowDecoderP6(const char *filename, iftLabRowReader *reader,
+                             _iftLabRowDecoder *dec)
+{
+  char type[10];
+  int v;
+
+  dec->fp = fopen(filename, "rb");
+  if (dec->fp == NULL)
+    iftError(MSG_FILE_OPEN_ERROR, "_iftOpenLabRowDecoderP6", filename);
+
+  if (fscanf(dec->fp, "%s\n", type) != 1 || !iftCompareStrings(type, "P6"))
+    iftError("Invalid image type", "_iftOpenLabRowDecoderP6");
+
+  iftSkipComments(dec->fp);
+
+  if (fscanf(dec->fp, "%d %d\n", &reader->xsize, &reader->ysize) != 2 ||
+      fscanf(dec->fp, "%d", &v) != 1)
+    iftError("Reading error", "_iftOpenLabRowDecoderP6");
+  if (v < 0 || v > 65536)
+    iftError("Invalid maximum value", "_iftOpenLabRowDecoderP6");
+
+  while (fgetc(dec->fp) != '\n');
+
+  reader->nbands  = 3;
+  dec->nchannels  = 3;
+  dec->wide       = (v >= 256);
+  dec->normalization_value = iftNormalizationValue(v);
+  dec->row        = iftAllocUCharArray(3L * reader->xsize * (dec->wide ? 2 : 1));
+
+  return true;
+}
+
+iftLabRowReader *iftOpenLabRowReader(const char *filename)
+{
+  char *ext;
+  bool ok;
+  iftLabRowReader *reader;
+  _iftLabRowDecoder *dec;
+
+  if (!iftFileExists(filename))
+    iftError("Image %s does not exist", "iftOpenLabRowReader", filename);
+
+  ext    = iftLowerString(iftFileExt(filename));
+  reader = (iftLabRowReader *) iftAlloc(1, sizeof(iftLabRowReader));
+  dec    = (_iftLabRowDecoder *) iftAlloc(1, sizeof(_iftLabRowDecoder));
+  reader->state = dec;
+
+  if (iftCompareStrings(ext, ".png")) {
+    dec->format = 'p';
+    ok = _iftOpenLabRowDecoderPNG(filename, reader, dec);
+  } else if (iftCompareStrings(ext, ".jpg") || iftCompareStrings(ext, ".jpeg")) {
+    dec->format = 'j';
+    ok = _iftOpenLabRowDecoderJPEG(filename, reader, dec);
+  } else if (iftCompareStrings(ext, ".ppm")) {
+    dec->format = 'm';
+    ok = _iftOpenLabRowDecoderP6(filename, reader, dec);
+  } else ok = false;
+
+  iftFree(ext);
+
+  if (!ok) iftCloseLabRowReader(&reader);
+
+  return reader;
+}
+
+iftLabRowReader *iftOpenLabRowReaderByBuffer(const uchar *buf, int xsize, int ysize,
+                                             int nchannels, long stride)
+{
+  iftLabRowReader *reader;
+  _iftLabRowDecoder *dec;
+
+  if (nchannels != 1 && nchannels != 3 && nchannels != 4)
+    iftError("Invalid number of channels: %d (1, 3 or 4)", "iftOpenLabRowReaderByBuffer", nchannels);
+  if (stride < (long)xsize * nchannels)
+    iftError("The stride %ld is shorter than a row", "iftOpenLabRowReaderByBuffer", stride);
+
+  reader = (iftLabRowReader *) iftAlloc(1, sizeof(iftLabRowReader));
+  dec    = (_iftLabRowDecoder *) iftAlloc(1, sizeof(_iftLabRowDecoder));
+  reader->state  = dec;
+  reader->xsize  = xsize;
+  reader->ysize  = ysize;
+  reader->nbands = (nchannels >= 3) ? 3 : 1;
+
+  dec->format    = 'b';
+  dec->nchannels = nchannels;
+  dec->wide      = false;
+  dec->normalization_value = 255;
+  dec->buf       = buf;
+  dec->stride    = stride;
+
+  return reader;
+}
+
+void iftReadLabRow(iftLabRowReader *reader, float *lab)
+{
+  _iftLabRowDecoder *dec = (_iftLabRowDecoder *) reader->state;
+
+  if (reader->y >= reader->ysize)
+    iftError("No rows left", "iftReadLabRow");
+
+  if (dec->format == 'p') {
+    if (setjmp(png_jmpbuf(dec->png_ptr)))
+      iftError("Internal error: Error during read_row", "iftReadLabRow");
+    png_read_row(dec->png_ptr, dec->row, NULL);
+  }
+  else if (dec->format == 'j') {
+    JSAMPROW rows[1] = { dec->row };
+
+    jpeg_read_scanlines(&dec->cinfo, rows, 1);
+  }
+  else if (dec->format == 'b') {
+    _iftDecodedRowToLab(dec->buf + reader->y * dec->stride, reader->xsize, dec->nchannels,
+                        false, dec->normalization_value, reader->nbands, lab);
+    reader->y++;
+    return;
+  }
+  else if (fread(dec->row, dec->nchannels * (dec->wide ? 2 : 1), reader->xsize, dec->fp)
+           != (size_t)reader->xsize)
+    iftError("Reading error", "iftReadLabRow");
+
+  _iftDecodedRowToLab(dec->row, reader->xsize, dec->nchannels, dec->wide,
+                      dec->normalization_value, reader->nbands, lab);
+  reader->y++;
+}
+
+void iftCloseLabRowReader(iftLabRowReader **reader)
+{
+  _iftLabRowDecoder *dec;
+
+  if (reader == NULL || *reader == NULL) return;
+
+  dec = (_iftLabRowDecoder *) (*reader)->state;
+
+  // The decoders may be released before the last row
+  if (dec->format == 'p' && dec->png_ptr != NULL)
+    png_destroy_read_struct(&dec->png_ptr, &dec->info_ptr, NULL);
+  else if (dec->format == 'j' && dec->fp != NULL)
+    jpeg_destroy_decompress(&dec->cinfo);
+
+  if (dec->fp != NULL) fclose(dec->fp);
+  if (dec->row != NULL) iftFree(dec->row);
+  iftFree(dec);
+  iftFree(*reader);
+  *reader = NULL;
+}
+
+iftMImage *iftReadLabMImageByExt(const char *format, ...)
+{
+  va_list args;
+  char filename[IFT_STR_DEFAULT_SIZE];
+  iftLabRowReader *reader;
+  iftMImage *mimg;
+
+  va_start(args, format);
+  vsprintf(filename, format, args);
+  va_end(args);
+
+  reader = iftOpenLabRowReader(filename);
+
+  if (reader != NULL) {
+    // the bands of a row are contiguous
+    mimg = iftCreateMImage(reader->xsize, reader->ysize, 1, reader->nbands);
+    for (int y = 0; y < reader->ysize; y++)
+      iftReadLabRow(reader, mimg->val[mimg->tby[y]]);
+    mimg->dz = 0.0;
+
+    iftCloseLabRowReader(&reader);
+  } else { // Generic path
+    iftImage *img = iftReadImageByExt(filename);
+
+    if (iftIsColorImage(img)) mimg = iftImageToMImage(img, LABNorm_CSPACE);
+    else mimg = iftImageToMImage(img, GRAY_CSPACE);
+
+    iftDestroyImage(&img);
+  }
+
+  return mimg;
+}
+
+iftMImage *iftMExtractROI(const iftMImage *img, iftBoundingBox bb)
+{
+  iftVoxel   v;
+  iftMImage *roi;
+  iftIdx     p, q;
+
+  if (!iftMValidVoxel(img, bb.begin) || !iftMValidVoxel(img, bb.end) ||
+      bb.begin.x > bb.end.x || bb.begin.y > bb.end.y || bb.begin.z > bb.end.z)
+    iftError("Invalid bounding box", "iftMExtractROI");
+
+  roi = iftCreateMImage(bb.end.x - bb.begin.x + 1, bb.end.y - bb.begin.y + 1,
+                        bb.end.z - bb.begin.z + 1, img->m);
+  iftCopyVoxelSize(img, roi);
+
+  /* rows (of all bands) are contiguous in both images */
+  q = 0;
+  for (v.z = bb.begin.z; v.z <= bb.end.z; v.z++)
+    for (v.y = bb.begin.y; v.y <= bb.end.y; v.y++) {
+      v.x = bb.begin.x;
+      p   = iftMGetVoxelIndex(img, v);
+      memcpy(roi->val[q], img->val[p], roi->xsize * img->m * sizeof(float));
+      q  += roi->xsize;
+    }
+
+  return roi;
+}
+
+iftImage * iftMImageToImage(const iftMImage *img1, int Imax, int band)
+{
+  iftImage *img2=iftCreateImage(img1->xsize,img1->ysize,img1->zsize);
+  iftIdx p;
+  int b=band;
+  double min = IFT_INFINITY_FLT, max = IFT_INFINITY_FLT_NEG;
+
+  if ((band < 0)||(band >= img1->m))
+      iftError("Invalid band", "iftMImageToImage");
+
+  for (p=0; p < img1->n; p++) {
+    if (img1->val[p][b] < min)
+      min = img1->val[p][b];
+    if (img1->val[p][b] > max)
+      max = img1->val[p][b];
+  }
+
+  //printf("min %lf max %lf\n",min,max);
+
+  if (max > min){
+    for (p=0; p < img2->n; p++) {
+      img2->val[p]=(int)(Imax*(img1->val[p][b]-min)/(max-min));
+    }
+  }else{
+    char msg[100];
+    sprintf(msg,"Image is empty: max = %f and min = %f\n",max,min);
+    // iftWarning(msg,"iftMImageToImage");
+  }
+
+  img2->dx = img1->dx;
+  img2->dy = img1->dy;
+  img2->dz = img1->dz;
+
+  return(img2);
+}
+
+iftImage *iftGridSampling(iftMImage *img, iftImage *mask1, int nsamples)
+{
+  iftImage  *mask2 = iftCreateImage(img->xsize,img->ysize,img->zsize);
+  iftImage  *prob  = iftBorderProbImage(img);
+  iftIdx     p, q, qmin;
+  int        i, xsize,ysize,zsize;
+  float      xspacing,yspacing,zspacing,deltax,deltay,deltaz;
+  iftAdjRel *A;
+  iftVoxel   u, v, m, uo, uf;
+
+  /* Compute the extreme voxels that define the region of interest in
+     mask1, and then compute the xsize, ysize, and zsize of that
+     ROI. */
+  iftBoundingBox mbb = iftMinBoundingBox(mask1, NULL);
+  uo = mbb.begin;
+  uf = mbb.end;
+  xsize = uf.x - uo.x + 1;
+  ysize = uf.y - uo.y + 1;
   zsize = uf.z - uo.z + 1;
 
   if (iftIs3DMImage(img)){
@@ -4704,7 +6010,7 @@ iftImage *iftGridSampling(iftMImage *img, iftImage *mask1, int nsamples)
     zspacing          = (zsize/nsamples_per_axis);
     */
     /* uncomment the next 5 lines to obtain equally spaced seeds in every axis */
-    float superpixelsize = 0.5+(float)(xsize*ysize*zsize)/(float)nsamples;
+    float superpixelsize = 0.5+((float)xsize*ysize*zsize)/(float)nsamples;
     float step = (float) pow((double)superpixelsize,1.0/3.0)+0.5;
     xspacing = step;
     yspacing = step;
@@ -5073,175 +6379,746 @@ iftImage *iftAltMixedSampling(iftMImage *img, iftImage *mask, int nsamples)
         if (j == (nquad - 1))
           endX = img->xsize;
 
-        // Divide image in quadrants
-        quadImgSizeY = (endY - initY);
-        quadImgSizeX = (endX - initX);
-        quadImgSizeXY = quadImgSizeX * quadImgSizeY;
-        quadImg = iftCreateMImage(quadImgSizeX, quadImgSizeY, (endZ - initZ), img->m);
-        quadMask = iftCreateImage(quadImgSizeX, quadImgSizeY, (endZ - initZ));
-        for (p = 0; p < quadImg->n; p++) {
-          z = p / quadImgSizeXY;
-          y = (p % quadImgSizeXY) / quadImgSizeX;
-          x = (p % quadImgSizeXY) % quadImgSizeX;
-          origp = (x + initX) + (y + initY) * img->xsize + (z + initZ) * (img->xsize * img->ysize);
-          for (t = 0; t < quadImg->m; t++) {
-            quadImg->val[p][t] = img->val[origp][t];
-          }
-          if (mask->val[origp] != 0)
-            quadMask->val[p] = 1;
+        // Divide image in quadrants
+        quadImgSizeY = (endY - initY);
+        quadImgSizeX = (endX - initX);
+        quadImgSizeXY = quadImgSizeX * quadImgSizeY;
+        quadImg = iftCreateMImage(quadImgSizeX, quadImgSizeY, (endZ - initZ), img->m);
+        quadMask = iftCreateImage(quadImgSizeX, quadImgSizeY, (endZ - initZ));
+        for (p = 0; p < quadImg->n; p++) {
+          z = p / quadImgSizeXY;
+          y = (p % quadImgSizeXY) / quadImgSizeX;
+          x = (p % quadImgSizeXY) % quadImgSizeX;
+          origp = (x + initX) + (y + initY) * img->xsize + (z + initZ) * (img->xsize * img->ysize);
+          for (t = 0; t < quadImg->m; t++) {
+            quadImg->val[p][t] = img->val[origp][t];
+          }
+          if (mask->val[origp] != 0)
+            quadMask->val[p] = 1;
+        }
+
+        if (quadEntropy[indexQuad] > thrEntropy) {
+          // Execute Second Stage of mix sampling
+          quadGrid = iftAltMixedSamplingSecondStage(quadImg, quadMask, quadNSamples[indexQuad]);
+        } else {
+          quadGrid = iftGridSampling(quadImg, quadMask, quadNSamples[indexQuad]);
+        }
+
+        // Write seeds in the final out image
+        for (p = 0; p < quadGrid->n; p++) {
+          if (quadGrid->val[p] > 0) {
+            z = p / (quadGrid->xsize*quadGrid->ysize);
+            y = (p % (quadGrid->xsize*quadGrid->ysize)) / quadGrid->xsize;
+            x = (p % (quadGrid->xsize*quadGrid->ysize)) % quadGrid->xsize;
+            origp = (x + initX) + (y + initY) * img->xsize + (z + initZ) * (img->xsize * img->ysize);
+            out->val[origp] = 1;
+          }
+        }
+
+        indexQuad++;
+        iftDestroyMImage(&quadImg);
+        iftDestroyImage(&quadMask);
+        iftDestroyImage(&quadGrid);
+
+      }
+    }
+  }
+  iftFree(quadEntropy);
+  iftFree(quadNSamples);
+
+  return out;
+}
+
+iftImage *iftBorderProbImage(iftMImage *img) 
+{
+  iftAdjRel *A;
+  iftImage  *prob;
+
+  if (iftIs3DMImage(img))
+    A = iftSpheric(sqrtf(3.0));
+  else
+    A = iftCircular(1.5);
+
+  prob = iftMImageBasins(img, A);
+
+  int      prob_max_val = iftMaximumValue(prob);
+  for (iftIdx p            = 0; p < prob->n; p++)
+    prob->val[p] = (int) ((float) prob->val[p] / prob_max_val * 100.0);
+
+  iftDestroyAdjRel(&A);
+
+  return (prob);
+}
+
+iftImage *iftMImageBasins(const iftMImage *img, iftAdjRel *A)
+{
+   iftImage   *basins=iftCreateImage(img->xsize,img->ysize,img->zsize);
+   double     *grad=iftAllocDoubleArray(img->n);
+   float      *w, wt=0.0, K;
+   int         dx, dy, dz;
+
+   iftMaxAdjShifts(A, &dx, &dy, &dz);
+   K = sqrtf(dx*dx + dy*dy + dz*dz);
+
+   w = iftAllocFloatArray(A->n);
+   for (int i=1; i < A->n; i++) {
+     w[i] = K / sqrtf(A->dx[i]*A->dx[i] + A->dy[i]*A->dy[i] + A->dz[i]*A->dz[i]);
+     wt  += w[i];
+   }
+   for (int i=1; i < A->n; i++) {
+     w[i] = w[i]/wt;
+   }
+
+   /* Compute basins image in the spatial domain */
+
+#pragma omp parallel for shared(img,grad,A)
+   for (iftIdx p=0; p < img->n; p++) {
+     iftVoxel u   = iftMGetVoxelCoord(img,p);
+     for (int i=1; i < A->n; i++) {
+       iftVoxel v = iftGetAdjacentVoxel(A,u,i);
+       double dist=0.0;
+       if (iftMValidVoxel(img,v)){
+   iftIdx q = iftMGetVoxelIndex(img,v);
+   for (int b=0; b < img->m; b++) {
+     dist += fabs(img->val[q][b]-img->val[p][b]);
+   }
+       }
+       grad[p] += dist*w[i];
+     }
+   }
+   
+#pragma omp parallel for shared(grad,basins)
+   for (iftIdx p=0; p < img->n; p++) {
+     basins->val[p] = iftRound(grad[p]);
+   }
+
+   iftFree(grad);
+   iftFree(w);
+   
+   return(basins);
+ }
+
+inline iftVoxel iftMGetVoxelCoord(const iftMImage *img, iftIdx p)
+{
+    /* old
+     * u.x = (((p) % (((img)->xsize)*((img)->ysize))) % (img)->xsize)
+     * u.y = (((p) % (((img)->xsize)*((img)->ysize))) / (img)->xsize)
+     * u.z = ((p) / (((img)->xsize)*((img)->ysize)))
+     */
+    iftVoxel u;
+    iftIdx   xysize = (iftIdx)img->xsize * img->ysize;
+    iftIdx   rem    = p % xysize; /* the compiler merges it with p / xysize */
+
+    u.x = (int)(rem % img->xsize);
+    u.y = (int)(rem / img->xsize);
+    u.z = (int)(p / xysize);
+
+  return(u);
+}
+
+inline char iftMValidVoxel(const iftMImage *img, iftVoxel v) 
+{
+  if ((v.x >= 0)&&(v.x < img->xsize)&&
+      (v.y >= 0)&&(v.y < img->ysize)&&
+      (v.z >= 0)&&(v.z < img->zsize))
+    return(1);
+  else
+    return(0);
+}
+
+float iftMMaximumValue(const iftMImage *img, int band) {
+  iftIdx i;
+  int b;
+  float max_val = IFT_INFINITY_FLT_NEG;
+
+  if(band < 0) {
+    for(b = 0; b < img->m; b++) {
+      for(i = 0; i < img->n; i++) {
+  max_val = iftMax(img->val[i][b], max_val);
+      }
+    }
+  } else {
+    for(i = 0; i < img->n; i++) {
+      max_val = iftMax(img->val[i][band], max_val);
+    }
+  }
+
+  return max_val;
+}
+
+
+
+// ---------- iftMImage.c end
+// ---------- iftCompactImage.c start 
+
+#ifndef _WINDOWS
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+iftCompactImage *iftCreateCompactImage(int xsize, int ysize, int zsize, int nbands, int nbits)
+{
+    iftCompactImage *img;
+
+    if (nbits != 8 && nbits != 16)
+        iftError("Invalid number of bits: %d (8 or 16)", "iftCreateCompactImage", nbits);
+    if (nbands != 1 && nbands != 3)
+        iftError("Invalid number of bands: %d (1 or 3)", "iftCreateCompactImage", nbands);
+
+    img = (iftCompactImage *) iftAlloc(1, sizeof(iftCompactImage));
+
+    img->xsize  = xsize;
+    img->ysize  = ysize;
+    img->zsize  = zsize;
+    img->dx     = img->dy = img->dz = 1.0;
+    img->n      = (iftIdx)xsize*ysize*zsize;
+    img->nbits  = nbits;
+    img->nbands = nbands;
+    img->val    = iftAlloc(img->n * nbands, nbits/8);
+
+    return img;
+}
+
+void iftDestroyCompactImage(iftCompactImage **img)
+{
+    if (img != NULL && *img != NULL) {
+#ifndef _WINDOWS
+        if ((*img)->map != NULL) munmap((*img)->map, (*img)->map_size);
+        else
+#endif
+        if (!(*img)->borrowed) iftFree((*img)->val);
+        iftFree(*img);
+        *img = NULL;
+    }
+}
+
+/* Copies a decoded row of interleaved samples (8-bit, or 16-bit big endian),
+   keeping the first nbands of each pixel, into the image from pixel p on */
+void _iftDecodedRowToCompactImage(const uchar *row, int width, int nchannels,
+                                  iftCompactImage *img, iftIdx p)
+{
+    iftIdx i = p * img->nbands;
+
+    for (int x = 0; x < width; x++, row += nchannels * img->nbits/8)
+        for (int b = 0; b < img->nbands; b++, i++) {
+            if (img->nbits == 16)
+                ((ushort *)img->val)[i] = (row[2*b] << 8) | row[2*b+1];
+            else ((uchar *)img->val)[i] = row[b];
+        }
+}
+
+iftCompactImage *_iftReadCompactImagePNG(const char *filename)
+{
+    png_infop info_ptr;
+    png_structp png_ptr;
+    png_bytep *row_pointers;
+    int width, height, color_type, depth, nchannels;
+    iftCompactImage *img = NULL;
+
+    row_pointers = iftReadPngImageAux(filename, &png_ptr, &info_ptr);
+
+    width      = png_get_image_width(png_ptr, info_ptr);
+    height     = png_get_image_height(png_ptr, info_ptr);
+    color_type = png_get_color_type(png_ptr, info_ptr);
+    depth      = png_get_bit_depth(png_ptr, info_ptr);
+    nchannels  = png_get_channels(png_ptr, info_ptr);
+
+    if (depth == 8 || depth == 16) { // others (and palettes) left to the generic path
+        if (color_type == PNG_COLOR_TYPE_RGB || color_type == PNG_COLOR_TYPE_RGB_ALPHA)
+            img = iftCreateCompactImage(width, height, 1, 3, depth);
+        else if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+            img = iftCreateCompactImage(width, height, 1, 1, depth);
+    }
+
+    for (int y = 0; y < height; y++) {
+        if (img != NULL)
+            _iftDecodedRowToCompactImage(row_pointers[y], width, nchannels, img, (iftIdx)y*width);
+        iftFree(row_pointers[y]);
+    }
+    iftFree(row_pointers);
+
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+
+    if (img != NULL) img->dz = 0.0;
+
+    return img;
+}
+
+iftCompactImage *_iftReadCompactImageJPEG(const char *filename)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    FILE *infile;
+    JSAMPARRAY buffer;
+    iftCompactImage *img;
+
+    if ((infile = fopen(filename, "rb")) == NULL)
+        iftError(MSG_FILE_OPEN_ERROR, "_iftReadCompactImageJPEG", filename);
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, infile);
+    (void) jpeg_read_header(&cinfo, TRUE);
+
+    if (cinfo.jpeg_color_space == JCS_YCbCr || cinfo.jpeg_color_space == JCS_RGB)
+        cinfo.out_color_space = JCS_RGB;
+    else if (cinfo.jpeg_color_space == JCS_GRAYSCALE)
+        cinfo.out_color_space = JCS_GRAYSCALE;
+    else {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(infile);
+        return NULL;
+    }
+
+    (void) jpeg_start_decompress(&cinfo);
+
+    img    = iftCreateCompactImage(cinfo.output_width, cinfo.output_height, 1,
+                                   (cinfo.out_color_space == JCS_RGB) ? 3 : 1, 8);
+    buffer = (*cinfo.mem->alloc_sarray)
+        ((j_common_ptr) &cinfo, JPOOL_IMAGE, cinfo.output_width * cinfo.output_components, 1);
+
+    while (cinfo.output_scanline < cinfo.output_height) {
+        iftIdx p = (iftIdx)cinfo.output_scanline * cinfo.output_width;
+
+        jpeg_read_scanlines(&cinfo, buffer, 1);
+        _iftDecodedRowToCompactImage(buffer[0], cinfo.output_width, cinfo.output_components, img, p);
+    }
+
+    (void) jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(infile);
+
+    return img;
+}
+
+/* Binary PGM (P5) and PPM (P6) files */
+iftCompactImage *_iftReadCompactImagePNM(const char *filename)
+{
+    FILE *fp;
+    char type[10];
+    int xsize, ysize, v, nbands, nbits;
+    uchar *row;
+    iftCompactImage *img;
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL)
+        iftError(MSG_FILE_OPEN_ERROR, "_iftReadCompactImagePNM", filename);
+
+    if (fscanf(fp, "%s\n", type) != 1)
+        iftError("Reading error", "_iftReadCompactImagePNM");
+
+    if (iftCompareStrings(type, "P5")) nbands = 1;
+    else if (iftCompareStrings(type, "P6")) nbands = 3;
+    else { // e.g., P2, left to the generic path
+        fclose(fp);
+        return NULL;
+    }
+
+    iftSkipComments(fp);
+
+    if (fscanf(fp, "%d %d\n", &xsize, &ysize) != 2 || fscanf(fp, "%d", &v) != 1)
+        iftError("Reading error", "_iftReadCompactImagePNM");
+    if (v <= 0 || v > 65535)
+        iftError("Invalid maximum value", "_iftReadCompactImagePNM");
+
+    while (fgetc(fp) != '\n');
+
+    nbits = (v <= 255) ? 8 : 16;
+    img   = iftCreateCompactImage(xsize, ysize, 1, nbands, nbits);
+    row   = iftAllocUCharArray((long)xsize * nbands * nbits/8);
+
+    for (int y = 0; y < ysize; y++) {
+        if (fread(row, nbands * nbits/8, xsize, fp) != (size_t)xsize)
+            iftError("Reading error", "_iftReadCompactImagePNM");
+        _iftDecodedRowToCompactImage(row, xsize, nbands, img, (iftIdx)y*xsize);
+    }
+
+    iftFree(row);
+    fclose(fp);
+
+    img->dz = 0.0;
+
+    return img;
+}
+
+iftCompactImage *iftReadCompactImageByExt(const char *format, ...)
+{
+    va_list args;
+    char filename[IFT_STR_DEFAULT_SIZE];
+    char *ext;
+    iftCompactImage *img;
+
+    va_start(args, format);
+    vsprintf(filename, format, args);
+    va_end(args);
+
+    if (!iftFileExists(filename))
+        iftError("Image %s does not exist", "iftReadCompactImageByExt", filename);
+
+    ext = iftLowerString(iftFileExt(filename));
+    img = NULL;
+
+    if (iftCompareStrings(ext, ".png"))
+        img = _iftReadCompactImagePNG(filename);
+    else if (iftCompareStrings(ext, ".jpg") || iftCompareStrings(ext, ".jpeg"))
+        img = _iftReadCompactImageJPEG(filename);
+    else if (iftCompareStrings(ext, ".pgm") || iftCompareStrings(ext, ".ppm"))
+        img = _iftReadCompactImagePNM(filename);
+
+    if (img == NULL) { // Generic path
+        iftImage *aux = iftReadImageByExt(filename);
+
+        img = iftImageToCompactImage(aux);
+        iftDestroyImage(&aux);
+    }
+
+    iftFree(ext);
+
+    return img;
+}
+
+iftCompactImage *iftMapCompactImage(const char *format, ...)
+{
+    va_list args;
+    char filename[IFT_STR_DEFAULT_SIZE];
+    char type[10];
+    FILE *fp;
+    int xsize, ysize, zsize, v, nbands, nbits;
+    float dx, dy, dz;
+    bool swap;
+    long offset;
+    size_t data_size;
+    iftCompactImage *img;
+
+    va_start(args, format);
+    vsprintf(filename, format, args);
+    va_end(args);
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL)
+        iftError(MSG_FILE_OPEN_ERROR, "iftMapCompactImage", filename);
+
+    if (fscanf(fp, "%s\n", type) != 1)
+        iftError("Reading error", "iftMapCompactImage");
+
+    // 1. Header, after which the samples are stored as in val --------------
+    dx = dy = dz = 1.0;
+
+    if (iftCompareStrings(type, "SCN")) {
+        if (fscanf(fp, "%d %d %d\n", &xsize, &ysize, &zsize) != 3 ||
+            fscanf(fp, "%f %f %f\n", &dx, &dy, &dz) != 3 || fscanf(fp, "%d", &v) != 1)
+            iftError("Reading error", "iftMapCompactImage");
+        if (v != 8 && v != 16)
+            iftError("Only 8- or 16-bit scenes can be mapped", "iftMapCompactImage");
+
+        nbands = 1;
+        nbits  = v;
+        swap   = false;
+    } else if (iftCompareStrings(type, "P5") || iftCompareStrings(type, "P6")) {
+        iftSkipComments(fp);
+
+        if (fscanf(fp, "%d %d\n", &xsize, &ysize) != 2 || fscanf(fp, "%d", &v) != 1)
+            iftError("Reading error", "iftMapCompactImage");
+        if (v <= 0 || v > 65535)
+            iftError("Invalid maximum value", "iftMapCompactImage");
+
+        zsize  = 1;
+        dz     = 0.0;
+        nbands = iftCompareStrings(type, "P5") ? 1 : 3;
+        nbits  = (v <= 255) ? 8 : 16;
+        swap   = (nbits == 16); // big endian
+    } else iftError("Invalid image type: %s (SCN, P5 or P6)", "iftMapCompactImage", type);
+
+    while (fgetc(fp) != '\n');
+
+    offset = ftell(fp);
+
+    img = (iftCompactImage *) iftAlloc(1, sizeof(iftCompactImage));
+
+    img->xsize  = xsize;
+    img->ysize  = ysize;
+    img->zsize  = zsize;
+    img->dx     = dx;
+    img->dy     = dy;
+    img->dz     = dz;
+    img->n      = (iftIdx)xsize*ysize*zsize;
+    img->nbits  = nbits;
+    img->nbands = nbands;
+    img->swap   = swap;
+    data_size   = (size_t)img->n * nbands * nbits/8;
+
+    // 2. Samples --------------------------------------------------------------
+#ifndef _WINDOWS
+    struct stat st;
+
+    if (fstat(fileno(fp), &st) != 0 || (size_t)st.st_size < offset + data_size)
+        iftError("File %s is truncated", "iftMapCompactImage", filename);
+
+    // The header is not page aligned, so the whole file is mapped
+    img->map_size = offset + data_size;
+    img->map = mmap(NULL, img->map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp), 0);
+    if (img->map == MAP_FAILED)
+        iftError("Could not map file %s", "iftMapCompactImage", filename);
+
+    img->val = (uchar *)img->map + offset;
+#else
+    img->val = iftAlloc(data_size, 1);
+    if (fread(img->val, 1, data_size, fp) != data_size)
+        iftError("File %s is truncated", "iftMapCompactImage", filename);
+#endif
+
+    fclose(fp);
+
+    return img;
+}
+
+iftCompactImage *iftWrapCompactImage(void *data, int xsize, int ysize, int zsize, int nbands, int nbits)
+{
+    iftCompactImage *img;
+
+    if (nbits != 8 && nbits != 16)
+        iftError("Invalid number of bits: %d (8 or 16)", "iftWrapCompactImage", nbits);
+    if (nbands != 1 && nbands != 3)
+        iftError("Invalid number of bands: %d (1 or 3)", "iftWrapCompactImage", nbands);
+    if (data == NULL)
+        iftError("The buffer is NULL", "iftWrapCompactImage");
+
+    img = (iftCompactImage *) iftAlloc(1, sizeof(iftCompactImage));
+
+    img->xsize    = xsize;
+    img->ysize    = ysize;
+    img->zsize    = zsize;
+    img->dx       = img->dy = img->dz = 1.0;
+    img->n        = (iftIdx)xsize*ysize*zsize;
+    img->nbits    = nbits;
+    img->nbands   = nbands;
+    img->val      = data;
+    img->borrowed = true;
+
+    return img;
+}
+
+iftCompactImage *iftImageToCompactImage(const iftImage *img)
+{
+    iftCompactImage *cimg;
+    int min, max, norm;
+
+    iftMinMaxValues(img, &min, &max);
+    if (min < 0 || max > 65535)
+        iftError("Values out of [0,65535]: [%d,%d]", "iftImageToCompactImage", min, max);
+
+    norm = iftNormalizationValue(max);
+    cimg = iftCreateCompactImage(img->xsize, img->ysize, img->zsize,
+                                 iftIsColorImage(img) ? 3 : 1, (max <= 255) ? 8 : 16);
+    iftCopyVoxelSize(img, cimg);
+
+    for (iftIdx p = 0; p < img->n; p++) {
+        if (cimg->nbands == 3) {
+            iftColor YCbCr, RGB;
+
+            YCbCr.val[0] = img->val[p];
+            YCbCr.val[1] = img->Cb[p];
+            YCbCr.val[2] = img->Cr[p];
+            RGB = iftYCbCrtoRGB(YCbCr, norm);
+            for (int b = 0; b < 3; b++)
+                iftSetCompactSample(cimg, 3*p + b, RGB.val[b]);
         }
+        else iftSetCompactSample(cimg, p, img->val[p]);
+    }
 
-        if (quadEntropy[indexQuad] > thrEntropy) {
-          // Execute Second Stage of mix sampling
-          quadGrid = iftAltMixedSamplingSecondStage(quadImg, quadMask, quadNSamples[indexQuad]);
-        } else {
-          quadGrid = iftGridSampling(quadImg, quadMask, quadNSamples[indexQuad]);
-        }
+    return cimg;
+}
 
-        // Write seeds in the final out image
-        for (p = 0; p < quadGrid->n; p++) {
-          if (quadGrid->val[p] > 0) {
-            z = p / (quadGrid->xsize*quadGrid->ysize);
-            y = (p % (quadGrid->xsize*quadGrid->ysize)) / quadGrid->xsize;
-            x = (p % (quadGrid->xsize*quadGrid->ysize)) % quadGrid->xsize;
-            origp = (x + initX) + (y + initY) * img->xsize + (z + initZ) * (img->xsize * img->ysize);
-            out->val[origp] = 1;
-          }
-        }
+iftImage *iftCompactImageToImage(const iftCompactImage *img)
+{
+    return iftCompactROIToImage(img, NULL);
+}
 
-        indexQuad++;
-        iftDestroyMImage(&quadImg);
-        iftDestroyImage(&quadMask);
-        iftDestroyImage(&quadGrid);
+void iftVerifyCompactImageDomains(const iftCompactImage *img1, const iftCompactImage *img2, const char *function)
+{
+    if (img1->xsize != img2->xsize || img1->ysize != img2->ysize || img1->zsize != img2->zsize)
+        iftError("Images with different domains:\n(%d, %d, %d) != (%d, %d, %d)", function,
+                 img1->xsize, img1->ysize, img1->zsize, img2->xsize, img2->ysize, img2->zsize);
+}
 
-      }
-    }
-  }
-  iftFree(quadEntropy);
-  iftFree(quadNSamples);
+void iftCompactMinMaxValues(const iftCompactImage *img, int *min, int *max)
+{
+    *min = IFT_INFINITY_INT;
+    *max = IFT_INFINITY_INT_NEG;
 
-  return out;
+    for (iftIdx i = 0; i < img->n * img->nbands; i++) {
+        int v = iftCompactSample(img, i);
+
+        if (v < *min) *min = v;
+        if (v > *max) *max = v;
+    }
 }
 
-iftImage *iftBorderProbImage(iftMImage *img) 
+iftCompactImage *iftCompactThreshold(const iftCompactImage *img, int lowest, int highest, int value)
 {
-  iftAdjRel *A;
-  iftImage  *prob;
+    iftCompactImage *bin;
 
-  if (iftIs3DMImage(img))
-    A = iftSpheric(sqrtf(3.0));
-  else
-    A = iftCircular(1.5);
+    if (img->nbands != 1)
+        iftError("Only gray images are permitted", "iftCompactThreshold");
 
-  prob = iftMImageBasins(img, A);
+    bin = iftCreateCompactImage(img->xsize, img->ysize, img->zsize, 1, (value <= 255) ? 8 : 16);
+    iftCopyVoxelSize(img, bin);
 
-  int      prob_max_val = iftMaximumValue(prob);
-  for (int p            = 0; p < prob->n; p++)
-    prob->val[p] = (int) ((float) prob->val[p] / prob_max_val * 100.0);
+    for (iftIdx p = 0; p < img->n; p++) {
+        int v = iftCompactSample(img, p);
 
-  iftDestroyAdjRel(&A);
+        iftSetCompactSample(bin, p, (v >= lowest && v <= highest) ? value : 0);
+    }
 
-  return (prob);
+    return bin;
 }
 
-iftImage *iftMImageBasins(const iftMImage *img, iftAdjRel *A)
+iftCompactImage *iftCompactComplement(const iftCompactImage *img)
 {
-   iftImage   *basins=iftCreateImage(img->xsize,img->ysize,img->zsize);
-   double     *grad=iftAllocDoubleArray(img->n);
-   float      *w, wt=0.0, K;
-   int         dx, dy, dz;
+    iftCompactImage *cimg;
+    int min, max;
 
-   iftMaxAdjShifts(A, &dx, &dy, &dz);
-   K = sqrtf(dx*dx + dy*dy + dz*dz);
+    if (img->nbands != 1)
+        iftError("Only gray images are permitted", "iftCompactComplement");
 
-   w = iftAllocFloatArray(A->n);
-   for (int i=1; i < A->n; i++) {
-     w[i] = K / sqrtf(A->dx[i]*A->dx[i] + A->dy[i]*A->dy[i] + A->dz[i]*A->dz[i]);
-     wt  += w[i];
-   }
-   for (int i=1; i < A->n; i++) {
-     w[i] = w[i]/wt;
-   }
+    iftCompactMinMaxValues(img, &min, &max);
 
-   /* Compute basins image in the spatial domain */
+    cimg = iftCreateCompactImage(img->xsize, img->ysize, img->zsize, 1, img->nbits);
+    iftCopyVoxelSize(img, cimg);
 
-#pragma omp parallel for shared(img,grad,A)
-   for (int p=0; p < img->n; p++) {
-     iftVoxel u   = iftMGetVoxelCoord(img,p);
-     for (int i=1; i < A->n; i++) {
-       iftVoxel v = iftGetAdjacentVoxel(A,u,i);
-       double dist=0.0;
-       if (iftMValidVoxel(img,v)){
-   int q = iftMGetVoxelIndex(img,v);
-   for (int b=0; b < img->m; b++) {
-     dist += fabs(img->val[q][b]-img->val[p][b]);
-   }
-       }
-       grad[p] += dist*w[i];
-     }
-   }
-   
-#pragma omp parallel for shared(grad,basins)
-   for (int p=0; p < img->n; p++) {
-     basins->val[p] = iftRound(grad[p]);
-   }
+    for (iftIdx p = 0; p < img->n; p++)
+        iftSetCompactSample(cimg, p, max - iftCompactSample(img, p));
 
-   iftFree(grad);
-   iftFree(w);
-   
-   return(basins);
- }
+    return cimg;
+}
 
-inline iftVoxel iftMGetVoxelCoord(const iftMImage *img, int p)
+bool iftCompactMaskROIBoundingBox(const iftCompactImage *mask, iftBoundingBox *bb)
 {
-    /* old
-     * u.x = (((p) % (((img)->xsize)*((img)->ysize))) % (img)->xsize)
-     * u.y = (((p) % (((img)->xsize)*((img)->ysize))) / (img)->xsize)
-     * u.z = ((p) / (((img)->xsize)*((img)->ysize)))
-     */
-    iftVoxel u;
-    div_t res1 = div(p, img->xsize * img->ysize);
-    div_t res2 = div(res1.rem, img->xsize);
+    iftIdx p = 0;
 
-    u.x = res2.rem;
-    u.y = res2.quot;
-    u.z = res1.quot;
+    bb->begin.x = bb->begin.y = bb->begin.z = IFT_INFINITY_INT;
+    bb->end.x = bb->end.y = bb->end.z = IFT_INFINITY_INT_NEG;
 
-  return(u);
+    for (int z = 0; z < mask->zsize; z++)
+        for (int y = 0; y < mask->ysize; y++)
+            for (int x = 0; x < mask->xsize; x++, p++)
+                if (iftCompactSample(mask, p * mask->nbands) != 0) {
+                    bb->begin.x = iftMin(bb->begin.x, x); bb->end.x = iftMax(bb->end.x, x);
+                    bb->begin.y = iftMin(bb->begin.y, y); bb->end.y = iftMax(bb->end.y, y);
+                    bb->begin.z = iftMin(bb->begin.z, z); bb->end.z = iftMax(bb->end.z, z);
+                }
+
+    if (bb->begin.x == IFT_INFINITY_INT) { /* empty mask */
+        bb->begin.x = bb->begin.y = bb->begin.z = -1;
+        bb->end.x   = bb->end.y   = bb->end.z   = -1;
+        return false;
+    }
+
+    return ((bb->end.x - bb->begin.x + 1) < mask->xsize ||
+            (bb->end.y - bb->begin.y + 1) < mask->ysize ||
+            (bb->end.z - bb->begin.z + 1) < mask->zsize);
 }
 
-inline char iftMValidVoxel(const iftMImage *img, iftVoxel v) 
+/* Validates the bounding box, which is the whole image if NULL */
+iftBoundingBox _iftCompactROIBox(const iftCompactImage *img, const iftBoundingBox *bb, const char *function)
 {
-  if ((v.x >= 0)&&(v.x < img->xsize)&&
-      (v.y >= 0)&&(v.y < img->ysize)&&
-      (v.z >= 0)&&(v.z < img->zsize))
-    return(1);
-  else
-    return(0);
+    iftBoundingBox box;
+
+    if (bb == NULL) {
+        box.begin.x = box.begin.y = box.begin.z = 0;
+        box.end.x = img->xsize - 1;
+        box.end.y = img->ysize - 1;
+        box.end.z = img->zsize - 1;
+    }
+    else box = *bb;
+
+    if (box.begin.x < 0 || box.begin.y < 0 || box.begin.z < 0 ||
+        box.end.x >= img->xsize || box.end.y >= img->ysize || box.end.z >= img->zsize ||
+        box.begin.x > box.end.x || box.begin.y > box.end.y || box.begin.z > box.end.z)
+        iftError("Invalid bounding box", function);
+
+    return box;
 }
 
-float iftMMaximumValue(const iftMImage *img, int band) {
-  int b, i;
-  float max_val = IFT_INFINITY_FLT_NEG;
+iftCompactImage *iftCompactExtractROI(const iftCompactImage *img, iftBoundingBox bb)
+{
+    iftCompactImage *roi;
+    size_t row_size;
+    iftIdx q;
 
-  if(band < 0) {
-    for(b = 0; b < img->m; b++) {
-      for(i = 0; i < img->n; i++) {
-  max_val = iftMax(img->val[i][b], max_val);
-      }
-    }
-  } else {
-    for(i = 0; i < img->n; i++) {
-      max_val = iftMax(img->val[i][band], max_val);
+    bb  = _iftCompactROIBox(img, &bb, "iftCompactExtractROI");
+    roi = iftCreateCompactImage(bb.end.x - bb.begin.x + 1, bb.end.y - bb.begin.y + 1,
+                                bb.end.z - bb.begin.z + 1, img->nbands, img->nbits);
+    iftCopyVoxelSize(img, roi);
+    roi->swap = img->swap; // the rows are copied as stored
+
+    /* rows are contiguous in both images */
+    row_size = (size_t)roi->xsize * img->nbands * img->nbits/8;
+    q = 0;
+    for (int z = bb.begin.z; z <= bb.end.z; z++)
+        for (int y = bb.begin.y; y <= bb.end.y; y++) {
+            iftIdx p = bb.begin.x + (iftIdx)img->xsize * (y + (iftIdx)img->ysize * z);
+
+            memcpy((uchar *)roi->val + q * row_size, 
+                   (const uchar *)img->val + p * img->nbands * img->nbits/8, row_size);
+            q++;
+        }
+
+    return roi;
+}
+
+iftImage *iftCompactROIToImage(const iftCompactImage *img, const iftBoundingBox *bb)
+{
+    iftBoundingBox box;
+    iftImage *roi;
+    int norm;
+    iftIdx q;
+
+    box = _iftCompactROIBox(img, bb, "iftCompactROIToImage");
+    roi = iftCreateImage(box.end.x - box.begin.x + 1, box.end.y - box.begin.y + 1,
+                         box.end.z - box.begin.z + 1);
+    iftCopyVoxelSize(img, roi);
+
+    if (img->nbands == 3) {
+        roi->Cb = iftAllocUShortArray(roi->n);
+        roi->Cr = iftAllocUShortArray(roi->n);
     }
-  }
+    norm = (img->nbits == 8) ? 255 : 65535;
 
-  return max_val;
+    q = 0;
+    for (int z = box.begin.z; z <= box.end.z; z++)
+        for (int y = box.begin.y; y <= box.end.y; y++) {
+            iftIdx p = box.begin.x + (iftIdx)img->xsize * (y + (iftIdx)img->ysize * z);
+
+            for (int x = box.begin.x; x <= box.end.x; x++, p++, q++) {
+                if (img->nbands == 3) {
+                    iftColor RGB, YCbCr;
+
+                    for (int b = 0; b < 3; b++)
+                        RGB.val[b] = iftCompactSample(img, 3*p + b);
+                    YCbCr = iftRGBtoYCbCr(RGB, norm);
+                    roi->val[q] = YCbCr.val[0];
+                    roi->Cb[q]  = YCbCr.val[1];
+                    roi->Cr[q]  = YCbCr.val[2];
+                }
+                else roi->val[q] = iftCompactSample(img, p);
+            }
+        }
+
+    return roi;
 }
 
+void iftCompactROIIndexesToImage(iftIntArray *idx, const iftImage *roi, iftVoxel begin, const iftCompactImage *img)
+{
+    for (long i = 0; i < idx->n; i++) {
+        iftVoxel u = iftGetVoxelCoord(roi, idx->val[i]);
 
+        idx->val[i] = (u.x + begin.x) + 
+                      (iftIdx)img->xsize * ((u.y + begin.y) + (iftIdx)img->ysize * (u.z + begin.z));
+    }
+}
 
-// ---------- iftMImage.c end
+// ---------- iftCompactImage.c end
 // ---------- iftKernel.c start
 iftKernel *iftCreateKernel(iftAdjRel *A)
 {
@@ -5269,6 +7146,7 @@ void iftDestroyKernel(iftKernel **K)
 
 #ifdef __linux__
 #include <sys/sysinfo.h>
+#include <sys/mman.h>
 #include <malloc.h>
 #endif
 
@@ -5293,6 +7171,16 @@ int *iftAllocIntArray(long n)
     return(v);
 }
 
+iftIdx *iftAllocIdxArray(long n) 
+{
+    iftIdx *v = NULL;
+
+    v = (iftIdx *) iftAlloc(n, sizeof(iftIdx));
+    if (v == NULL)
+        iftError("Cannot allocate memory space", "iftAllocIdxArray");
+    return(v);
+}
+
 void iftCopyIntArray(int *array_dst, const int *array_src, int nelems) 
 {
     #pragma omp parallel for
@@ -5394,6 +7282,44 @@ char *iftAllocString(long n)
     return (iftAllocCharArray(n+1));
 }
 
+#define IFT_PAGE_SIZE      4096
+#define IFT_HUGEPAGE_SIZE  (2*1024*1024)
+
+void *iftAllocFirstTouch(long n, size_t size)
+{
+#if defined(IFT_PARALLEL) || defined(IFT_HUGEPAGES)
+    size_t nbytes = (size_t)iftMax(n,1)*size, npages;
+    char  *v      = NULL;
+
+    /* small blocks are not worth it, since they span a few pages */
+    if (nbytes < IFT_HUGEPAGE_SIZE)
+        return iftAlloc(iftMax(n,1), size);
+
+    if (posix_memalign((void **)&v, IFT_HUGEPAGE_SIZE, nbytes) != 0)
+        iftError("Cannot allocate memory space", "iftAllocFirstTouch");
+
+#if defined(IFT_HUGEPAGES) && defined(MADV_HUGEPAGE)
+    madvise(v, nbytes, MADV_HUGEPAGE); /* only a hint, thus errors are ignored */
+#endif
+
+    /* the pages are zeroed by the same static partition of the parallel
+       loops over the array, so each one is placed on the NUMA node of
+       the thread which later uses it */
+    npages = (nbytes + IFT_PAGE_SIZE - 1)/IFT_PAGE_SIZE;
+#pragma omp parallel for schedule(static)
+    for (long i=0; i < (long)npages; i++)
+        memset(v + (size_t)i*IFT_PAGE_SIZE, 0, iftMin(IFT_PAGE_SIZE, nbytes - (size_t)i*IFT_PAGE_SIZE));
+
+    return (v);
+#else
+    void *v = iftAlloc(iftMax(n,1), size);
+
+    if (v == NULL)
+        iftError("Cannot allocate memory space", "iftAllocFirstTouch");
+    return (v);
+#endif
+}
+
 // ---------- iftMemory.c end
 // ---------- iftSegmentation.c start 
 
@@ -5401,7 +7327,7 @@ iftImage *iftThreshold(const iftImage *img, int lowest, int highest, int value)
 {
     iftImage *bin = iftCreateImageFromImage(img);
 
-    for (int p = 0; p < img->n; p++) 
+    for (iftIdx p = 0; p < img->n; p++) 
         if ((img->val[p] >= lowest) && (img->val[p] <= highest))
             bin->val[p] = value;
         else bin->val[p] = 0;
@@ -5413,7 +7339,8 @@ iftImage *iftBorderImage(const iftImage *label, bool get_margins)
 {
  iftAdjRel *A;
  iftImage  *border = iftCreateImage(label->xsize,label->ysize,label->zsize);
- int        p,q,i; 
+ iftIdx     p,q;
+ int        i;
  iftVoxel   u, v;
     
   if (iftIs3DImage(label))
@@ -5481,7 +7408,8 @@ iftImage *iftWaterGray(iftImage *basins, iftImage *pathval, iftAdjRel  *A)
 {
   iftImage   *label=NULL;
   iftGQueue  *Q=NULL;
-  int         i,p,q,l=1,tmp;
+  iftIdx      p,q;
+  int         i,l=1,tmp;
   iftVoxel    u,v;
  
   // Initialization 
@@ -5537,7 +7465,7 @@ iftFImage *iftSmoothWeightImage(const iftImage *basins, float beta)
     iftFImage *weight = iftCreateFImage(basins->xsize,basins->ysize,basins->zsize);
 
     #pragma omp parallel for
-    for (int p = 0; p < basins->n; p++)
+    for (iftIdx p = 0; p < basins->n; p++)
         weight->val[p] = 1.0 / (1.0 + (beta * basins->val[p])); // pseudo inverse
     
 
@@ -5549,12 +7477,12 @@ iftFImage *iftWeightNormFactor(const iftFImage *weight, iftAdjRel *A)
   iftFImage *norm_factor=iftCreateFImage(weight->xsize,weight->ysize,weight->zsize);
 
 #pragma omp parallel for shared(weight,norm_factor)
-  for (int p=0; p < weight->n; p++) {
+  for (iftIdx p=0; p < weight->n; p++) {
     iftVoxel u = iftFGetVoxelCoord(weight,p);
     for (int i=1; i < A->n; i++) {
       iftVoxel v = iftGetAdjacentVoxel(A,u,i);
       if (iftFValidVoxel(weight,v)){
-	     int q = iftFGetVoxelIndex(weight,v);
+	     iftIdx q = iftFGetVoxelIndex(weight,v);
 	     norm_factor->val[p] += weight->val[q];
       }
     }
@@ -5566,7 +7494,7 @@ iftFImage *iftWeightNormFactor(const iftFImage *weight, iftAdjRel *A)
 // ---------- iftSegmentation.c end
 // ---------- iftSet.c start 
 
-void iftInsertSet(iftSet **S, int elem)
+void iftInsertSet(iftSet **S, iftIdx elem)
 {
     iftSet *p=NULL;
     
@@ -5582,10 +7510,10 @@ void iftInsertSet(iftSet **S, int elem)
     *S = p;
 }
 
-int iftRemoveSet(iftSet **S)
+iftIdx iftRemoveSet(iftSet **S)
 {
     iftSet *p;
-    int elem = IFT_NIL;
+    iftIdx elem = IFT_NIL;
     
     if (*S != NULL){
         p    =  *S;
@@ -5597,7 +7525,7 @@ int iftRemoveSet(iftSet **S)
     return(elem);
 }
 
-void iftRemoveSetElem(iftSet **S, int elem)
+void iftRemoveSetElem(iftSet **S, iftIdx elem)
 {
     if (S == NULL || *S == NULL)
         return;
@@ -5667,7 +7595,7 @@ iftSet* 	iftSetConcat(iftSet *S1,iftSet *S2)
     return S;
 }
 
-char iftUnionSetElem(iftSet **S, int elem)
+char iftUnionSetElem(iftSet **S, iftIdx elem)
 {
     iftSet *aux=*S;
     
@@ -5708,7 +7636,7 @@ iftSet* iftSetCopy(iftSet* S)
     return iftSetUnion(S,0);
 }
 
-int iftSetHasElement(iftSet *S, int elem)
+int iftSetHasElement(iftSet *S, iftIdx elem)
 {
     iftSet *s = S;
     while(s){
@@ -5942,6 +7870,119 @@ char *iftGetLine(FILE *stream)
 }
 
 // ---------- iftStream.c end
+// ---------- iftPool.c start
+
+#define IFT_POOL_MIN_CLASS   16 /* smaller buffers (< 64KB) are not pooled */
+#define IFT_POOL_NCLASSES    48
+#define IFT_POOL_MAX_BUFFERS  8
+
+static struct {
+    int   nenabled;
+    int   nbufs[IFT_POOL_NCLASSES];
+    void *bufs[IFT_POOL_NCLASSES][IFT_POOL_MAX_BUFFERS];
+} _iftPool;
+
+/* Returns the size class of a buffer, i.e., the log2 of its rounded-up
+   size, or IFT_NIL if it is not pooled */
+int _iftPoolClass(size_t nbytes)
+{
+    int c = IFT_POOL_MIN_CLASS;
+
+    if (nbytes <= ((size_t)1 << (IFT_POOL_MIN_CLASS-1)))
+        return IFT_NIL;
+    while (((size_t)1 << c) < nbytes)
+        c++;
+
+    return c;
+}
+
+void iftEnableBufferPool(void)
+{
+    #pragma omp critical(iftPool)
+    _iftPool.nenabled++;
+}
+
+void iftDisableBufferPool(void)
+{
+    #pragma omp critical(iftPool)
+    {
+        if (_iftPool.nenabled > 0)
+            _iftPool.nenabled--;
+
+        if (_iftPool.nenabled == 0) {
+            for (int c = 0; c < IFT_POOL_NCLASSES; c++) {
+                while (_iftPool.nbufs[c] > 0)
+                    free(_iftPool.bufs[c][--_iftPool.nbufs[c]]);
+            }
+        }
+    }
+}
+
+void *iftPoolAlloc(size_t nbytes, bool zero)
+{
+    int   c   = _iftPoolClass(nbytes);
+    void *buf = NULL;
+
+    if (c == IFT_NIL)
+        return (zero) ? calloc(nbytes,1) : malloc(nbytes);
+
+    #pragma omp critical(iftPool)
+    {
+        if (_iftPool.nbufs[c] > 0)
+            buf = _iftPool.bufs[c][--_iftPool.nbufs[c]];
+    }
+
+    /* the blocks always have the class size, so they can be cached by
+       iftPoolFree even if they were allocated with the pool disabled */
+    if (buf == NULL)
+        buf = (zero) ? calloc((size_t)1 << c,1) : malloc((size_t)1 << c);
+    else if (zero)
+        memset(buf, 0, nbytes);
+
+    if (buf == NULL)
+        iftError(MSG_MEMORY_ALLOC_ERROR, "iftPoolAlloc");
+
+    return buf;
+}
+
+void iftPoolFree(void *buf, size_t nbytes)
+{
+    int c = _iftPoolClass(nbytes);
+
+    if (buf == NULL)
+        return;
+
+    if (c != IFT_NIL) {
+        #pragma omp critical(iftPool)
+        {
+            if ((_iftPool.nenabled > 0)&&(_iftPool.nbufs[c] < IFT_POOL_MAX_BUFFERS)) {
+                _iftPool.bufs[c][_iftPool.nbufs[c]++] = buf;
+                buf = NULL;
+            }
+        }
+    }
+
+    if (buf != NULL)
+        free(buf);
+}
+
+iftImage *iftCreatePooledImage(int xsize, int ysize, int zsize, bool zero)
+{
+    int *val = (int *)iftPoolAlloc((size_t)xsize*ysize*zsize*sizeof(int), zero);
+
+    return iftCreateImageFromBuffer(xsize, ysize, zsize, val);
+}
+
+void iftDestroyPooledImage(iftImage **img)
+{
+    if ((img != NULL)&&(*img != NULL)) {
+        iftPoolFree((*img)->val, (size_t)(*img)->n*sizeof(int));
+        (*img)->val = NULL;
+        iftDestroyImage(img);
+    }
+}
+
+// ---------- iftPool.c end
 // ---------- iftString.c start 
 
 void iftRightTrim(char* s, char c) 
@@ -6170,22 +8211,33 @@ char *iftRemovePrefix(const char *str, const char *prefix)
 
 // ---------- iftString.c end
 // ---------- iftIGraph.c start 
+/* k-th node in raster order of the voxels, whichever the node layout */
+iftIdx _iftIGraphRasterNode(const iftIGraph *igraph, iftIdx k)
+{
+  return (igraph->raster == NULL) ? k : igraph->raster[k];
+}
+
 void iftIGraphEvalAndAssignNewSeeds
-(iftIGraph *igraph, int* center, int *seed, int nseeds, iftSet **trees_rm, iftSet **new_seeds )
+(iftIGraph *igraph, iftIdx *center, iftIdx *seed, iftIdx nseeds, iftStack *trees_rm, iftStack *new_seeds )
 {
-  int i, p, q, s;
+  iftIdx p, q, i, s;
   iftVoxel u, v;
   float distColor, distVoxel, distColorThres, distVoxelThres;
 
   distColorThres = 0.0;  
   distVoxelThres = 0.0;
-  for (s=0; s < igraph->nnodes; s++) {
+  /* the nodes are visited in raster order of their voxels, so that the
+     float sums do not depend on the node layout */
+  for (iftIdx k=0; k < igraph->nnodes; k++) {
+    s = _iftIGraphRasterNode(igraph, k);
+    if (igraph->label[s] == 0) /* not conquered by any seed */
+      continue;
     p     = igraph->node[s].voxel;
-    i     = igraph->label[igraph->root[p]]-1;
+    i     = igraph->label[igraph->root[s]]-1;
     q     = igraph->node[seed[i]].voxel;
     u = iftGetVoxelCoord(igraph->index,p);
     v = iftGetVoxelCoord(igraph->index,q);
-    distColor = iftFeatDistance(igraph->feat[p],igraph->feat[q],igraph->nfeats);
+    distColor = iftIGraphFeatDistance(igraph,s,seed[i],igraph->nfeats);
     distColorThres += distColor;
     distVoxel = iftVoxelDistance(u,v);
     distVoxelThres += distVoxel;
@@ -6203,38 +8255,102 @@ void iftIGraphEvalAndAssignNewSeeds
     q = igraph->node[center[i]].voxel;
     u = iftGetVoxelCoord(igraph->index,p);
     v = iftGetVoxelCoord(igraph->index,q);
-    distColor = iftFeatDistance(igraph->feat[p],igraph->feat[q],igraph->nfeats);
+    distColor = iftIGraphFeatDistance(igraph,seed[i],center[i],igraph->nfeats);
     distVoxel = iftVoxelDistance(u,v);
 
     if ((distColor > distColorThres)||(distVoxel > distVoxelThres)){
       seed[i] = center[i];
-      iftInsertSet(new_seeds,center[i]);
-      iftInsertSet(trees_rm,seed[i]);
+      iftPushStack(new_seeds,center[i]);
+      iftPushStack(trees_rm,seed[i]);
     }
   }
 }
 
-int *iftIGraphSuperpixelCenters(iftIGraph *igraph, int *seed, int nseeds)
+/* Superpixel centers of a quantized graph. The attribute sums are kept
+   as integers, and since |sum/n - q|^2 = |sum - n*q|^2/n^2, the
+   closest node to each mean is found from integer differences, without
+   dequantizing the attributes. */
+iftIdx *_iftIGraphQuantizedSuperpixelCenters(iftIGraph *igraph, iftIdx *seed, iftIdx nseeds)
+{
+    iftIdx i, s, *center;
+    int    j, m = igraph->nfeats;
+    llong *sum, *nelems;
+    double dist1, dist2;
+
+    sum    = (llong *)iftAlloc((long)nseeds*m,sizeof(llong));
+    nelems = (llong *)iftAlloc(nseeds,sizeof(llong));
+    center = iftAllocIdxArray(nseeds);
+    for (i=0; i < nseeds; i++)
+        center[i] = seed[i];
+
+    for (iftIdx k=0; k < igraph->nnodes; k++) {
+        s = _iftIGraphRasterNode(igraph, k);
+        if (igraph->label[s] == 0) /* not conquered by any seed */
+            continue;
+        i = igraph->label[igraph->root[s]]-1;
+        nelems[i]++;
+        for (j=0; j < m; j++)
+            sum[(long)i*m+j] += (igraph->qbits == 8) ?
+                ((uchar *)igraph->qfeat)[(long)s*m+j] : ((ushort *)igraph->qfeat)[(long)s*m+j];
+    }
+
+    for (iftIdx k=0; k < igraph->nnodes; k++) {
+        s = _iftIGraphRasterNode(igraph, k);
+        if (igraph->label[s] == 0)
+            continue;
+        i     = igraph->label[igraph->root[s]]-1;
+        dist1 = dist2 = 0.0;
+        for (j=0; j < m; j++) {
+            llong qc, qs, d1, d2;
+            if (igraph->qbits == 8) {
+                qc = ((uchar *)igraph->qfeat)[(long)center[i]*m+j];
+                qs = ((uchar *)igraph->qfeat)[(long)s*m+j];
+            } else {
+                qc = ((ushort *)igraph->qfeat)[(long)center[i]*m+j];
+                qs = ((ushort *)igraph->qfeat)[(long)s*m+j];
+            }
+            d1     = sum[(long)i*m+j] - nelems[i]*qc;
+            d2     = sum[(long)i*m+j] - nelems[i]*qs;
+            dist1 += (double)d1*d1;
+            dist2 += (double)d2*d2;
+        }
+        if (dist2 < dist1)
+            center[i]=s;
+    }
+
+    iftFree(sum);
+    iftFree(nelems);
+
+    return(center);
+}
+
+iftIdx *iftIGraphSuperpixelCenters(iftIGraph *igraph, iftIdx *seed, iftIdx nseeds)
 {
-    int    i, j, p, q, s, *center;
+    iftIdx i, s, *center;
+    int    j;
     float  **feat,  *nelems, dist1, dist2;
 
+    if (igraph->qbits != 0)
+        return(_iftIGraphQuantizedSuperpixelCenters(igraph, seed, nseeds));
+
     /* compute average feature vector for each superpixel */
 
     feat   = (float **)iftAlloc(nseeds,sizeof(float *));
     nelems = iftAllocFloatArray(nseeds);
-    center = iftAllocIntArray(nseeds);
+    center = iftAllocIdxArray(nseeds);
     for (i=0; i < nseeds; i++){
         feat[i]   = iftAllocFloatArray(igraph->nfeats);
         center[i] = seed[i];
     }
 
-    for (s=0; s < igraph->nnodes; s++) {
-        p = igraph->node[s].voxel;
-        i = igraph->label[igraph->root[p]]-1;
+    for (iftIdx k=0; k < igraph->nnodes; k++) {
+        s = _iftIGraphRasterNode(igraph, k);
+        if (igraph->label[s] == 0) /* not conquered by any seed */
+            continue;
+        i = igraph->label[igraph->root[s]]-1;
         nelems[i]++;
         for (j=0; j < igraph->nfeats; j++)
-            feat[i][j] += igraph->feat[p][j];
+            feat[i][j] += igraph->feat[s][j];
     }
 
     for (i=0; i < nseeds; i++) {
@@ -6242,14 +8358,17 @@ int *iftIGraphSuperpixelCenters(iftIGraph *igraph, int *seed, int nseeds)
     feat[i][j] /= nelems[i];
     }
 
-    /* compute the closest node to each superpixel center */
+    /* compute the closest node to each superpixel center (the nodes are
+       visited in raster order of their voxels, so that the ties do not
+       depend on the node layout) */
 
-    for (s=0; s < igraph->nnodes; s++) {
-        p     = igraph->node[s].voxel;
-        i     = igraph->label[igraph->root[p]]-1;
-        q     = igraph->node[center[i]].voxel;
-        dist1 = iftFeatDistance(feat[i],igraph->feat[q],igraph->nfeats);
-        dist2 = iftFeatDistance(feat[i],igraph->feat[p],igraph->nfeats);
+    for (iftIdx k=0; k < igraph->nnodes; k++) {
+        s = _iftIGraphRasterNode(igraph, k);
+        if (igraph->label[s] == 0)
+            continue;
+        i     = igraph->label[igraph->root[s]]-1;
+        dist1 = iftFeatDistance(feat[i],igraph->feat[center[i]],igraph->nfeats);
+        dist2 = iftFeatDistance(feat[i],igraph->feat[s],igraph->nfeats);
         if (dist2 < dist1)
             center[i]=s;
     }
@@ -6263,21 +8382,34 @@ int *iftIGraphSuperpixelCenters(iftIGraph *igraph, int *seed, int nseeds)
     return(center);
 }
 
-void iftIGraphSubTreeRemoval(iftIGraph *igraph, int s, double *pvalue, double INITIAL_PATH_VALUE, iftDHeap *Q)
+/* Returns the i-th scratch stack of the graph, which is kept (and
+   grown) among calls to avoid an allocation per pushed node */
+iftStack *_iftIGraphStack(iftIGraph *igraph, int i)
+{
+    if (igraph->stack[i] == NULL)
+        igraph->stack[i] = iftCreateStack(1024);
+    else
+        iftResetStack(igraph->stack[i]);
+
+    return(igraph->stack[i]);
+}
+
+void iftIGraphSubTreeRemoval(iftIGraph *igraph, iftIdx s, double *pvalue, double INITIAL_PATH_VALUE, iftDHeap *Q)
 {
-    int        i, p, q, t;
+    iftIdx     p, q, t;
+    int        i;
     iftVoxel   u, v;
     iftAdjRel *A = igraph->A;
-    iftSet    *Frontier = NULL, *Subtree = NULL;
+    iftStack  *Frontier = _iftIGraphStack(igraph,1), *Subtree = _iftIGraphStack(igraph,0);
     iftImage  *index = igraph->index;
 
-    /* Reinitialize voxels (nodes) of the subtree of s to be
-       reconquered and compute the frontier nodes (voxels) */
+    /* Reinitialize nodes of the subtree of s to be reconquered and
+       compute the frontier nodes */
 
-    iftInsertSet(&Subtree,s);
+    iftPushStack(Subtree,s);
 
-    while (Subtree != NULL){
-        s = iftRemoveSet(&Subtree);
+    while (!iftEmptyStack(Subtree)){
+        s = iftPopStack(Subtree);
         p = igraph->node[s].voxel;
         u = iftGetVoxelCoord(index,p);
 
@@ -6285,18 +8417,20 @@ void iftIGraphSubTreeRemoval(iftIGraph *igraph, int s, double *pvalue, double IN
             iftRemoveDHeapElem(Q,s);
 
 
-        igraph->pvalue[p] = pvalue[s] = INITIAL_PATH_VALUE;
-        igraph->pred[p]   = IFT_NIL;
+        igraph->pvalue[s] = pvalue[s] = INITIAL_PATH_VALUE;
+        igraph->pred[s]   = IFT_NIL;
 
         for (i = 1; i < A->n; i++){
             v = iftGetAdjacentVoxel(A, u, i);
             if (iftValidVoxel(index, v)){
                 q   = iftGetVoxelIndex(index, v);
-                t   = index->val[q];
-                if (igraph->pred[q]==p)
-                    iftInsertSet(&Subtree,t);
-                else{ /* consider t as a candidate to be a frontier node */
-                    iftInsertSet(&Frontier,t);
+                t   = igraph->nindex[q];
+                if (t != IFT_NIL){
+                    if (igraph->pred[t]==s)
+                        iftPushStack(Subtree,t);
+                    else{ /* consider t as a candidate to be a frontier node */
+                        iftPushStack(Frontier,t);
+                    }
                 }
             }
         }
@@ -6305,10 +8439,9 @@ void iftIGraphSubTreeRemoval(iftIGraph *igraph, int s, double *pvalue, double IN
     /* Identify the real frontier nodes and insert them in Queue to
        continue the DIFT */
 
-    while (Frontier != NULL){
-        s = iftRemoveSet(&Frontier);
-        p = igraph->node[s].voxel;
-        if (igraph->label[p] != 0){
+    while (!iftEmptyStack(Frontier)){
+        s = iftPopStack(Frontier);
+        if (igraph->label[s] != 0){
             if (Q->color[s] == IFT_GRAY)
                 iftGoUpDHeap(Q, Q->pos[s]);
             else
@@ -6317,42 +8450,46 @@ void iftIGraphSubTreeRemoval(iftIGraph *igraph, int s, double *pvalue, double IN
     }
 }
 
-iftSet *iftIGraphTreeRemoval(iftIGraph *igraph, iftSet **trees_for_removal, double *pvalue, double INITIAL_PATH_VALUE)
+void iftIGraphTreeRemoval(iftIGraph *igraph, iftStack *trees_for_removal, double *pvalue, double INITIAL_PATH_VALUE, iftStack *frontier)
 {
-    int        i, p, q, r, s, t;
+    iftIdx     p, q, r, s, t;
+    int        i;
     iftVoxel   u, v;
     iftAdjRel *A = igraph->A;
-    iftSet    *Frontier = NULL;
-    iftBMap   *inFrontier = iftCreateBMap(igraph->nnodes);
     iftImage  *index = igraph->index;
-    iftSet    *T1 = NULL, *T2 = NULL;
+    iftStack  *T1 = _iftIGraphStack(igraph,0), *T2 = _iftIGraphStack(igraph,1);
+    iftIdx     first_frontier = frontier->n;
+
+    if (igraph->inFrontier == NULL)
+        igraph->inFrontier = iftCreateBMap(igraph->nnodes);
+    iftBMap   *inFrontier = igraph->inFrontier;
 
-     /* Remove all marked trees and find the frontier voxels
+     /* Remove all marked trees and find the frontier nodes
     afterwards. */
 
-     while (*trees_for_removal != NULL){
-         s = iftRemoveSet(trees_for_removal);
-         p = igraph->node[s].voxel;
-         r = igraph->root[p];
+     while (!iftEmptyStack(trees_for_removal)){
+         s = iftPopStack(trees_for_removal);
+         r = igraph->root[s];
 
-         if (pvalue[index->val[r]] != INITIAL_PATH_VALUE){ /* tree not marked yet */
-             igraph->pvalue[r] = pvalue[index->val[r]] = INITIAL_PATH_VALUE; /* mark removed root */
+         if (pvalue[r] != INITIAL_PATH_VALUE){ /* tree not marked yet */
+             igraph->pvalue[r] = pvalue[r] = INITIAL_PATH_VALUE; /* mark removed root */
              igraph->pred[r]   = IFT_NIL;
-             iftInsertSet(&T1, r);
-             while (T1 != NULL){
-                 p = iftRemoveSet(&T1);
-                 iftInsertSet(&T2, p); /* compute in T2 the union of removed trees */
+             iftPushStack(T1, r);
+             while (!iftEmptyStack(T1)){
+                 s = iftPopStack(T1);
+                 iftPushStack(T2, s); /* compute in T2 the union of removed trees */
+                 p = igraph->node[s].voxel;
                  u = iftGetVoxelCoord(index, p);
                  for (i = 1; i < A->n; i++){
                      v = iftGetAdjacentVoxel(A, u, i);
                      if (iftValidVoxel(index, v)){
                          q   = iftGetVoxelIndex(index, v);
-                         t   = index->val[q];
-                         if ((t != IFT_NIL) && (pvalue[t] != INITIAL_PATH_VALUE)){ /* q has not been removed */
-                             if (igraph->pred[q] == p){ /* q belongs to the tree under removal */
-                                 iftInsertSet(&T1, q);
-                                 pvalue[t]         = igraph->pvalue[q] = INITIAL_PATH_VALUE; /* mark removed node */
-                                 igraph->pred[q]   = IFT_NIL;
+                         t   = igraph->nindex[q];
+                         if ((t != IFT_NIL) && (pvalue[t] != INITIAL_PATH_VALUE)){ /* t has not been removed */
+                             if (igraph->pred[t] == s){ /* t belongs to the tree under removal */
+                                 iftPushStack(T1, t);
+                                 pvalue[t]         = igraph->pvalue[t] = INITIAL_PATH_VALUE; /* mark removed node */
+                                 igraph->pred[t]   = IFT_NIL;
                              }
                          }
                      }
@@ -6361,19 +8498,20 @@ iftSet *iftIGraphTreeRemoval(iftIGraph *igraph, iftSet **trees_for_removal, doub
          }
      }
 
-     /* Find the frontier voxels of non-removed trees */
+     /* Find the frontier nodes of non-removed trees */
 
-     while (T2 != NULL){
-         p = iftRemoveSet(&T2);
+     while (!iftEmptyStack(T2)){
+         s = iftPopStack(T2);
+         p = igraph->node[s].voxel;
          u = iftGetVoxelCoord(index, p);
          for (i = 1; i < A->n; i++){
              v = iftGetAdjacentVoxel(A, u, i);
              if (iftValidVoxel(index, v)){
                  q   = iftGetVoxelIndex(index, v);
-                 t   = index->val[q];
-                 if ((t != IFT_NIL) && (pvalue[t] != INITIAL_PATH_VALUE)){ /* q is a frontier node */
+                 t   = igraph->nindex[q];
+                 if ((t != IFT_NIL) && (pvalue[t] != INITIAL_PATH_VALUE)){ /* t is a frontier node */
                      if (iftBMapValue(inFrontier, t) == 0){ /* t has not been inserted in the frontier yet */
-                         iftInsertSet(&Frontier, t);
+                         iftPushStack(frontier, t);
                          iftBMapSet1(inFrontier, t);
                      }
                  }
@@ -6381,45 +8519,78 @@ iftSet *iftIGraphTreeRemoval(iftIGraph *igraph, iftSet **trees_for_removal, doub
          }
      }
 
-    iftDestroyBMap(&inFrontier);
-
-    return (Frontier);
+    /* the bitmap is left clear for the next call, which avoids
+       allocating and zeroing it */
+    for (iftIdx k = first_frontier; k < frontier->n; k++)
+        iftBMapSet0(inFrontier, frontier->val[k]);
 }
 
-iftIGraph *iftMImageToIGraph(const iftMImage *img, const iftImage *mask)
+iftIGraph *iftCreateIGraph(const iftImage *mask, int nfeats)
 {
     iftIGraph *igraph = (iftIGraph *)iftAlloc(1,sizeof(iftIGraph));
-    int        p, i;
+    float     *feat;
+    iftIdx     p, s;
 
+    /* the node ids are iftIdx, as the voxel indexes, so the graph is not
+       limited to 2^31 nodes under IFT_LARGE_INDEX. The index image only
+       keeps the domain, and the node of each voxel lies in nindex. */
     igraph->nnodes  = iftNumberOfElements(mask);
     igraph->node    = (iftINode *)iftAlloc(igraph->nnodes,sizeof(iftINode));
-    igraph->index   = iftCreateImage(img->xsize, img->ysize, img->zsize);
-    igraph->nfeats  = img->m;
-    igraph->feat    = (float **)iftAlloc(img->n,sizeof(float *));
-
-    iftCopyVoxelSize(img, igraph->index);
-    for (p=0; p < img->n; p++) {
-        igraph->feat[p] = iftAllocFloatArray(igraph->nfeats);
-        for (i=0; i < img->m; i++)
-            igraph->feat[p][i] = img->val[p][i];
-    }
-    igraph->label   = iftAllocIntArray(img->n);
-    igraph->marker  = iftAllocIntArray(img->n);
-    igraph->root    = iftAllocIntArray(img->n);
-    igraph->pred    = iftAllocIntArray(img->n);
-    igraph->pvalue  = iftAllocDoubleArray(img->n);
+    igraph->nindex  = iftAllocIdxArray(iftMax(mask->n,1));
+    igraph->index   = iftCreateImageDomain(mask->xsize, mask->ysize, mask->zsize);
+    igraph->nfeats  = nfeats;
 
-    for (p=0, i=0; p < mask->n; p++) {
-        igraph->index->val[p]     = IFT_NIL;
+    iftCopyVoxelSize(mask, igraph->index);
+    for (p=0, s=0; p < mask->n; p++) {
+        igraph->nindex[p]       = IFT_NIL;
         if (mask->val[p]>0){
-            igraph->node[i].adj     = NULL;
-            igraph->node[i].voxel   = p;
-            igraph->node[i].weight  = 0.0;
-            igraph->index->val[p]   = i;
-            i++;
+            igraph->node[s].adj     = NULL;
+            igraph->node[s].voxel   = p;
+            igraph->node[s].weight  = 0.0;
+            igraph->nindex[p]       = s;
+            s++;
         }
     }
 
+    /* the node attributes are indexed by node, so they are
+       proportional to the mask, and the features lie in a single
+       block */
+    igraph->feat    = (float **)iftAllocFirstTouch(igraph->nnodes,sizeof(float *));
+    feat            = (float *)iftAllocFirstTouch((long)igraph->nnodes*igraph->nfeats,sizeof(float));
+#pragma omp parallel for schedule(static)
+    for (s=0; s < igraph->nnodes; s++)
+        igraph->feat[s] = feat + (long)s*igraph->nfeats;
+    if (igraph->nnodes == 0)
+        igraph->feat[0] = feat;
+
+    igraph->label   = (iftIdx *)iftAllocFirstTouch(igraph->nnodes,sizeof(iftIdx));
+    igraph->root    = (iftIdx *)iftAllocFirstTouch(igraph->nnodes,sizeof(iftIdx));
+    igraph->pred    = (iftIdx *)iftAllocFirstTouch(igraph->nnodes,sizeof(iftIdx));
+    igraph->pvalue  = (double *)iftAllocFirstTouch(igraph->nnodes,sizeof(double));
+
+    /* the graph covers the whole image, unless it is later set as a
+       crop of a larger frame */
+    iftIGraphSetFrame(igraph, (iftVoxel){0,0,0}, mask->xsize, mask->ysize, mask->zsize);
+
+    return(igraph);
+}
+
+iftIGraph *iftMImageToIGraph(const iftMImage *img, const iftImage *mask)
+{
+    iftIGraph *igraph = iftCreateIGraph(mask, img->m);
+    iftIdx     p, s;
+    int        i;
+
+    iftCopyVoxelSize(img, igraph->index);
+
+    /* each thread writes the attribute pages it first touched */
+#pragma omp parallel for schedule(static) private(p,i)
+    for (s=0; s < igraph->nnodes; s++) {
+        p = igraph->node[s].voxel;
+        for (i=0; i < img->m; i++)
+            igraph->feat[s][i] = img->val[p][i];
+    }
+
     return(igraph);
 }
 
@@ -6453,12 +8624,29 @@ void iftIGraphSetWeightForRegionSmoothing(iftIGraph *igraph, const iftImage *img
     iftDestroyFImage(&weight);
 }
 
+/* Labels of the nodes over the graph's domain, which is a crop of its
+   frame for a masked graph (see iftIGraphLabel for the frame's labels) */
+iftImage *_iftIGraphDomainLabel(const iftIGraph *igraph)
+{
+    iftIdx s;
+    iftImage *label = iftCreateImage(igraph->index->xsize,igraph->index->ysize,igraph->index->zsize);
+
+    for (s=0; s < igraph->nnodes; s++) {
+        label->val[igraph->node[s].voxel] = (int)igraph->label[s];
+    }
+
+    iftCopyVoxelSize(igraph->index, label);
+
+    return(label);
+}
+
 void iftIGraphSmoothRegions(iftIGraph *igraph, int num_smooth_iterations)
 {
-    iftImage  *prev_label,  *next_label;
-    iftFImage *prev_weight, *next_weight, *norm_factor, *weight;
+    iftImage  *prev_label,  *next_label, *aux_label;
+    iftFImage *prev_weight, *next_weight, *norm_factor, *weight, *aux_weight;
     float     *sum, max_membership;
-    int        l, i, p, q, r, max_label, iter;
+    iftIdx     p, q;
+    int       *adj_label, nlabels, l, i, max_label, iter;
     iftVoxel   u, v;
     iftAdjRel *A = igraph->A;
     iftSet    *prev_frontier = NULL, *next_frontier = NULL, *S = NULL;
@@ -6469,14 +8657,16 @@ void iftIGraphSmoothRegions(iftIGraph *igraph, int num_smooth_iterations)
 
     /* Initialization */
 
-    prev_label  = iftIGraphLabel(igraph);
+    prev_label  = _iftIGraphDomainLabel(igraph);
     next_label  = iftCopyImage(prev_label);
     weight      = iftIGraphWeight(igraph);
     norm_factor = iftWeightNormFactor(weight,A);
     inFrontier  = iftCreateBMap(prev_label->n);
 
-    int prev_label_max_val = iftMaximumValue(prev_label);
-    sum         = iftAllocFloatArray(prev_label_max_val + 1);
+    /* The vote is restricted to the distinct labels of the adjacent
+       voxels, so its cost does not depend on the number of labels */
+    adj_label   = iftAllocIntArray(A->n);
+    sum         = iftAllocFloatArray(A->n);
     prev_weight = iftCreateFImage(prev_label->xsize, prev_label->ysize, prev_label->zsize);
     next_weight = iftCreateFImage(next_label->xsize, next_label->ysize, next_label->zsize);
     prev_frontier = iftObjectBorderSet(prev_label, A);
@@ -6502,21 +8692,27 @@ void iftIGraphSmoothRegions(iftIGraph *igraph, int num_smooth_iterations)
             iftInsertSet(&next_frontier, p);
             u   = iftGetVoxelCoord(prev_label, p);
 
-            for (l = 0; l <= prev_label_max_val; l++)
-            {
-                sum[l] = 0.0;
-            }
-
+            nlabels = 0;
             for (i = 1; i < A->n; i++)
             {
                 v = iftGetAdjacentVoxel(A, u, i);
                 if (iftValidVoxel(prev_label, v))
                 {
                     q = iftGetVoxelIndex(prev_label, v);
-                    sum[prev_label->val[q]] += prev_weight->val[q] * weight->val[q];
+
+                    for (l = 0; l < nlabels && adj_label[l] != prev_label->val[q]; l++);
+                    if (l == nlabels)
+                    {
+                        adj_label[nlabels] = prev_label->val[q];
+                        sum[nlabels]       = 0.0;
+                        nlabels++;
+                    }
+                    sum[l] += prev_weight->val[q] * weight->val[q];
+
                     if (iftBMapValue(inFrontier, q) == 0) /* expand frontier */
                     {
-                        if (igraph->pred[q] != IFT_NIL)
+                        iftIdx t = igraph->nindex[q];
+                        if ((t != IFT_NIL)&&(igraph->pred[t] != IFT_NIL))
                         {
                             iftInsertSet(&next_frontier, q);
                             iftBMapSet1(inFrontier, q);
@@ -6525,32 +8721,33 @@ void iftIGraphSmoothRegions(iftIGraph *igraph, int num_smooth_iterations)
                 }
             }
 
-            for (l = 0; l <= prev_label_max_val; l++)
-                sum[l]  = sum[l] / norm_factor->val[p];
-
-            max_membership = IFT_INFINITY_FLT_NEG; max_label = IFT_NIL;
-            for (l = 0; l <= prev_label_max_val; l++)
+            /* Absent labels have null membership, so that label 0 wins
+               whenever no adjacent label has a positive one */
+            max_membership = 0.0; max_label = 0;
+            for (l = 0; l < nlabels; l++)
             {
-                if (sum[l] > max_membership)
+                sum[l] = sum[l] / norm_factor->val[p];
+                if (sum[l] > max_membership ||
+                    (sum[l] == max_membership && adj_label[l] < max_label))
                 {
                     max_membership = sum[l];
-                    max_label      = l;
+                    max_label      = adj_label[l];
                 }
             }
             next_label->val[p]  = max_label;
-            next_weight->val[p] = sum[max_label];
+            next_weight->val[p] = max_membership;
         }
 
         prev_frontier = next_frontier;
         next_frontier = NULL;
 
-        for (r = 0; r < prev_label->n; r++)
-        {
-            prev_weight->val[r] = next_weight->val[r];
-            prev_label->val[r]  = next_label->val[r];
-        }
+        /* The frontier never shrinks, thus both buffers only differ on
+           voxels which are rewritten in the next iteration */
+        aux_label  = prev_label;  prev_label  = next_label;  next_label  = aux_label;
+        aux_weight = prev_weight; prev_weight = next_weight; next_weight = aux_weight;
     }
 
+    iftFree(adj_label);
     iftFree(sum);
     iftDestroyFImage(&prev_weight);
     iftDestroyFImage(&next_weight);
@@ -6563,10 +8760,10 @@ void iftIGraphSmoothRegions(iftIGraph *igraph, int num_smooth_iterations)
     /* It fixes the label map, by eliminating the smallest regions and
        relabel them with the adjaceny labels */
 
-    prev_label_max_val = iftMaximumValue(prev_label);
+    int prev_label_max_val = iftMaximumValue(prev_label);
     next_label = iftSelectKLargestRegionsAndPropagateTheirLabels(prev_label, A, prev_label_max_val);
-    for (p=0; p < next_label->n; p++)
-        igraph->label[p]=next_label->val[p];
+    for (iftIdx s=0; s < igraph->nnodes; s++)
+        igraph->label[s]=next_label->val[igraph->node[s].voxel];
 
     iftDestroyImage(&next_label);
     iftDestroyImage(&prev_label);
@@ -6577,57 +8774,136 @@ void iftDestroyIGraph(iftIGraph **igraph)
 {
     if(igraph != NULL && *igraph != NULL) {
         iftIGraph *aux = *igraph;
-        int p, i;
+        iftIdx i;
 
         for (i = 0; i < aux->nnodes; i++) {
             if (aux->node[i].adj != NULL)
                 iftDestroySet(&aux->node[i].adj);
         }
-        for (p = 0; p < aux->index->n; p++) {
-            iftFree(aux->feat[p]);
+        if (aux->feat != NULL) {
+            iftFree(aux->feat[0]); /* single block of features */
+            iftFree(aux->feat);
         }
-        iftFree(aux->feat);
+        iftFree(aux->qfeat);
         iftFree(aux->label);
-        iftFree(aux->marker);
         iftFree(aux->root);
         iftFree(aux->pred);
         iftFree(aux->pvalue);
+        iftDestroyStack(&aux->stack[0]);
+        iftDestroyStack(&aux->stack[1]);
+        iftDestroyBMap(&aux->inFrontier);
+        iftFree(aux->raster);
 
         if (aux->type == IMPLICIT)
             iftDestroyAdjRel(&aux->A);
 
         iftFree(aux->node);
         iftDestroyImage(&aux->index);
+        iftFree(aux->nindex);
         iftFree(aux);
         (*igraph) = NULL;
     }
 }
 
+void iftIGraphSetFrame(iftIGraph *igraph, iftVoxel origin, int xsize, int ysize, int zsize)
+{
+    iftVoxel u;
+
+    u.x = origin.x + igraph->index->xsize - 1;
+    u.y = origin.y + igraph->index->ysize - 1;
+    u.z = origin.z + igraph->index->zsize - 1;
+
+    if (origin.x < 0 || origin.y < 0 || origin.z < 0 ||
+        u.x >= xsize || u.y >= ysize || u.z >= zsize)
+        iftError("The graph domain does not fit in the frame", "iftIGraphSetFrame");
+
+    igraph->origin       = origin;
+    igraph->frame.xsize  = xsize;
+    igraph->frame.ysize  = ysize;
+    igraph->frame.zsize  = zsize;
+}
+
+iftIdx iftIGraphFrameVoxelToNode(const iftIGraph *igraph, iftIdx p)
+{
+    iftVoxel u;
+    iftIdx   fxy;
+
+    fxy = (iftIdx)igraph->frame.xsize * igraph->frame.ysize;
+    u.x = (int)((p % fxy) % igraph->frame.xsize) - igraph->origin.x;
+    u.y = (int)((p % fxy) / igraph->frame.xsize) - igraph->origin.y;
+    u.z = (int)(p / fxy) - igraph->origin.z;
+
+    if (!iftValidVoxel(igraph->index, u))
+        return IFT_NIL;
+
+    return igraph->nindex[iftGetVoxelIndex(igraph->index, u)];
+}
+
 iftImage *iftIGraphLabel(iftIGraph *igraph)
 {
-    int p;
-    iftImage *label = iftCreateImage(igraph->index->xsize,igraph->index->ysize,igraph->index->zsize);
+    iftImage *label = _iftIGraphDomainLabel(igraph);
 
-    for (p=0; p < label->n; p++) {
-        label->val[p] = igraph->label[p];
-    }
+    /* labels of a cropped graph are pasted back into its frame */
+    if (label->xsize != igraph->frame.xsize || label->ysize != igraph->frame.ysize ||
+        label->zsize != igraph->frame.zsize) {
+        iftImage *roi = label;
 
-    iftCopyVoxelSize(igraph->index, label);
+        label = iftCreateImage(igraph->frame.xsize, igraph->frame.ysize, igraph->frame.zsize);
+        iftCopyVoxelSize(roi, label);
+        iftInsertROI(roi, label, igraph->origin);
+        iftDestroyImage(&roi);
+    }
 
     return(label);
 }
 
+void iftIGraphLabelToBuffer(const iftIGraph *igraph, void *label, int nbits, long stride)
+{
+    int nrows, fysize;
+    iftVoxel o;
+
+    if (nbits != 16 && nbits != 32)
+        iftError("Invalid number of bits: %d (16 or 32)", "iftIGraphLabelToBuffer", nbits);
+    if (stride < (long)igraph->frame.xsize * (nbits/8))
+        iftError("The stride %ld is shorter than a row", "iftIGraphLabelToBuffer", stride);
+
+    nrows  = igraph->frame.ysize * igraph->frame.zsize;
+    fysize = igraph->frame.ysize;
+    o      = igraph->origin;
+
+    /* voxels out of the graph (or of a cropped graph) are labeled 0 */
+#pragma omp parallel for schedule(static)
+    for (int r = 0; r < nrows; r++)
+        memset((uchar *)label + r * stride, 0, (size_t)igraph->frame.xsize * (nbits/8));
+
+#pragma omp parallel for schedule(static)
+    for (iftIdx s = 0; s < igraph->nnodes; s++) {
+        iftVoxel u = iftGetVoxelCoord(igraph->index, igraph->node[s].voxel);
+        uchar   *row;
+
+        row = (uchar *)label + ((long)(u.z + o.z) * fysize + u.y + o.y) * stride;
+        if (nbits == 32)
+            ((int *)row)[u.x + o.x] = (int)igraph->label[s];
+        else {
+            if (igraph->label[s] < 0 || igraph->label[s] > 65535)
+                iftError("Label %ld does not fit in 16 bits", "iftIGraphLabelToBuffer",
+                         (long)igraph->label[s]);
+            ((ushort *)row)[u.x + o.x] = (ushort)igraph->label[s];
+        }
+    }
+}
+
 void iftIGraphSetFWeight(iftIGraph *igraph, iftFImage *weight)
 {
-    for (int s=0; s < igraph->nnodes; s++) {
-        int p = igraph->node[s].voxel;
+    for (iftIdx s=0; s < igraph->nnodes; s++) {
+        iftIdx p = igraph->node[s].voxel;
         igraph->node[s].weight = weight->val[p];
     }
 }
 
 iftFImage *iftIGraphWeight(iftIGraph *igraph)
 {
-    int p,s;
+    iftIdx p, s;
     iftFImage *weight = iftCreateFImage(igraph->index->xsize,igraph->index->ysize,igraph->index->zsize);
 
     for (s=0; s < igraph->nnodes; s++) {
@@ -6641,72 +8917,351 @@ iftFImage *iftIGraphWeight(iftIGraph *igraph)
 
 float iftIGraphMaximumFeatureValue (iftIGraph * igraph, int feature) {
     float max;
-    int s, p;
+    iftIdx s;
 
     max = IFT_INFINITY_FLT_NEG;
     for (s = 0; s < igraph->nnodes; s++) {
-        p = igraph->node[s].voxel;
-        if (igraph->feat[p][feature] > max) {
-            max = igraph->feat[p][feature];
+        if (iftIGraphFeat(igraph, s, feature) > max) {
+            max = iftIGraphFeat(igraph, s, feature);
         }
     }
 
     return max;
 }
 
+void iftIGraphQuantizeFeats(iftIGraph *igraph, int nbits)
+{
+    long   n = (long)igraph->nnodes*igraph->nfeats;
+    float *feat, min, max;
+    int    qmax;
+
+    if ((nbits != 8) && (nbits != 16))
+        iftError("Invalid number of bits: %d (8 or 16)", "iftIGraphQuantizeFeats", nbits);
+    if (igraph->qbits != 0)
+        iftError("The graph's features are already quantized", "iftIGraphQuantizeFeats");
+
+    /* a single range for all attributes, so the quantized distances are
+       the float ones up to the factor qstep */
+    feat = igraph->feat[0];
+    min  = IFT_INFINITY_FLT;
+    max  = IFT_INFINITY_FLT_NEG;
+    for (long k=0; k < n; k++) {
+        if (feat[k] < min) min = feat[k];
+        if (feat[k] > max) max = feat[k];
+    }
+    if (n == 0)
+        min = max = 0.0;
+
+    qmax          = (1 << nbits) - 1;
+    igraph->qmin  = min;
+    igraph->qstep = (max > min) ? (max - min)/qmax : 1.0;
+    igraph->qfeat = iftAlloc(iftMax(n,1), (nbits == 8) ? sizeof(uchar) : sizeof(ushort));
+
+#pragma omp parallel for
+    for (long k=0; k < n; k++) {
+        int q = (int)((feat[k] - igraph->qmin)/igraph->qstep + 0.5);
+        q     = iftMin(q, qmax);
+        if (nbits == 8)
+            ((uchar *)igraph->qfeat)[k]  = (uchar)q;
+        else
+            ((ushort *)igraph->qfeat)[k] = (ushort)q;
+    }
+
+    igraph->qbits = nbits;
+    iftFree(igraph->feat[0]);
+    iftFree(igraph->feat);
+    igraph->feat  = NULL;
+}
+
+/* Moves element s of arr, with the given size, to position newid[s] */
+void _iftPermuteArray(void *arr, const iftIdx *newid, iftIdx n, size_t size)
+{
+    char *tmp = (char *)iftAlloc(iftMax(n,1), size);
+
+    for (iftIdx s=0; s < n; s++)
+        memcpy(tmp + (size_t)newid[s]*size, (char *)arr + (size_t)s*size, size);
+    memcpy(arr, tmp, (size_t)n*size);
+    iftFree(tmp);
+}
+
+/* Spreads the 21 lower bits of v, such that they are 3 bits apart */
+ullong _iftMortonSpread(ullong v)
+{
+    v &= 0x1fffff;
+    v  = (v | v << 32) & 0x1f00000000ffffULL;
+    v  = (v | v << 16) & 0x1f0000ff0000ffULL;
+    v  = (v | v << 8)  & 0x100f00f00f00f00fULL;
+    v  = (v | v << 4)  & 0x10c30c30c30c30c3ULL;
+    v  = (v | v << 2)  & 0x1249249249249249ULL;
+    return(v);
+}
+
+typedef struct _ift_node_key {
+    ullong key;
+    iftIdx node;
+} _iftNodeKey;
+
+int _iftCompareNodeKeys(const void *a, const void *b)
+{
+    const _iftNodeKey *x = (const _iftNodeKey *)a, *y = (const _iftNodeKey *)b;
+
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+/* New id of each node, for the given layout */
+iftIdx *_iftIGraphNodeIds(const iftIGraph *igraph, char order)
+{
+    iftImage *index = igraph->index;
+    iftIdx   *newid = iftAllocIdxArray(iftMax(igraph->nnodes,1));
+    iftIdx    n = 0;
+    int       t = IFT_NODE_TILE, tz = iftIs3DImage(index) ? IFT_NODE_TILE : 1;
+    iftVoxel  b, u;
+
+    switch (order) {
+    case IFT_RASTER_ORDER:
+        for (iftIdx p=0; p < index->n; p++)
+            if (igraph->nindex[p] != IFT_NIL)
+                newid[igraph->nindex[p]] = n++;
+        break;
+
+    case IFT_TILED_ORDER:
+        for (b.z=0; b.z < index->zsize; b.z += tz)
+            for (b.y=0; b.y < index->ysize; b.y += t)
+                for (b.x=0; b.x < index->xsize; b.x += t)
+                    for (u.z=b.z; u.z < iftMin(b.z+tz, index->zsize); u.z++)
+                        for (u.y=b.y; u.y < iftMin(b.y+t, index->ysize); u.y++)
+                            for (u.x=b.x; u.x < iftMin(b.x+t, index->xsize); u.x++) {
+                                iftIdx s = igraph->nindex[iftGetVoxelIndex(index,u)];
+                                if (s != IFT_NIL)
+                                    newid[s] = n++;
+                            }
+        break;
+
+    case IFT_MORTON_ORDER: {
+        _iftNodeKey *key = (_iftNodeKey *)iftAlloc(iftMax(igraph->nnodes,1), sizeof(_iftNodeKey));
+
+        for (iftIdx s=0; s < igraph->nnodes; s++) {
+            u = iftGetVoxelCoord(index, igraph->node[s].voxel);
+            key[s].key  = _iftMortonSpread(u.x) | _iftMortonSpread(u.y) << 1 |
+                          _iftMortonSpread(u.z) << 2;
+            key[s].node = s;
+        }
+        qsort(key, igraph->nnodes, sizeof(_iftNodeKey), _iftCompareNodeKeys);
+        for (iftIdx i=0; i < igraph->nnodes; i++)
+            newid[key[i].node] = i;
+        iftFree(key);
+        break;
+    }
+
+    default:
+        iftError("Invalid node order: %d", "iftIGraphSetNodeOrder", order);
+    }
+
+    return(newid);
+}
+
+void iftIGraphSetNodeOrder(iftIGraph *igraph, char order)
+{
+    iftIdx *newid, n = igraph->nnodes;
+
+    if (igraph->type != IMPLICIT)
+        iftError("Only implicit graphs can be reordered", "iftIGraphSetNodeOrder");
+
+    /* the node ids are translated by the index image, so renumbering the
+       nodes changes only where their attributes lie in memory */
+    newid = _iftIGraphNodeIds(igraph, order);
+
+    _iftPermuteArray(igraph->node, newid, n, sizeof(iftINode));
+    if (igraph->feat != NULL) /* a single block, thus feat[s] is kept */
+        _iftPermuteArray(igraph->feat[0], newid, n, igraph->nfeats*sizeof(float));
+    else
+        _iftPermuteArray(igraph->qfeat, newid, n, igraph->nfeats*(igraph->qbits/8));
+
+    for (iftIdx s=0; s < n; s++) {
+        igraph->root[s] = newid[igraph->root[s]];
+        if (igraph->pred[s] != IFT_NIL)
+            igraph->pred[s] = newid[igraph->pred[s]];
+    }
+    _iftPermuteArray(igraph->label, newid, n, sizeof(iftIdx));
+    _iftPermuteArray(igraph->root, newid, n, sizeof(iftIdx));
+    _iftPermuteArray(igraph->pred, newid, n, sizeof(iftIdx));
+    _iftPermuteArray(igraph->pvalue, newid, n, sizeof(double));
+
+    for (iftIdx p=0; p < igraph->index->n; p++)
+        if (igraph->nindex[p] != IFT_NIL)
+            igraph->nindex[p] = newid[igraph->nindex[p]];
+
+    /* the per-iteration passes visit the nodes in raster order of their
+       voxels, which is kept here, so that they cost O(nnodes) rather than
+       O(index->n) */
+    iftFree(igraph->raster);
+    igraph->raster = NULL;
+    if (order != IFT_RASTER_ORDER) {
+        iftIdx k = 0;
+
+        igraph->raster = iftAllocIdxArray(iftMax(n,1));
+        for (iftIdx p=0; p < igraph->index->n; p++)
+            if (igraph->nindex[p] != IFT_NIL)
+                igraph->raster[k++] = igraph->nindex[p];
+    }
+
+    igraph->order = order;
+    iftFree(newid);
+}
+
 // ---------- iftIGraph.c end
 // ---------- iftSeeds.c start
-iftImage *iftFastLabelComp(const iftImage *bin, const iftAdjRel *Ain) 
+#define IFT_UF_NBLOCKS 64
+
+iftIdx _iftUnionFindRoot(iftIdx *parent, iftIdx p)
 {
-    iftAdjRel *A = NULL;
-    if (Ain == NULL) {
-        if (iftIs3DImage(bin))
-            A = iftSpheric(1.4);
-        else A = iftCircular(1.5);
-    }
-    else A = iftCopyAdjacency(Ain);
+  while (parent[p] != p) {
+    parent[p] = parent[parent[p]]; /* path halving */
+    p         = parent[p];
+  }
+  return(p);
+}
+
+void _iftUnionFindMerge(iftIdx *parent, iftIdx p, iftIdx q)
+{
+  p = _iftUnionFindRoot(parent,p);
+  q = _iftUnionFindRoot(parent,q);
+
+  /* the smallest index is always the root, thus parent[p] <= p */
+  if (p < q)
+    parent[q] = p;
+  else if (q < p)
+    parent[p] = q;
+}
 
-  iftImage *label=NULL;
-  int i,p,q,l=1, *cost;
-  iftVoxel u,v;
-  iftGQueue *Q;
+/* Labels the components of voxels with the same non-zero value, by a
+   block-parallel two-pass union-find. The image rows are split into
+   blocks, which are merged independently, and the pairs crossing the
+   blocks are merged afterwards. Since the root of each component is its
+   first voxel in raster order, the labels are numbered in that order,
+   regardless of the number of blocks and threads. */
+iftImage *_iftUnionFindLabelComp(const iftImage *img, const iftAdjRel *A)
+{
+  iftImage *label;
+  iftIdx   *parent, p, first[IFT_UF_NBLOCKS+1];
+  int      *back, nback, max_off, nlines, nblocks, b, i;
+  int       nroots[IFT_UF_NBLOCKS+1];
 
-  label  = iftCreateImageFromImage(bin);
-  cost   = iftAllocIntArray(bin->n);
-  Q      = iftCreateGQueue(2,bin->n,cost);
+  label  = iftCreateImageFromImage(img);
+  parent = iftAllocIdxArray(img->n);
 
-  for (p=0; p < bin->n; p++){
-    if ((bin->val[p]!=0)&&(label->val[p]==0)){
-      cost[p] = 1;
-      iftInsertGQueue(&Q,p);
+  /* only the adjacent voxels which precede the voxel in raster order */
+  back    = iftAllocIntArray(A->n);
+  nback   = 0;
+  max_off = 0;
+  for (i=1; i < A->n; i++) {
+    int off = A->dx[i] + A->dy[i]*img->xsize + A->dz[i]*img->xsize*img->ysize;
+    if (off < 0) {
+      back[nback++] = i;
+      max_off       = iftMax(max_off,-off);
     }
   }
 
-  while(!iftEmptyGQueue(Q)){
-    p = iftRemoveGQueue(Q);
-    if (cost[p]==1){ /* p is the first in a component */
-      cost[p]=0;
-      label->val[p] = l; l++;
+  nlines  = img->ysize*img->zsize;
+  nblocks = iftMin(nlines,IFT_UF_NBLOCKS);
+  for (b=0; b <= nblocks; b++)
+    first[b] = ((iftIdx)nlines*b/nblocks)*img->xsize;
+
+  /* first pass: merges the pairs within each block */
+
+  #pragma omp parallel for private(p,i)
+  for (b=0; b < nblocks; b++) {
+    for (p=first[b]; p < first[b+1]; p++) {
+      parent[p] = p;
+      if (img->val[p] == 0)
+        continue;
+
+      iftVoxel u = iftGetVoxelCoord(img,p);
+      for (i=0; i < nback; i++) {
+        iftVoxel v = iftGetAdjacentVoxel(A,u,back[i]);
+        if (iftValidVoxel(img,v)) {
+          iftIdx q = iftGetVoxelIndex(img,v);
+          if ((q >= first[b])&&(img->val[q]==img->val[p]))
+            _iftUnionFindMerge(parent,p,q);
+        }
+      }
     }
-    u = iftGetVoxelCoord(bin,p);
-    for (i=1; i < A->n; i++){
-      v = iftGetAdjacentVoxel(A,u,i);
-      if (iftValidVoxel(bin,v)){
-    q = iftGetVoxelIndex(bin,v);
-    if ((bin->val[p] == bin->val[q])&&(label->val[q] == 0)){
-          label->val[q] = label->val[p];
-          iftRemoveGQueueElem(Q,q);
-          cost[q]=0;
-          iftInsertGQueue(&Q,q);
+  }
+
+  /* merges the pairs crossing the blocks */
+
+  for (b=1; b < nblocks; b++) {
+    for (p=first[b]; p < iftMin(first[b]+max_off,first[b+1]); p++) {
+      if (img->val[p] == 0)
+        continue;
+
+      iftVoxel u = iftGetVoxelCoord(img,p);
+      for (i=0; i < nback; i++) {
+        iftVoxel v = iftGetAdjacentVoxel(A,u,back[i]);
+        if (iftValidVoxel(img,v)) {
+          iftIdx q = iftGetVoxelIndex(img,v);
+          if ((q < first[b])&&(img->val[q]==img->val[p]))
+            _iftUnionFindMerge(parent,p,q);
+        }
+      }
     }
+  }
+
+  /* second pass: numbers the roots in raster order, and then the
+     remaining voxels by their roots */
+
+  #pragma omp parallel for private(p)
+  for (b=0; b < nblocks; b++) {
+    nroots[b+1] = 0;
+    for (p=first[b]; p < first[b+1]; p++)
+      if ((img->val[p] != 0)&&(parent[p] == p))
+        nroots[b+1]++;
+  }
+
+  nroots[0] = 0;
+  for (b=1; b <= nblocks; b++)
+    nroots[b] += nroots[b-1];
+
+  #pragma omp parallel for private(p)
+  for (b=0; b < nblocks; b++) {
+    int l = nroots[b];
+    for (p=first[b]; p < first[b+1]; p++)
+      if ((img->val[p] != 0)&&(parent[p] == p))
+        label->val[p] = ++l;
+  }
+
+  #pragma omp parallel for private(p)
+  for (b=0; b < nblocks; b++) {
+    for (p=first[b]; p < first[b+1]; p++) {
+      if ((img->val[p] != 0)&&(parent[p] != p)) {
+        iftIdx r = parent[p];
+        while (parent[r] != r)
+          r = parent[r];
+        label->val[p] = label->val[r];
       }
     }
   }
 
+  iftFree(back);
+  iftFree(parent);
+
+  return(label);
+}
+
+iftImage *iftFastLabelComp(const iftImage *bin, const iftAdjRel *Ain) 
+{
+    iftAdjRel *A = NULL;
+    if (Ain == NULL) {
+        if (iftIs3DImage(bin))
+            A = iftSpheric(1.4);
+        else A = iftCircular(1.5);
+    }
+    else A = iftCopyAdjacency(Ain);
+
+  iftImage *label = _iftUnionFindLabelComp(bin,A);
+
   iftDestroyAdjRel(&A);
 
-  iftDestroyGQueue(&Q);
-  iftFree(cost);
   return(label);
 }
 
@@ -6744,19 +9299,19 @@ iftAdjRel *_iftFindBestAdjRelForGridSampling(float radius, bool is_3D_adj)
     return A;
 }
 
-iftIntArray *iftGridSamplingOnMask(const iftImage *bin_mask, float radius, int initial_obj_voxel_idx, long n_samples) 
+iftIntArray *iftGridSamplingOnMask(const iftImage *bin_mask, float radius, iftIdx initial_obj_voxel_idx, long n_samples) 
 {
-    int first_obj_voxel = initial_obj_voxel_idx;
+    iftIdx first_obj_voxel = initial_obj_voxel_idx;
 
     if (initial_obj_voxel_idx >= 0) {
       if (bin_mask->val[initial_obj_voxel_idx] == 0) {
-        iftError("Initial Voxel Index %d is not an object voxel",
-                 "iftGridSamplingOnMask", initial_obj_voxel_idx);
+        iftError("Initial Voxel Index %ld is not an object voxel",
+                 "iftGridSamplingOnMask", (long)initial_obj_voxel_idx);
       }
     }
     else {
       // finds the first object voxel from the binary mask
-      int p = 0;
+      iftIdx p = 0;
       for (p = 0; p < bin_mask->n && bin_mask->val[p] == 0; p++) {}
       first_obj_voxel = p;
     }
@@ -6773,8 +9328,8 @@ iftIntArray *iftGridSamplingOnMask(const iftImage *bin_mask, float radius, int i
     for (int i = 0; i < A->n; i++)
         dist->val[i] = sqrtf(A->dx[i]*A->dx[i] + A->dy[i]*A->dy[i] + A->dz[i]*A->dz[i]);
     
-    iftImage *prior = iftCreateImageFromImage(bin_mask);
-    iftImage *label_img = iftCreateImageFromImage(bin_mask);
+    iftImage *prior = iftCreatePooledImage(bin_mask->xsize, bin_mask->ysize, bin_mask->zsize, true);
+    iftImage *label_img = iftCreatePooledImage(bin_mask->xsize, bin_mask->ysize, bin_mask->zsize, true);
     iftGQueue *Q = iftCreateGQueue(IFT_QSIZE, prior->n, prior->val);
     iftSetRemovalPolicy(Q, MAXVALUE);
     
@@ -6786,7 +9341,7 @@ iftIntArray *iftGridSamplingOnMask(const iftImage *bin_mask, float radius, int i
     int label = 1;
 
     while (!iftEmptyGQueue(Q)) {
-        int p = iftRemoveGQueue(Q);
+        iftIdx p = iftRemoveGQueue(Q);
         iftVoxel u = iftGetVoxelCoord(bin_mask, p);
         iftInsertListIntoTail(grid, p);
 
@@ -6794,7 +9349,7 @@ iftIntArray *iftGridSamplingOnMask(const iftImage *bin_mask, float radius, int i
             iftVoxel v = iftGetAdjacentVoxel(A, u, i);
 
             if (iftValidVoxel(bin_mask, v) && (iftImgVoxelVal(bin_mask, v) != 0) && (iftImgVoxelVal(label_img, v) == 0)) {
-                int q = iftGetVoxelIndex(bin_mask, v);
+                iftIdx q = iftGetVoxelIndex(bin_mask, v);
 
                 // q is inside the sphere
                 if (dist->val[i] < radius) {
@@ -6848,24 +9403,24 @@ iftIntArray *iftGridSamplingOnMask(const iftImage *bin_mask, float radius, int i
 
     // cleaning up
     iftDestroyAdjRel(&A);
-    iftDestroyImage(&prior);
-    iftDestroyImage(&label_img);
+    iftDestroyPooledImage(&prior);
+    iftDestroyPooledImage(&label_img);
     iftDestroyGQueue(&Q);
     iftDestroyFloatArray(&dist);
 
     return grid_chosen;
 }
 
-float iftEstimateGridOnMaskSamplingRadius(const iftImage *binMask, int initialObjVoxelIdx, int nSamples)
+float iftEstimateGridOnMaskSamplingRadius(const iftImage *binMask, iftIdx initialObjVoxelIdx, int nSamples)
 {
   if (nSamples == 1) { return 0.0; }
 
   bool is3D = iftIs3DImage(binMask);
 
   // Compute radius if each seed actually covered its entire radius 
-  int totalArea = 0;
+  iftIdx totalArea = 0;
 
-  for (int p = 0; p < binMask->n; ++p)
+  for (iftIdx p = 0; p < binMask->n; ++p)
     if (binMask->val[p] != 0)
       totalArea += 1;
   double baseR;
@@ -6916,7 +9471,7 @@ iftSet *iftObjectBorderSet(const iftImage *label_img, iftAdjRel *Ain)
 
     iftSet *borders = NULL;
 
-    for (int p = 0; p < label_img->n; p++) {
+    for (iftIdx p = 0; p < label_img->n; p++) {
         if (label_img->val[p] != 0) {
             iftVoxel u = iftGetVoxelCoord(label_img, p);
             
@@ -6924,7 +9479,7 @@ iftSet *iftObjectBorderSet(const iftImage *label_img, iftAdjRel *Ain)
                 iftVoxel v = iftGetAdjacentVoxel(A, u, i);
 
                 if (iftValidVoxel(label_img, v)) {
-                    int q = iftGetVoxelIndex(label_img, v);
+                    iftIdx q = iftGetVoxelIndex(label_img, v);
                     
                     if (label_img->val[q] != label_img->val[p]) {
                         iftInsertSet(&borders, p);
@@ -6947,75 +9502,181 @@ iftSet *iftObjectBorderSet(const iftImage *label_img, iftAdjRel *Ain)
     return borders;
 }
 
-iftImage *iftSelectKLargestRegionsAndPropagateTheirLabels(iftImage *label, iftAdjRel *A, int K)
+/* Maps each component of a relabeled image (see iftRelabelRegions) by
+   the lookup table, and fills the voxels mapped to zero with the labels
+   of their closest (in the adjacency sense) mapped components */
+iftImage *_iftRemapRegionsAndPropagateTheirLabels(const iftImage *comp, const int *lut, iftAdjRel *A)
+{
+  iftImage *nlabel;
+  iftFIFO  *F;
+  iftIdx    p;
+  int       i;
+
+  nlabel = iftCreateImage(comp->xsize,comp->ysize,comp->zsize);
+  iftCopyVoxelSize(comp,nlabel);
+
+  #pragma omp parallel for
+  for (p=0; p < comp->n; p++)
+    nlabel->val[p] = lut[comp->val[p]];
+
+  /* fill regions with label zero from the labeled voxels, in a
+     breadth-first order */
+
+  F = iftCreateFIFO(nlabel->n);
+  for (p=0; p < nlabel->n; p++)
+    if (nlabel->val[p] != 0)
+      iftInsertFIFO(F,p);
+
+  while(!iftEmptyFIFO(F)) {
+    p          = iftRemoveFIFO(F);
+    iftVoxel u = iftGetVoxelCoord(nlabel,p);
+    for (i=1; i < A->n; i++) {
+      iftVoxel v = iftGetAdjacentVoxel(A,u,i);
+      if (iftValidVoxel(nlabel,v)){
+	iftIdx q = iftGetVoxelIndex(nlabel,v);
+	if (nlabel->val[q]==0){
+	  nlabel->val[q]=nlabel->val[p];
+	  iftInsertFIFO(F,q);
+	}
+      }
+    }
+  }
+
+  iftDestroyFIFO(&F);
+
+  return(nlabel);
+}
+
+/* Relabels the components of the label image in decreasing order of
+   size, and returns their sizes in the new order (size[0] = 0 for the
+   background) */
+iftImage *_iftRelabelRegionsBySize(iftImage *label, iftAdjRel *A, int **size, int *ncomps)
 {
-  iftImage *nlabel[2];
-  int       ncomps,p,i,*index,*size;
-  iftSet *S = NULL;
+  iftImage *comp;
+  iftIdx    p;
+  int       i, *index, *lut;
 
   /* relabel components: it accounts for disconnected labels, which
      should be considered multiple components */
 
-  nlabel[0] = iftRelabelRegions(label,A);
+  comp    = iftRelabelRegions(label,A);
+  *ncomps = iftMaximumValue(comp);
+  *size   = iftAllocIntArray(*ncomps+1);
+  index   = iftAllocIntArray(*ncomps+1);
+  lut     = iftAllocIntArray(*ncomps+1);
+
+  for (i=0; i <= *ncomps; i++)
+    index[i]=i;
+
+  /* Do not consider label 0 --- background */
+  for (p=0; p < comp->n; p++)
+    (*size)[comp->val[p]]++;
+  (*size)[0]=0;
+
+  iftBucketSort(*size, index, *ncomps+1, IFT_DECREASING);
+
+  /* the background is the only component with null size, thus it is
+     the last one */
+  for (i=0; i < *ncomps; i++)
+    lut[index[i]] = i+1;
+  lut[0] = 0;
+
+  #pragma omp parallel for
+  for (p=0; p < comp->n; p++)
+    comp->val[p] = lut[comp->val[p]];
+
+  /* sizes in the new order: 1..ncomps */
+  for (i=*ncomps; i > 0; i--)
+    (*size)[i] = (*size)[i-1];
+  (*size)[0] = 0;
+
+  iftFree(index);
+  iftFree(lut);
+
+  return(comp);
+}
 
-  ncomps = iftMaximumValue(nlabel[0]);
-  size   = iftAllocIntArray(ncomps+1);
-  index  = iftAllocIntArray(ncomps+1);
+iftImage *iftSelectKLargestRegionsAndPropagateTheirLabels(iftImage *label, iftAdjRel *A, int K)
+{
+  iftImage *comp, *nlabel;
+  int       ncomps, i, *size, *lut;
 
   if (K <= 0)
       iftError("Invalid number of components", "iftSelectKLargestRegions");
 
+  comp = _iftRelabelRegionsBySize(label,A,&size,&ncomps);
+
   if (K > ncomps)
     K = ncomps;
 
-  for (i=0; i <= ncomps; i++) {
-    index[i]=i;
-    size[i] =0.0;
-  }
+  /* components are already sorted by size */
+  lut = iftAllocIntArray(ncomps+1);
+  for (i=1; i <= K; i++)
+    lut[i] = i;
 
-  /* Do not consider label 0 --- background */
-  for (p=0; p < nlabel[0]->n; p++)
-    size[nlabel[0]->val[p]]++;
-  size[0]=0;
+  nlabel = _iftRemapRegionsAndPropagateTheirLabels(comp,lut,A);
 
-  iftBucketSort(size, index, ncomps+1, IFT_DECREASING);
+  iftFree(lut);
   iftFree(size);
+  iftDestroyImage(&comp);
 
-  nlabel[1] = iftCreateImage(nlabel[0]->xsize,nlabel[0]->ysize,nlabel[0]->zsize);
-  for (p=0; p < nlabel[0]->n; p++) {
-    for (i=0; i < K; i++) {
-      if (nlabel[0]->val[p]==index[i]){
-	nlabel[1]->val[p]=i+1;
-	iftInsertSet(&S,p);
-      }
-    }
-  }
+  return(nlabel);
+}
 
-  iftCopyVoxelSize(label,nlabel[1]);
-  iftFree(index);
+iftImage *iftSelectRegionsAboveAreaAndPropagateTheirLabels(iftImage *label, iftAdjRel *A, int min_area)
+{
+  iftImage *comp, *nlabel;
+  int       ncomps, i, *size, *lut;
 
-  /* fill regions with label zero from the labeled voxels in the
-     set */
+  if (min_area < 0)
+      iftError("Invalid minimum area", "iftSelectRegionsAboveAreaAndPropagateTheirLabels");
 
-  while(S != NULL) {
-    int p      = iftRemoveSet(&S);
-    iftVoxel u = iftGetVoxelCoord(nlabel[1],p);
-    for (i=1; i < A->n; i++) {
-      iftVoxel v = iftGetAdjacentVoxel(A,u,i);
-      if (iftValidVoxel(nlabel[1],v)){
-	int q = iftGetVoxelIndex(nlabel[1],v);
-	if (nlabel[1]->val[q]==0){
-	  nlabel[1]->val[q]=nlabel[1]->val[p];
-	  iftInsertSet(&S,q);
-	}
-      }
+  comp = _iftRelabelRegionsBySize(label,A,&size,&ncomps);
+
+  /* components are already sorted by size, and the largest one is
+     always kept */
+  lut = iftAllocIntArray(ncomps+1);
+  for (i=1; i <= ncomps && (i == 1 || size[i] >= min_area); i++)
+    lut[i] = i;
+
+  nlabel = _iftRemapRegionsAndPropagateTheirLabels(comp,lut,A);
+
+  iftFree(lut);
+  iftFree(size);
+  iftDestroyImage(&comp);
+
+  return(nlabel);
+}
+
+iftIntArray *iftSeedImageToIntArray(const iftImage *seed_img)
+{
+    iftIdx nseeds = 0;
+
+    #pragma omp parallel for reduction(+:nseeds)
+    for (iftIdx p = 0; p < seed_img->n; p++)
+        if (seed_img->val[p] != 0)
+            nseeds++;
+
+    iftIntArray *seeds = iftCreateIntArray(nseeds);
+
+    for (iftIdx p = 0, i = 0; p < seed_img->n; p++)
+        if (seed_img->val[p] != 0)
+            seeds->val[i++] = p;
+
+    return seeds;
+}
+
+iftImage *iftIntArrayToSeedImage(const iftIntArray *seeds, int xsize, int ysize, int zsize)
+{
+    iftImage *seed_img = iftCreateImage(xsize, ysize, zsize);
+
+    for (long i = 0; i < seeds->n; i++) {
+        if (seeds->val[i] < 0 || seeds->val[i] >= seed_img->n)
+            iftError("Seed index %ld is outside the image domain", "iftIntArrayToSeedImage", (long)seeds->val[i]);
+        seed_img->val[seeds->val[i]] = 1;
     }
-  }
-	
-  iftDestroySet(&S);
-  iftDestroyImage(&nlabel[0]);
 
-  return(nlabel[1]);
+    return seed_img;
 }
 
 // ---------- iftSeeds.c end
@@ -7367,7 +10028,7 @@ bool iftRegexMatch(const char *str, const char *regex_pattern, ...) {
 iftImage *iftAddValue(const iftImage *img, int val)
 {
   iftImage *nimg=NULL;
-  int p;
+  iftIdx p;
 
   if (val < 0)
     iftWarning("Resulting image may have negative values","iftAddValue");
@@ -7491,7 +10152,7 @@ void iftBucketSort(int *value, int *index, int nelems, uchar order)
 // ---------- iftSort.c end
 // ---------- iftBMap.c start
 
-iftBMap *iftCreateBMap(int n) 
+iftBMap *iftCreateBMap(iftIdx n) 
 {
     iftBMap *b;
     b= (iftBMap *) iftAlloc(1,sizeof(iftBMap));
@@ -7555,7 +10216,7 @@ bool iftIsEmptyList(const iftList *L)
     return (L->n == 0);
 }
 
-void iftInsertListIntoTail(iftList *L, int elem) 
+void iftInsertListIntoTail(iftList *L, iftIdx elem) 
 {
     if (L == NULL)
         iftError("The Integer Linked List L is NULL. Allocated it firstly", "iftInsertListIntoTail");
@@ -7580,12 +10241,12 @@ void iftInsertListIntoTail(iftList *L, int elem)
     }
 }
 
-int iftRemoveListTail(iftList *L) 
+iftIdx iftRemoveListTail(iftList *L) 
 {
     if (L == NULL)
         iftError("The Integer Doubly Linked List L is NULL. Allocated it firstly", "iftRemoveListTail");
     
-    int elem      = IFT_NIL;
+    iftIdx elem   = IFT_NIL;
     iftNode *node = NULL;
     
     // if there are elements
@@ -7626,49 +10287,8 @@ iftIntArray *iftListToIntArray(const iftList *L)
 
 iftImage* iftRelabelRegions(iftImage* labelled, iftAdjRel* adj_rel)
 {
-
-	iftImage *relabelled = iftCreateImage(labelled->xsize,labelled->ysize,labelled->zsize);
+	iftImage *relabelled = _iftUnionFindLabelComp(labelled,adj_rel);
 	iftCopyVoxelSize(labelled,relabelled);
-	iftFIFO *F = iftCreateFIFO(labelled->n);
-
-	int nlabels = 1;
-
-	int i;
-	for(i = 0; i < labelled->n; i++){
-		if( (labelled->val[i] != 0) && (relabelled->val[i] == 0)){
-			relabelled->val[i] = nlabels;
-			iftInsertFIFO(F,i);
-
-			while(!iftEmptyFIFO(F)){
-				int p = iftRemoveFIFO(F);
-				iftVoxel u = iftGetVoxelCoord(labelled,p);
-
-				int j;
-				for(j = 1; j < adj_rel->n; j++){
-					iftVoxel v = iftGetAdjacentVoxel(adj_rel,u,j);
-
-					if(iftValidVoxel(labelled,v)){
-						int q = iftGetVoxelIndex(labelled,v);
-
-//                        if((relabelled->val[q] == 0) && (labelled->val[p] == labelled->val[q]) ){
-//                            relabelled->val[q] = nlabels;
-//                            iftInsertFIFO(F,q);
-//                        }
-
-						if(relabelled->val[q] == 0){
-                            if(labelled->val[p] == labelled->val[q])
-                                iftInsertFIFO(F,q);
-                            relabelled->val[q] = nlabels;
-						}
-					}
-				}
-			}
-
-			nlabels++;
-		}
-	}
-
-	iftDestroyFIFO(&F);
 
 	return relabelled;
 }
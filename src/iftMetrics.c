@@ -0,0 +1,283 @@
+#include "iftMetrics.h"
+
+//----------------------------------------------------------------------------//
+// PRIVATE FUNCTIONS
+//----------------------------------------------------------------------------//
+/**
+* BRIEF
+*    Groups the pixels by their labels
+*
+* DESCRIPTION
+*    This function sorts the pixel indexes by their labels in linear time
+*    (i.e., counting sort), such that the pixels of the label l are
+*    order[first[l]..first[l+1]-1], in raster order.
+*
+* PARAMETERS
+*    label     - Label image
+*    first     - Output array of the first position of each label
+*    order     - Output array of the sorted pixel indexes
+*
+* RETURN
+*    Maximum label value
+*/
+int _iftGroupPixelsByLabel
+(const iftImage *label, iftIdx **first, iftIdx **order)
+{
+  int max_label;
+  iftIdx *pos;
+
+  max_label = iftMaximumValue(label);
+
+  if(iftMinimumValue(label) < 0)
+    iftError("Negative labels are not permitted!", "_iftGroupPixelsByLabel");
+
+  *first = iftAllocIdxArray(max_label + 2);
+  *order = iftAllocIdxArray(label->n);
+
+  for(iftIdx p = 0; p < label->n; p++) (*first)[label->val[p] + 1]++;
+  for(int l = 0; l <= max_label; l++) (*first)[l + 1] += (*first)[l];
+
+  pos = iftAllocIdxArray(max_label + 1);
+  for(int l = 0; l <= max_label; l++) pos[l] = (*first)[l];
+
+  for(iftIdx p = 0; p < label->n; p++) (*order)[pos[label->val[p]]++] = p;
+
+  iftFree(pos);
+
+  return max_label;
+}
+
+/**
+* BRIEF
+*    Computes the overlap-based errors between a segmentation and the
+*    ground-truth
+*
+* DESCRIPTION
+*    For each region, the overlap with every ground-truth region is counted
+*    in a thread-local histogram, which is reset by the list of touched
+*    ground-truth labels. Therefore, the cost is linear in the number of
+*    pixels, and the regions are processed in parallel.
+*
+* PARAMETERS
+*    label     - Segmentation label image
+*    gt        - Ground-truth label image
+*    ue        - Output under-segmentation error (can be NULL)
+*    asa       - Output achievable segmentation accuracy (can be NULL)
+*/
+void _iftOverlapErrors
+(const iftImage *label, const iftImage *gt, float *ue, float *asa)
+{
+  int max_label, max_gt;
+  iftIdx *first, *order;
+  long leak, hits;
+
+  iftVerifyImageDomains(label, gt, "_iftOverlapErrors");
+
+  if(iftMinimumValue(gt) < 0)
+    iftError("Negative labels are not permitted!", "_iftOverlapErrors");
+
+  max_label = _iftGroupPixelsByLabel(label, &first, &order);
+  max_gt = iftMaximumValue(gt);
+  leak = hits = 0;
+
+  #ifdef IFT_PARALLEL
+  #pragma omp parallel reduction(+:leak,hits)
+  #endif
+  {
+    iftIdx *count;
+    int *touched;
+
+    count = iftAllocIdxArray(max_gt + 1);
+    touched = iftAllocIntArray(max_gt + 1);
+
+    #ifdef IFT_PARALLEL
+    #pragma omp for schedule(dynamic, 16)
+    #endif
+    for(int l = 0; l <= max_label; l++)
+    {
+      iftIdx size, max_count;
+      int ntouched;
+
+      size = first[l + 1] - first[l];
+      ntouched = 0;
+      max_count = 0;
+
+      for(iftIdx i = first[l]; i < first[l + 1]; i++)
+      {
+        int g;
+
+        g = gt->val[order[i]];
+        if(count[g] == 0) touched[ntouched++] = g;
+        count[g]++;
+      }
+
+      for(int i = 0; i < ntouched; i++)
+      {
+        iftIdx c;
+
+        c = count[touched[i]];
+        leak += iftMin(c, size - c);
+        max_count = iftMax(max_count, c);
+        count[touched[i]] = 0;
+      }
+
+      hits += max_count;
+    }
+
+    iftFree(count);
+    iftFree(touched);
+  }
+
+  if(ue != NULL) *ue = leak / (float)label->n;
+  if(asa != NULL) *asa = hits / (float)label->n;
+
+  iftFree(first);
+  iftFree(order);
+}
+
+//----------------------------------------------------------------------------//
+// PUBLIC FUNCTIONS
+//----------------------------------------------------------------------------//
+float iftBoundaryRecall
+(const iftImage *label, const iftImage *gt, float tol)
+{
+  // 1. Input Validation -------------------------------------------------------
+  iftVerifyImageDomains(label, gt, "iftBoundaryRecall");
+
+  if(tol < 0.0) iftError("Invalid tolerance distance!", "iftBoundaryRecall");
+
+  // 2. Boundary Extraction ----------------------------------------------------
+  long num_gt, num_hits;
+  iftAdjRel *A, *B;
+  iftBMap *gt_border, *border;
+
+  if(iftIs3DImage(label)) { A = iftSpheric(1.0); B = iftSpheric(tol); }
+  else { A = iftCircular(1.0); B = iftCircular(tol); }
+
+  gt_border = iftBorderBMap(gt, A);
+  border = iftBorderBMap(label, A);
+
+  // 3. Boundary Matching ------------------------------------------------------
+  num_gt = num_hits = 0;
+
+  #ifdef IFT_PARALLEL
+  #pragma omp parallel for reduction(+:num_gt,num_hits)
+  #endif
+  for(iftIdx p = 0; p < label->n; p++)
+  {
+    if(iftBMapValue(gt_border, p))
+    {
+      bool found;
+      iftVoxel u;
+
+      num_gt++;
+      found = false;
+      u = iftGetVoxelCoord(label, p);
+
+      for(int i = 0; i < B->n && !found; i++)
+      {
+        iftVoxel v;
+
+        v = iftGetAdjacentVoxel(B, u, i);
+        if(iftValidVoxel(label, v))
+          found = iftBMapValue(border, iftGetVoxelIndex(label, v));
+      }
+
+      if(found) num_hits++;
+    }
+  }
+
+  iftDestroyBMap(&gt_border);
+  iftDestroyBMap(&border);
+  iftDestroyAdjRel(&A);
+  iftDestroyAdjRel(&B);
+
+  if(num_gt == 0) return 1.0; // No boundary to be recalled
+
+  return num_hits / (float)num_gt;
+}
+
+float iftUnderSegmentationError
+(const iftImage *label, const iftImage *gt)
+{
+  float ue;
+
+  _iftOverlapErrors(label, gt, &ue, NULL);
+
+  return ue;
+}
+
+float iftAchievableSegmentationAccuracy
+(const iftImage *label, const iftImage *gt)
+{
+  float asa;
+
+  _iftOverlapErrors(label, gt, NULL, &asa);
+
+  return asa;
+}
+
+float iftCompactness
+(const iftImage *label)
+{
+  // 1. Create Aux Vars --------------------------------------------------------
+  bool is_3D;
+  int max_label;
+  iftIdx *first, *order;
+  double co;
+  iftAdjRel *A;
+
+  is_3D = iftIs3DImage(label);
+  if(is_3D) A = iftSpheric(1.0);
+  else A = iftCircular(1.0);
+
+  max_label = _iftGroupPixelsByLabel(label, &first, &order);
+  co = 0.0;
+
+  // 2. Isoperimetric Quotients ------------------------------------------------
+  #ifdef IFT_PARALLEL
+  #pragma omp parallel for reduction(+:co) schedule(dynamic, 16)
+  #endif
+  for(int l = 0; l <= max_label; l++)
+  {
+    long area, perim;
+
+    area = first[l + 1] - first[l];
+    perim = 0;
+
+    for(iftIdx i = first[l]; i < first[l + 1]; i++)
+    {
+      iftIdx p;
+      iftVoxel u;
+
+      p = order[i];
+      u = iftGetVoxelCoord(label, p);
+
+      for(int j = 1; j < A->n; j++)
+      {
+        iftVoxel v;
+
+        v = iftGetAdjacentVoxel(A, u, j);
+        if(!iftValidVoxel(label, v) ||
+           label->val[iftGetVoxelIndex(label, v)] != l)
+          perim++;
+      }
+    }
+
+    if(area > 0)
+    {
+      double q;
+
+      if(is_3D) q = 36.0 * IFT_PI * area * area / ((double)perim * perim * perim);
+      else q = 4.0 * IFT_PI * area / ((double)perim * perim);
+
+      co += q * area;
+    }
+  }
+
+  iftFree(first);
+  iftFree(order);
+  iftDestroyAdjRel(&A);
+
+  return co / (double)label->n;
+}
@@ -0,0 +1,482 @@
+#include "iftODIFF.h"
+
+//----------------------------------------------------------------------------//
+// PRIVATE FUNCTIONS
+//----------------------------------------------------------------------------//
+/**
+* BRIEF
+*    Computes the seed density of a pixel
+*
+* DESCRIPTION
+*    The density is a linear combination of an uniform term, the saliency
+*    value and its complement, in which the weights are set for each term to
+*    sum up its respective quantity of seeds within the ROI.
+*
+* PARAMETERS
+*    val       - Saliency value of the pixel
+*    min_val   - Minimum saliency value
+*    max_val   - Maximum saliency value
+*    w         - Weights of the uniform, object and background terms
+*
+* RETURN
+*    Seed density of the pixel
+*/
+double _iftODIFFDensity
+(int val, int min_val, int max_val, const double w[3])
+{
+  return w[0] + w[1] * (val - min_val) + w[2] * (max_val - val);
+}
+
+/**
+* BRIEF
+*    Selects the ROI pixel which best represents the density within a box
+*
+* DESCRIPTION
+*    This function computes the density-weighted centroid of the ROI pixels
+*    within the box, and returns the ROI pixel closest to it. If the box has
+*    no density at all, the centroid is computed uniformly over its ROI
+*    pixels.
+*
+* PARAMETERS
+*    objsm     - Object saliency map
+*    mask      - ROI image
+*    bb        - Box delimiting the pixels to be considered
+*    min_val   - Minimum saliency value
+*    max_val   - Maximum saliency value
+*    w         - Weights of the uniform, object and background terms
+*
+* RETURN
+*    Index of the selected pixel, or IFT_NIL if the box has no ROI pixel
+*/
+iftIdx _iftODIFFPlaceSeed
+(const iftImage *objsm, const iftImage *mask, iftBoundingBox bb, int min_val,
+ int max_val, const double w[3])
+{
+  iftIdx seed;
+  long area;
+  double sum, cx, cy, cz, ux, uy, uz, min_dist;
+  iftVoxel v;
+
+  area = 0;
+  sum = cx = cy = cz = 0.0;
+  ux = uy = uz = 0.0;
+
+  for(v.z = bb.begin.z; v.z <= bb.end.z; v.z++)
+    for(v.y = bb.begin.y; v.y <= bb.end.y; v.y++)
+      for(v.x = bb.begin.x; v.x <= bb.end.x; v.x++)
+      {
+        iftIdx p;
+
+        p = iftGetVoxelIndex(objsm, v);
+
+        if(mask->val[p] != 0)
+        {
+          double dens;
+
+          dens = _iftODIFFDensity(objsm->val[p], min_val, max_val, w);
+
+          sum += dens;
+          cx += dens * v.x; cy += dens * v.y; cz += dens * v.z;
+          ux += v.x; uy += v.y; uz += v.z;
+          area++;
+        }
+      }
+
+  if(area == 0) return IFT_NIL;
+
+  if(sum > 0.0) { cx /= sum; cy /= sum; cz /= sum; }
+  else { cx = ux / area; cy = uy / area; cz = uz / area; }
+
+  // Snap the centroid to the closest ROI pixel
+  seed = IFT_NIL;
+  min_dist = IFT_INFINITY_DBL;
+
+  for(v.z = bb.begin.z; v.z <= bb.end.z; v.z++)
+    for(v.y = bb.begin.y; v.y <= bb.end.y; v.y++)
+      for(v.x = bb.begin.x; v.x <= bb.end.x; v.x++)
+      {
+        iftIdx p;
+
+        p = iftGetVoxelIndex(objsm, v);
+
+        if(mask->val[p] != 0)
+        {
+          double dist;
+
+          dist = (v.x - cx) * (v.x - cx) + (v.y - cy) * (v.y - cy) +
+                 (v.z - cz) * (v.z - cz);
+
+          if(dist < min_dist) { min_dist = dist; seed = p; }
+        }
+      }
+
+  return seed;
+}
+
+/**
+* BRIEF
+*    Places the given quantity of seeds within a grid cell
+*
+* DESCRIPTION
+*    If more than one seed must be placed, the cell is split into (almost)
+*    equally-sized strata, and a seed is placed in each of the densest ones
+*    (see _iftODIFFPlaceSeed). Otherwise, the seed is placed considering the
+*    whole cell.
+*
+* PARAMETERS
+*    objsm     - Object saliency map
+*    mask      - ROI image
+*    bb        - Box delimiting the cell
+*    nseeds    - Number of seeds to be placed (x > 0)
+*    min_val   - Minimum saliency value
+*    max_val   - Maximum saliency value
+*    w         - Weights of the uniform, object and background terms
+*    seeds     - Output array of seeds (IFT_NIL if a seed could not be placed)
+*/
+void _iftODIFFPlaceCellSeeds
+(const iftImage *objsm, const iftImage *mask, iftBoundingBox bb, int nseeds,
+ int min_val, int max_val, const double w[3], iftIdx *seeds)
+{
+  if(nseeds == 1)
+  {
+    seeds[0] = _iftODIFFPlaceSeed(objsm, mask, bb, min_val, max_val, w);
+    return;
+  }
+
+  // 1. Split the cell ---------------------------------------------------------
+  int g, gz, nstrata, sx, sy, sz;
+  double *dens;
+  iftVoxel v;
+
+  if(iftIs3DImage(objsm)) g = (int)ceil(cbrt((double)nseeds));
+  else g = (int)ceil(sqrt((double)nseeds));
+  gz = iftIs3DImage(objsm) ? g : 1;
+
+  sx = (bb.end.x - bb.begin.x) / g + 1;
+  sy = (bb.end.y - bb.begin.y) / g + 1;
+  sz = (bb.end.z - bb.begin.z) / gz + 1;
+
+  nstrata = g * g * gz;
+  dens = iftAllocDoubleArray(nstrata);
+
+  for(int i = 0; i < nstrata; i++) dens[i] = IFT_INFINITY_DBL_NEG;
+
+  for(v.z = bb.begin.z; v.z <= bb.end.z; v.z++)
+    for(v.y = bb.begin.y; v.y <= bb.end.y; v.y++)
+      for(v.x = bb.begin.x; v.x <= bb.end.x; v.x++)
+      {
+        iftIdx p;
+        int i;
+
+        p = iftGetVoxelIndex(objsm, v);
+
+        if(mask->val[p] != 0)
+        {
+          i = (v.x - bb.begin.x) / sx + g * ((v.y - bb.begin.y) / sy +
+              g * ((v.z - bb.begin.z) / sz));
+
+          if(dens[i] == IFT_INFINITY_DBL_NEG) dens[i] = 0.0;
+          dens[i] += _iftODIFFDensity(objsm->val[p], min_val, max_val, w);
+        }
+      }
+
+  // 2. Place a seed in each of the densest strata -----------------------------
+  for(int j = 0; j < nseeds; j++)
+  {
+    int best;
+
+    best = IFT_NIL;
+    for(int i = 0; i < nstrata; i++)
+    {
+      if(dens[i] != IFT_INFINITY_DBL_NEG && (best == IFT_NIL ||
+         dens[i] > dens[best]))
+        best = i;
+    }
+
+    if(best == IFT_NIL) seeds[j] = IFT_NIL; // No more ROI pixels
+    else
+    {
+      iftBoundingBox sbb;
+
+      sbb.begin.x = bb.begin.x + (best % g) * sx;
+      sbb.begin.y = bb.begin.y + ((best / g) % g) * sy;
+      sbb.begin.z = bb.begin.z + (best / (g * g)) * sz;
+      sbb.end.x = iftMin(sbb.begin.x + sx - 1, bb.end.x);
+      sbb.end.y = iftMin(sbb.begin.y + sy - 1, bb.end.y);
+      sbb.end.z = iftMin(sbb.begin.z + sz - 1, bb.end.z);
+
+      seeds[j] = _iftODIFFPlaceSeed(objsm, mask, sbb, min_val, max_val, w);
+      dens[best] = IFT_INFINITY_DBL_NEG;
+    }
+  }
+
+  iftFree(dens);
+}
+
+//----------------------------------------------------------------------------//
+// PUBLIC FUNCTIONS
+//----------------------------------------------------------------------------//
+iftImage *iftODIFF
+(iftImage* objsm, iftImage *mask, int num_seeds, float obj_perc)
+{
+  iftIntArray *seeds;
+  iftImage *seed_img;
+
+  seeds = iftODIFFSeeds(objsm, mask, num_seeds, obj_perc);
+  seed_img = iftIntArrayToSeedImage(seeds, objsm->xsize, objsm->ysize,
+                                    objsm->zsize);
+  iftDestroyIntArray(&seeds);
+
+  return (seed_img);
+}
+
+iftIntArray *iftODIFFSeeds
+(iftImage* objsm, iftImage *mask, int num_seeds, float obj_perc)
+{
+  // 1. Input Validation -------------------------------------------------------
+  if(objsm->n < num_seeds || num_seeds < 0)
+    iftError("Invalid number of seeds!", "iftODIFFSeeds");
+  if(obj_perc < 0.0 || obj_perc > 1.0)
+    iftError("Invalid object percentage!", "iftODIFFSeeds");
+  if(mask != NULL) iftVerifyImageDomains(objsm, mask, "iftODIFFSeeds");
+
+  // 2. Create Aux Vars --------------------------------------------------------
+  int obj_seeds, bkg_seeds, max_val, min_val;
+  long total_area;
+  double sum_obj, sum_bkg, w[3];
+  iftImage *mask_copy;
+
+  iftMinMaxValues(objsm, &min_val, &max_val);
+
+  if(max_val == min_val) // Only one value (e.g., all black/white)
+  {
+    obj_seeds = num_seeds;
+    bkg_seeds = 0;
+  }
+  else
+  {
+    obj_seeds = iftRound(num_seeds * obj_perc);
+    bkg_seeds = num_seeds - obj_seeds;
+  }
+
+  if( mask == NULL )
+    mask_copy = iftSelectImageDomain(objsm->xsize, objsm->ysize, objsm->zsize);
+  else mask_copy = mask;
+
+  total_area = 0;
+  sum_obj = sum_bkg = 0.0;
+
+  #ifdef IFT_PARALLEL
+  #pragma omp parallel for reduction(+:total_area,sum_obj,sum_bkg)
+  #endif
+  for(iftIdx p = 0; p < objsm->n; p++)
+  {
+    if(mask_copy->val[p] != 0)
+    {
+      total_area++;
+      sum_obj += objsm->val[p] - min_val;
+      sum_bkg += max_val - objsm->val[p];
+    }
+  }
+
+  iftIntArray *seeds;
+
+  if(total_area == 0 || num_seeds == 0)
+  {
+    if(mask == NULL) iftDestroyImage(&mask_copy);
+    return iftCreateIntArray(0);
+  }
+
+  // Weights of the uniform, object and background density terms. If a term
+  // has no density within the ROI, its seeds are spread uniformly.
+  w[0] = w[1] = w[2] = 0.0;
+
+  if(sum_obj > 0.0) w[1] = obj_seeds / sum_obj;
+  else w[0] += obj_seeds / (double)total_area;
+
+  if(sum_bkg > 0.0) w[2] = bkg_seeds / sum_bkg;
+  else w[0] += bkg_seeds / (double)total_area;
+
+  // 3. Density Accumulation ---------------------------------------------------
+  int csize, ncx, ncy, ncz, ncells;
+  int *cell_area;
+  double spacing, *cell_dens;
+
+  // About four cells per seed, given an uniform distribution
+  if(iftIs3DImage(objsm)) spacing = cbrt(total_area / (double)num_seeds);
+  else spacing = sqrt(total_area / (double)num_seeds);
+
+  csize = iftMax(iftRound(spacing / 2.0), 1);
+  ncx = (objsm->xsize + csize - 1) / csize;
+  ncy = (objsm->ysize + csize - 1) / csize;
+  ncz = (objsm->zsize + csize - 1) / csize;
+  ncells = ncx * ncy * ncz;
+
+  cell_dens = iftAllocDoubleArray(ncells);
+  cell_area = iftAllocIntArray(ncells);
+
+  // Each row of cells is accumulated independently
+  #ifdef IFT_PARALLEL
+  #pragma omp parallel for
+  #endif
+  for(int r = 0; r < ncy * ncz; r++)
+  {
+    int cy, cz;
+    iftVoxel v;
+
+    cy = r % ncy; cz = r / ncy;
+
+    for(v.z = cz * csize; v.z < iftMin((cz + 1) * csize, objsm->zsize); v.z++)
+      for(v.y = cy * csize; v.y < iftMin((cy + 1) * csize, objsm->ysize); v.y++)
+        for(v.x = 0; v.x < objsm->xsize; v.x++)
+        {
+          iftIdx p;
+          int c;
+
+          p = iftGetVoxelIndex(objsm, v);
+
+          if(mask_copy->val[p] != 0)
+          {
+            c = v.x / csize + ncx * r;
+
+            cell_dens[c] += _iftODIFFDensity(objsm->val[p], min_val, max_val, w);
+            cell_area[c]++;
+          }
+        }
+  }
+
+  // 4. Error Diffusion --------------------------------------------------------
+  int *cell_seeds, *first;
+  double carry;
+  // Floyd-Steinberg weights: ahead, behind-below, below, ahead-below
+  const int fs_dx[4] = {1, -1, 0, 1}, fs_dy[4] = {0, 1, 1, 1};
+  const double fs_w[4] = {7.0, 3.0, 5.0, 1.0};
+
+  cell_seeds = iftAllocIntArray(ncells);
+  first = iftAllocIntArray(ncells + 1);
+  carry = 0.0;
+
+  for(int cz = 0; cz < ncz; cz++)
+    for(int cy = 0; cy < ncy; cy++)
+    {
+      int dir;
+
+      dir = ((cy + cz * ncy) % 2 == 0) ? 1 : -1; // Serpentine scanning
+
+      for(int i = 0; i < ncx; i++)
+      {
+        int c, cx, nseeds;
+        double val, err, wsum;
+
+        cx = (dir > 0) ? i : ncx - 1 - i;
+        c = cx + ncx * (cy + ncy * cz);
+
+        if(cell_area[c] == 0) continue; // Outside the ROI
+
+        val = cell_dens[c] + carry;
+        carry = 0.0;
+
+        nseeds = (int)floor(val + 0.5);
+        nseeds = iftMax(iftMin(nseeds, cell_area[c]), 0);
+        cell_seeds[c] = nseeds;
+        err = val - nseeds;
+
+        // The error is diffused only to the unvisited cells within the ROI
+        wsum = 0.0;
+        for(int j = 0; j < 4; j++)
+        {
+          int nx, ny;
+
+          nx = cx + dir * fs_dx[j]; ny = cy + fs_dy[j];
+          if(nx >= 0 && nx < ncx && ny < ncy &&
+             cell_area[nx + ncx * (ny + ncy * cz)] > 0)
+            wsum += fs_w[j];
+        }
+
+        if(wsum > 0.0)
+        {
+          for(int j = 0; j < 4; j++)
+          {
+            int nx, ny, nc;
+
+            nx = cx + dir * fs_dx[j]; ny = cy + fs_dy[j];
+            if(nx >= 0 && nx < ncx && ny < ncy)
+            {
+              nc = nx + ncx * (ny + ncy * cz);
+              if(cell_area[nc] > 0) cell_dens[nc] += err * fs_w[j] / wsum;
+            }
+          }
+        }
+        else carry = err; // Passed to the next visited cell
+      }
+    }
+
+  first[0] = 0;
+  for(int c = 0; c < ncells; c++) first[c + 1] = first[c] + cell_seeds[c];
+
+  iftFree(cell_dens);
+  iftFree(cell_area);
+
+  // 5. Seed Placement ---------------------------------------------------------
+  int nseeds;
+
+  seeds = iftCreateIntArray(first[ncells]);
+
+  #ifdef IFT_PARALLEL
+  #pragma omp parallel for schedule(dynamic, 64)
+  #endif
+  for(int c = 0; c < ncells; c++)
+  {
+    if(cell_seeds[c] > 0)
+    {
+      iftBoundingBox bb;
+
+      bb.begin.x = (c % ncx) * csize;
+      bb.begin.y = ((c / ncx) % ncy) * csize;
+      bb.begin.z = (c / (ncx * ncy)) * csize;
+      bb.end.x = iftMin(bb.begin.x + csize, objsm->xsize) - 1;
+      bb.end.y = iftMin(bb.begin.y + csize, objsm->ysize) - 1;
+      bb.end.z = iftMin(bb.begin.z + csize, objsm->zsize) - 1;
+
+      _iftODIFFPlaceCellSeeds(objsm, mask_copy, bb, cell_seeds[c], min_val,
+                              max_val, w, &(seeds->val[first[c]]));
+    }
+  }
+
+  // Remove the seeds which could not be placed
+  nseeds = 0;
+  for(int i = 0; i < seeds->n; i++)
+    if(seeds->val[i] != IFT_NIL) seeds->val[nseeds++] = seeds->val[i];
+  seeds->n = nseeds;
+
+  iftFree(cell_seeds);
+  iftFree(first);
+  if(mask == NULL) iftDestroyImage(&mask_copy);
+
+  return (seeds);
+}
+
+iftIntArray *iftODIFFSeedsByCompact
+(const iftCompactImage *objsm, const iftCompactImage *mask, int num_seeds, float obj_perc)
+{
+  iftImage *img_objsm, *img_mask;
+  iftIntArray *seeds;
+
+  if(objsm->nbands != 1 || (mask != NULL && mask->nbands != 1))
+    iftError("Only gray images are permitted!", "iftODIFFSeedsByCompact");
+  if(objsm->n < num_seeds || num_seeds < 0)
+    iftError("Invalid number of seeds!", "iftODIFFSeedsByCompact");
+  if(mask != NULL) iftVerifyCompactImageDomains(objsm, mask, "iftODIFFSeedsByCompact");
+
+  // The whole map is widened, since its value range and the sampling over
+  // the mask depend on all of it (the kernels crop only where it is exact)
+  img_objsm = iftCompactROIToImage(objsm, NULL);
+  img_mask = (mask == NULL) ? NULL : iftCompactROIToImage(mask, NULL);
+
+  seeds = iftODIFFSeeds(img_objsm, img_mask, num_seeds, obj_perc);
+
+  iftDestroyImage(&img_objsm);
+  if(img_mask != NULL) iftDestroyImage(&img_mask);
+
+  return seeds;
+}
@@ -46,7 +46,7 @@ iftSet *_iftMultiLabelGridSamplingOnMaskByArea
   #ifdef IFT_PARALLEL
   #pragma omp parallel for reduction(+:totalArea)
   #endif
-  for(int p = 0; p < newLabels->n; p++ ) if(newLabels->val[p] > 0) totalArea++;
+  for(iftIdx p = 0; p < newLabels->n; p++ ) if(newLabels->val[p] > 0) totalArea++;
   
   max_num_seeds = iftMin(totalArea, nSeeds);
   
@@ -55,6 +55,9 @@ iftSet *_iftMultiLabelGridSamplingOnMaskByArea
 
   seeds = NULL;
 
+  // The per-object temporaries are image-sized, thus they are recycled
+  iftEnableBufferPool();
+
   #ifdef IFT_PARALLEL
   #pragma omp parallel for
   #endif
@@ -67,8 +70,14 @@ iftSet *_iftMultiLabelGridSamplingOnMaskByArea
 
     objArea = 0;
 
-    objMask = iftThreshold(newLabels, i, i, 1);
-    for(int p = 0; p < objMask->n; p++ ) if(objMask->val[p] > 0) objArea++;
+    // Every pixel is written, thus the mask does not need to be zeroed
+    objMask = iftCreatePooledImage(newLabels->xsize, newLabels->ysize, 
+                                   newLabels->zsize, false);
+    for(iftIdx p = 0; p < objMask->n; p++ ) 
+    {
+      objMask->val[p] = (newLabels->val[p] == i);
+      objArea += objMask->val[p];
+    }
 
     objPerc = objArea / (float)totalArea; // How big is this object?
     amount_seeds = iftRound(max_num_seeds * objPerc);
@@ -83,7 +92,7 @@ iftSet *_iftMultiLabelGridSamplingOnMaskByArea
 
       for(int j = 0; j < sampled->n; j++) 
       {
-        if(mask->val[sampled->val[j]] != 0) 
+        if(mask == NULL || mask->val[sampled->val[j]] != 0) 
         {
           #ifdef IFT_PARALLEL
           #pragma omp critical
@@ -95,63 +104,139 @@ iftSet *_iftMultiLabelGridSamplingOnMaskByArea
       iftDestroyIntArray(&sampled);
     }
 
-    iftDestroyImage(&objMask);
+    iftDestroyPooledImage(&objMask);
   }
+
+  iftDisableBufferPool();
   
   iftDestroyImage(&newLabels);
   
   return seeds;
 }
 
+/**
+* BRIEF
+*    Compares two integers for sorting them in increasing order
+*
+* PARAMETERS
+*    a, b      - Pointers to the integers
+*
+* RETURN
+*    Negative, zero or positive value if a is, respectively, lower, equal 
+*    or greater than b
+*/
+int _iftCompareIntIncr
+(const void *a, const void *b)
+{
+  iftIdx x, y;
+
+  x = *(const iftIdx *)a;
+  y = *(const iftIdx *)b;
+
+  return (x > y) - (x < y);
+}
+
 //----------------------------------------------------------------------------//
 // PUBLIC FUNCTIONS
 //----------------------------------------------------------------------------//
 iftImage *iftOGRID
 (iftImage* objsm, iftImage *mask, int num_seeds, float obj_perc, float thr)
+{
+  iftIntArray *seeds;
+  iftImage *seed_img;
+
+  seeds = iftOGRIDSeeds(objsm, mask, num_seeds, obj_perc, thr);
+  seed_img = iftIntArrayToSeedImage(seeds, objsm->xsize, objsm->ysize, 
+                                    objsm->zsize);
+  iftDestroyIntArray(&seeds);
+
+  return seed_img;
+}
+
+iftIntArray *iftOGRIDSeeds
+(iftImage* objsm, iftImage *mask, int num_seeds, float obj_perc, float thr)
 {
   // 1. Input Validation -------------------------------------------------------
   if(objsm->n < num_seeds || num_seeds < 0) 
-    iftError("Invalid number of seeds!", "iftOGRID");
+    iftError("Invalid number of seeds!", "iftOGRIDSeeds");
   if(obj_perc < 0 || obj_perc > 1) 
-    iftError("Invalid object percentage!", "iftOGRID");
+    iftError("Invalid object percentage!", "iftOGRIDSeeds");
   if(thr < 0 || thr > 1) 
-    iftError("Invalid threshold value!", "iftOGRID");
+    iftError("Invalid threshold value!", "iftOGRIDSeeds");
   if(mask != NULL) 
-    iftVerifyImageDomains(objsm, mask, "iftOGRID");
+    iftVerifyImageDomains(objsm, mask, "iftOGRIDSeeds");
 
   // 2. Create Aux Vars --------------------------------------------------------
   int min, max;
-  iftImage *seed_img;
 
   iftMinMaxValues(objsm, &min, &max);
-  seed_img = iftCreateImage(objsm->xsize, objsm->ysize, objsm->zsize);
   
   // 3. Seed sampling ----------------------------------------------------------
   int nseeds;
-  iftSet* seeds, *S;
+  iftSet *bkg_set, *obj_set, *S;
   iftImage *bin;
 
-  seeds = NULL; S = NULL;
-
   // Background importance is the complement of the objects'
   bin = iftThreshold(objsm, min, thr*max, 1);
   nseeds = iftMax( iftRound(num_seeds * (1 - obj_perc)) , 1 ); // Always > 0
-  seeds = _iftMultiLabelGridSamplingOnMaskByArea(bin, mask, nseeds);
+  bkg_set = _iftMultiLabelGridSamplingOnMaskByArea(bin, mask, nseeds);
   iftDestroyImage(&bin);
 
-  S = seeds;  
-  while (S != NULL) { seed_img->val[S->elem] = 1; S = S->next;}
-  iftDestroySet(&seeds);
-
   bin = iftThreshold(objsm, thr*max, max, 1);
       
   nseeds = iftMax( iftRound(num_seeds * obj_perc) , 1 ); // Always > 0
-  seeds = _iftMultiLabelGridSamplingOnMaskByArea(bin, mask, nseeds);
+  obj_set = _iftMultiLabelGridSamplingOnMaskByArea(bin, mask, nseeds);
   iftDestroyImage(&bin);
 
-  S = seeds;  
-  while (S != NULL) { seed_img->val[S->elem] = 1; S = S->next;}
-  iftDestroySet(&seeds);
+  // 4. Seed gathering ---------------------------------------------------------
+  int i, j;
+  iftIntArray *seeds;
+
+  seeds = iftCreateIntArray(iftSetSize(bkg_set) + iftSetSize(obj_set));
+
+  i = 0;
+  S = bkg_set;  
+  while (S != NULL) { seeds->val[i++] = S->elem; S = S->next;}
+  iftDestroySet(&bkg_set);
+
+  S = obj_set;  
+  while (S != NULL) { seeds->val[i++] = S->elem; S = S->next;}
+  iftDestroySet(&obj_set);
+
+  // Both thresholds include thr*max, thus a pixel may be sampled twice
+  qsort(seeds->val, seeds->n, sizeof(iftIdx), _iftCompareIntIncr);
+
+  for(i = 0, j = 0; i < seeds->n; i++)
+  {
+    if(j == 0 || seeds->val[i] != seeds->val[j-1]) 
+      seeds->val[j++] = seeds->val[i];
+  }
+  seeds->n = j;
   
-  return seed_img;
-}
\ No newline at end of file
+  return seeds;
+}
+
+iftIntArray *iftOGRIDSeedsByCompact
+(const iftCompactImage *objsm, const iftCompactImage *mask, int num_seeds, float obj_perc, float thr)
+{
+  iftImage *img_objsm, *img_mask;
+  iftIntArray *seeds;
+
+  if(objsm->nbands != 1 || (mask != NULL && mask->nbands != 1))
+    iftError("Only gray images are permitted!", "iftOGRIDSeedsByCompact");
+  if(objsm->n < num_seeds || num_seeds < 0)
+    iftError("Invalid number of seeds!", "iftOGRIDSeedsByCompact");
+  if(mask != NULL) iftVerifyCompactImageDomains(objsm, mask, "iftOGRIDSeedsByCompact");
+
+  // The whole map is widened, since its value range and the sampling over
+  // the mask depend on all of it (the kernels crop only where it is exact)
+  img_objsm = iftCompactROIToImage(objsm, NULL);
+  img_mask = (mask == NULL) ? NULL : iftCompactROIToImage(mask, NULL);
+
+  seeds = iftOGRIDSeeds(img_objsm, img_mask, num_seeds, obj_perc, thr);
+
+  iftDestroyImage(&img_objsm);
+  if(img_mask != NULL) iftDestroyImage(&img_mask);
+
+  return seeds;
+}
@@ -2,6 +2,266 @@
 //----------------------------------------------------------------------------//
 // PRIVATE FUNCTIONS
 //----------------------------------------------------------------------------//
+/**
+* BRIEF
+*    Converts a YCbCr color of an iftImage into CIELAB
+*
+* DESCRIPTION 
+*    The color is converted back to RGB and then by iftRGBRowToLabNorm, so the
+*    result is the same as that of iftImageToMImage with LABNorm_CSPACE.
+*
+* PARAMETERS
+*    YCbCr    - Color in YCbCr
+*    norm_val - Normalization value of the image
+*    lab      - Output CIELAB values
+*/
+void _iftYCbCrToLabNorm
+(iftColor YCbCr, int norm_val, float *lab)
+{
+  uchar row[6];
+  iftColor RGB;
+
+  RGB = iftYCbCrtoRGB(YCbCr, norm_val);
+
+  for (int c = 0; c < 3; c++)
+  {
+    if (norm_val > 255)
+    { row[2 * c] = RGB.val[c] >> 8; row[2 * c + 1] = RGB.val[c] & 255; }
+    else row[c] = RGB.val[c];
+  }
+
+  iftRGBRowToLabNorm(row, 1, 3, norm_val > 255, norm_val, lab);
+}
+
+/**
+* BRIEF
+*    Converts a box of the image into CIELAB (or gray) features
+*
+* DESCRIPTION 
+*    This function is the same as iftImageToMImage with LABNorm_CSPACE (or
+*    GRAY_CSPACE) followed by the extraction of the box, but the 
+*    normalization value and the maximum feature value are taken over the 
+*    whole image. Hence, cropping the image to a ROI changes neither the
+*    features nor the scale of the saliency band.
+*
+* PARAMETERS
+*    img      - Input image
+*    bb       - Box within the image
+*    max_val  - Output maximum feature value over the whole image
+*
+* RETURN
+*    Multiband image of the box
+*/
+iftMImage *_iftImageBoxToMImage
+(const iftImage *img, iftBoundingBox bb, float *max_val)
+{
+  int nrows, norm_val;
+  float max_lab_val;
+  uchar *seen;
+  iftMImage *mimg;
+
+  mimg = iftCreateMImage(bb.end.x - bb.begin.x + 1, bb.end.y - bb.begin.y + 1,
+                         bb.end.z - bb.begin.z + 1, iftIsColorImage(img) ? 3 : 1);
+  mimg->dx = img->dx;
+  mimg->dy = img->dy;
+  mimg->dz = img->dz;
+
+  nrows = img->ysize * img->zsize;
+  norm_val = iftNormalizationValue(iftMaximumValue(img));
+  max_lab_val = IFT_INFINITY_FLT_NEG;
+
+  // Outside the box, only the maximum matters. For 8-bit colors, it is taken
+  // over the distinct colors, each one converted once.
+  seen = NULL;
+  if (iftIsColorImage(img) && norm_val == 255 && mimg->n < img->n)
+  {
+    seen = iftAllocUCharArray(1 << 24);
+
+    for (int r = 0; r < nrows; r++)
+    {
+      int y, z;
+      iftIdx p;
+
+      y = r % img->ysize;
+      z = r / img->ysize;
+      p = (iftIdx)r * img->xsize;
+
+      for (int x = 0; x < img->xsize; x++, p++)
+        if (y < bb.begin.y || y > bb.end.y || z < bb.begin.z || 
+            z > bb.end.z || x < bb.begin.x || x > bb.end.x)
+          seen[(img->val[p] << 16) | (img->Cb[p] << 8) | img->Cr[p]] = 1;
+    }
+  }
+
+  #ifdef IFT_PARALLEL
+  #pragma omp parallel for schedule(static) reduction(max:max_lab_val)
+  #endif
+  for (int r = 0; r < nrows; r++)
+  {
+    int y, z;
+    iftIdx p, q;
+    bool in_box;
+
+    y = r % img->ysize;
+    z = r / img->ysize;
+    in_box = (y >= bb.begin.y && y <= bb.end.y && z >= bb.begin.z && 
+              z <= bb.end.z);
+    q = ((iftIdx)(z - bb.begin.z) * mimg->ysize + y - bb.begin.y) * 
+        mimg->xsize - bb.begin.x;
+    p = (iftIdx)r * img->xsize;
+
+    for (int x = 0; x < img->xsize; x++, p++)
+    {
+      float val[3];
+      int m;
+      bool in_box_x;
+
+      in_box_x = in_box && x >= bb.begin.x && x <= bb.end.x;
+      if (seen != NULL && !in_box_x) continue;
+
+      if (iftIsColorImage(img))
+      {
+        iftColor YCbCr;
+
+        YCbCr.val[0] = img->val[p];
+        YCbCr.val[1] = img->Cb[p];
+        YCbCr.val[2] = img->Cr[p];
+        _iftYCbCrToLabNorm(YCbCr, norm_val, val);
+        m = 3;
+      }
+      else { val[0] = img->val[p]; m = 1; }
+
+      // As iftMMaximumValue, over the whole image
+      for (int b = 0; b < m; b++) max_lab_val = iftMax(max_lab_val, val[b]);
+
+      if (in_box_x)
+        for (int b = 0; b < m; b++) mimg->val[q + x][b] = val[b];
+    }
+  }
+
+  if (seen != NULL)
+  {
+    #ifdef IFT_PARALLEL
+    #pragma omp parallel for schedule(static) reduction(max:max_lab_val)
+    #endif
+    for (int c = 0; c < (1 << 24); c++)
+    {
+      if (seen[c])
+      {
+        iftColor YCbCr;
+        float lab[3];
+
+        YCbCr.val[0] = c >> 16;
+        YCbCr.val[1] = (c >> 8) & 255;
+        YCbCr.val[2] = c & 255;
+        _iftYCbCrToLabNorm(YCbCr, norm_val, lab);
+        for (int b = 0; b < 3; b++) max_lab_val = iftMax(max_lab_val, lab[b]);
+      }
+    }
+
+    iftFree(seen);
+  }
+
+  *max_val = max_lab_val;
+
+  return mimg;
+}
+
+/**
+* BRIEF
+*    Gets the saliency row of a ROI row from either an integer or a float map
+*
+* PARAMETERS
+*    objsm    - Object saliency map (used if the others are NULL)
+*    fobjsm   - Float object saliency map (can be set to NULL)
+*    cobjsm   - Compact object saliency map (can be set to NULL)
+*    begin    - First voxel of the ROI within the saliency map
+*    y        - Row of the ROI
+*    z        - Slice of the ROI
+*    xsize    - Width of the ROI
+*    sal      - Output array of the row's saliency values
+*/
+void _iftSalRow
+(const iftImage *objsm, const iftFImage *fobjsm, const iftCompactImage *cobjsm,
+ iftVoxel begin, int y, int z, int xsize, float *sal)
+{
+  iftIdx q;
+
+  if (fobjsm != NULL)
+  {
+    q = fobjsm->tbz[begin.z + z] + fobjsm->tby[begin.y + y] + begin.x;
+    for (int x = 0; x < xsize; x++) sal[x] = fobjsm->val[q + x];
+  }
+  else if (cobjsm != NULL)
+  {
+    q = ((iftIdx)(begin.z + z) * cobjsm->ysize + begin.y + y) * cobjsm->xsize 
+        + begin.x;
+    for (int x = 0; x < xsize; x++) sal[x] = iftCompactSample(cobjsm, q + x);
+  }
+  else
+  {
+    q = objsm->tbz[begin.z + z] + objsm->tby[begin.y + y] + begin.x;
+    for (int x = 0; x < xsize; x++) sal[x] = objsm->val[q + x];
+  }
+}
+
+/**
+* BRIEF
+*    Gets the range of either an integer, a float or a compact saliency map
+*
+* PARAMETERS
+*    objsm    - Object saliency map (used if the others are NULL)
+*    fobjsm   - Float object saliency map (can be set to NULL)
+*    cobjsm   - Compact object saliency map (can be set to NULL)
+*    min      - Output minimum saliency
+*    max      - Output maximum saliency
+*/
+void _iftSalRange
+(const iftImage *objsm, const iftFImage *fobjsm, const iftCompactImage *cobjsm,
+ float *min, float *max)
+{
+  float min_val, max_val;
+
+  min_val = IFT_INFINITY_FLT;
+  max_val = IFT_INFINITY_FLT_NEG;
+
+  if (fobjsm != NULL)
+  {
+    #ifdef IFT_PARALLEL
+    #pragma omp parallel for reduction(min:min_val) reduction(max:max_val)
+    #endif
+    for (iftIdx p = 0; p < fobjsm->n; p++)
+    {
+      if (fobjsm->val[p] < min_val) min_val = fobjsm->val[p];
+      if (fobjsm->val[p] > max_val) max_val = fobjsm->val[p];
+    }
+  }
+  else if (cobjsm != NULL)
+  {
+    #ifdef IFT_PARALLEL
+    #pragma omp parallel for reduction(min:min_val) reduction(max:max_val)
+    #endif
+    for (iftIdx p = 0; p < cobjsm->n; p++)
+    {
+      float val = iftCompactSample(cobjsm, p);
+
+      if (val < min_val) min_val = val;
+      if (val > max_val) max_val = val;
+    }
+  }
+  else
+  {
+    int min_int, max_int;
+
+    iftMinMaxValues(objsm, &min_int, &max_int);
+    min_val = min_int;
+    max_val = max_int;
+  }
+
+  *min = min_val;
+  *max = max_val;
+}
+
 /**
 * BRIEF
 *    Adds a new band for the object saliency map values into the MImage
@@ -10,140 +270,617 @@
 *    This function creates a new MImage by copying the LAB and saliency values
 *    in the following order: [0..2] - CIELAB; and [3] - Normalized Saliency.
 *    The idea of normalizing the saliency values is to avoid feature domination
-*    during the OISF execution.
+*    during the OISF execution. The saliency map is given in the original
+*    domain, and the MImage is its box starting at the given voxel, so the map
+*    is never cropped. Either an integer or a float map must be given. The
+*    saliency range is taken over the whole map, and the maximum CIELAB value
+*    is given, since both are taken over the whole image even when the MImage
+*    is a crop of it.
 *
 * PARAMETERS
-*    mimg     - Multiband image
-*    objsm    - Object saliency map
+*    mimg        - Multiband image (of the ROI)
+*    objsm       - Object saliency map (can be set to NULL, if fobjsm is given)
+*    fobjsm      - Float object saliency map (can be set to NULL)
+*    begin       - First voxel of the ROI within the saliency map
+*    max_lab_val - Maximum CIELAB value of the image
 *
 * RETURN
 *    Multiband image composed of CIELAB and normalized saliency bands
 */
 iftMImage *_iftExtendMImageByObjSalMap
-(iftMImage *mimg, iftImage* objsm )
+(iftMImage *mimg, const iftImage *objsm, const iftFImage *fobjsm, 
+ iftVoxel begin, float max_lab_val)
 {
-  int p,b, min_sm_val, max_sm_val;
-  float max_lab_val;
+  int nrows;
+  float min_sm_val, max_sm_val;
   iftMImage *emimg;
 
   emimg = iftCreateMImage(mimg->xsize, mimg->ysize, mimg->zsize, mimg->m+1);
-  max_lab_val = iftMMaximumValue(mimg, -1);
-  iftMinMaxValues(objsm, &min_sm_val, &max_sm_val);
-  
-  for (p = 0; p < mimg->n; p++)  {
-    
-    for(b = 0; b < mimg->m; b++ )  emimg->val[p][b] = mimg->val[p][b];
+  nrows = mimg->ysize * mimg->zsize;
 
-    // Normalize for avoiding feature domination
-    emimg->val[p][mimg->m] = max_lab_val * ((objsm->val[p] - min_sm_val)/((float)(max_sm_val - min_sm_val)));
+  _iftSalRange(objsm, fobjsm, NULL, &min_sm_val, &max_sm_val);
+
+  #ifdef IFT_PARALLEL
+  #pragma omp parallel
+  #endif
+  {
+    float *sal;
+
+    sal = iftAllocFloatArray(mimg->xsize);
+
+    #ifdef IFT_PARALLEL
+    #pragma omp for schedule(static)
+    #endif
+    for (int r = 0; r < nrows; r++)  {
+      iftIdx p = (iftIdx)r * mimg->xsize;
+
+      _iftSalRow(objsm, fobjsm, NULL, begin, r % mimg->ysize, r / mimg->ysize,
+                 mimg->xsize, sal);
+
+      for (int x = 0; x < mimg->xsize; x++, p++) {
+        for(int b = 0; b < mimg->m; b++ )  emimg->val[p][b] = mimg->val[p][b];
+
+        // Normalize for avoiding feature domination (a flat map carries no 
+        // saliency)
+        if(max_sm_val > min_sm_val)
+          emimg->val[p][mimg->m] = max_lab_val * ((sal[x] - min_sm_val)/(max_sm_val - min_sm_val));
+        else emimg->val[p][mimg->m] = 0.0;
+      }
+    }
+
+    iftFree(sal);
   }
 
   return emimg;
 }
 
+/**
+* BRIEF
+*    Compares two voxel indexes for sorting them in decreasing order
+*
+* PARAMETERS
+*    a, b      - Pointers to the indexes
+*
+* RETURN
+*    Negative, zero or positive value if a is, respectively, greater, equal 
+*    or lower than b
+*/
+int _iftCompareIdxDecr
+(const void *a, const void *b)
+{
+  iftIdx x, y;
+
+  x = *(const iftIdx *)a;
+  y = *(const iftIdx *)b;
+
+  return (x < y) - (x > y);
+}
+
+/**
+* BRIEF
+*    Builds the OISF image graph from the features within the ROI
+*
+* DESCRIPTION 
+*    This function extends the (already cropped, if so) multiband image by the
+*    normalized saliency band and creates the implicit graph of the ROI. The
+*    maximum CIELAB value is given, since it is taken over the whole image. 
+*    When the inputs were cropped, the graph's frame is set to the bounding 
+*    box within the original domain.
+*
+* PARAMETERS
+*    mimg        - CIELAB (or gray) multiband image of the ROI
+*    roi_mask    - Mask of the ROI (can be set to NULL)
+*    objsm       - Object saliency map in the original domain (can be set to 
+*                  NULL, if fobjsm is given)
+*    fobjsm      - Float object saliency map in the original domain (can be 
+*                  set to NULL)
+*    max_lab_val - Maximum CIELAB (or gray) value of the whole image
+*    crop        - Whether the inputs were cropped to bb
+*    bb          - Bounding box of the ROI in the original domain
+*    xsize       - Original domain's width
+*    ysize       - Original domain's height
+*    zsize       - Original domain's depth
+*
+* RETURN
+*    Image graph with normalized features
+*/
+iftIGraph *_iftBuildOISFIGraph
+(iftMImage *mimg, iftImage *roi_mask, const iftImage *objsm, 
+ const iftFImage *fobjsm, float max_lab_val, bool crop, iftBoundingBox bb, 
+ int xsize, int ysize, int zsize)
+{
+  iftVoxel begin;
+  iftMImage *obj_mimg;
+  iftAdjRel *A;
+  iftIGraph *igraph;
+
+  A = iftCircular(1.0);
+
+  if (crop) begin = bb.begin;
+  else begin.x = begin.y = begin.z = 0;
+
+  obj_mimg = _iftExtendMImageByObjSalMap(mimg, objsm, fobjsm, begin, 
+                                         max_lab_val);
+
+  if (roi_mask == NULL)
+  {
+    roi_mask = iftSelectImageDomain(xsize, ysize, zsize);
+    igraph = iftImplicitIGraph(obj_mimg, roi_mask, A);
+    iftDestroyImage(&roi_mask);
+  }
+  else igraph = iftImplicitIGraph(obj_mimg, roi_mask, A);
+
+  if (crop) iftIGraphSetFrame(igraph, bb.begin, xsize, ysize, zsize);
+
+  iftDestroyMImage(&obj_mimg);
+  iftDestroyAdjRel(&A);
+
+  return igraph;
+}
+
+/**
+* BRIEF
+*    Creates the OISF image graph from precomputed features and either an
+*    integer or a float saliency map
+*
+* DESCRIPTION 
+*    When a mask is given, only its bounding box is copied from the features,
+*    whereas the saliency map is read in place. The normalization values are
+*    taken over the whole image, as in iftInitOISFIGraph.
+*
+* PARAMETERS
+*    mimg      - CIELAB (or gray) multiband image
+*    mask      - ROI image (can be set to NULL)
+*    objsm     - Object saliency map (can be set to NULL, if fobjsm is given)
+*    fobjsm    - Float object saliency map (can be set to NULL)
+*
+* RETURN
+*    Image graph with normalized features
+*/
+iftIGraph *_iftInitOISFIGraphBySal
+(iftMImage *mimg, iftImage *mask, const iftImage *objsm, const iftFImage *fobjsm)
+{
+  bool crop;
+  iftBoundingBox bb;
+  iftImage *roi_mask;
+  iftMImage *roi_mimg;
+  iftIGraph *igraph;
+
+  // Everything but the mask is computed within its bounding box
+  crop = (mask != NULL && iftMaskROIBoundingBox(mask, &bb));
+
+  if (crop)
+  {
+    roi_mimg  = iftMExtractROI(mimg, bb);
+    roi_mask  = iftExtractROI(mask, bb);
+  }
+  else { roi_mimg = mimg; roi_mask = mask; }
+
+  igraph = _iftBuildOISFIGraph(roi_mimg, roi_mask, objsm, fobjsm, 
+                               iftMMaximumValue(mimg, -1), crop, bb, 
+                               mimg->xsize, mimg->ysize, mimg->zsize);
+
+  if (crop)
+  {
+    iftDestroyMImage(&roi_mimg);
+    iftDestroyImage(&roi_mask);
+  }
+
+  return igraph;
+}
+
+/**
+* BRIEF
+*    Builds the OISF image graph while decoding the image
+*
+* DESCRIPTION 
+*    This function is the fused counterpart of _iftBuildOISFIGraph: each row
+*    of the ROI is decoded, converted to CIELAB (or gray) and written,
+*    together with its normalized saliency, straight into the attributes of
+*    its nodes. The rows outside the ROI are decoded as well, since the 
+*    saliency band is scaled by the maximum CIELAB value of the whole image.
+*    Thus, the saliency band is first kept in [0,1], and scaled by a last 
+*    pass over that attribute alone. Hence, the image and the features are
+*    never held as a whole, but in the graph.
+*
+* PARAMETERS
+*    reader    - Row reader of the image, whose first row is unread
+*    roi_mask  - Mask of the ROI, within bb
+*    crop      - Whether the ROI is a crop of the image
+*    bb        - Bounding box of the ROI (the whole image, if not cropped)
+*    objsm     - Object saliency map (used if the others are NULL)
+*    fobjsm    - Float object saliency map (can be set to NULL)
+*    cobjsm    - Compact object saliency map (can be set to NULL)
+*
+* RETURN
+*    Image graph with normalized features
+*/
+iftIGraph *_iftStreamOISFIGraph
+(iftLabRowReader *reader, const iftImage *roi_mask, bool crop, 
+ iftBoundingBox bb, const iftImage *objsm, const iftFImage *fobjsm, 
+ const iftCompactImage *cobjsm)
+{
+  int nb;
+  float min_sm_val, max_sm_val, max_lab_val, *lab, *sal;
+  iftAdjRel *A;
+  iftIGraph *igraph;
+
+  // 1. Graph Nodes ------------------------------------------------------------
+  nb = reader->nbands;
+  igraph = iftCreateIGraph(roi_mask, nb + 1);
+  igraph->index->dz = 0.0;
+
+  _iftSalRange(objsm, fobjsm, cobjsm, &min_sm_val, &max_sm_val);
+
+  // 2. Row Streaming ----------------------------------------------------------
+  lab = iftAllocFloatArray((long)reader->xsize * nb);
+  sal = iftAllocFloatArray(roi_mask->xsize);
+  max_lab_val = IFT_INFINITY_FLT_NEG;
+
+  while (reader->y < reader->ysize)
+  {
+    const float *roi_lab;
+    iftIdx q;
+    int y;
+
+    y = reader->y - bb.begin.y;
+    iftReadLabRow(reader, lab);
+
+    // As iftMMaximumValue, over the whole image
+    for (int i = 0; i < reader->xsize * nb; i++)
+      if (lab[i] > max_lab_val) max_lab_val = lab[i];
+
+    if (y < 0 || y >= roi_mask->ysize) continue;
+
+    _iftSalRow(objsm, fobjsm, cobjsm, bb.begin, y, 0, roi_mask->xsize, sal);
+
+    roi_lab = lab + (long)bb.begin.x * nb;
+    q = roi_mask->tby[y];
+
+    for (int x = 0; x < roi_mask->xsize; x++)
+    {
+      iftIdx s = igraph->nindex[q + x];
+
+      if (s == IFT_NIL) continue;
+
+      for (int b = 0; b < nb; b++) igraph->feat[s][b] = roi_lab[x * nb + b];
+
+      if (max_sm_val > min_sm_val)
+        igraph->feat[s][nb] = (sal[x] - min_sm_val)/(max_sm_val - min_sm_val);
+      else igraph->feat[s][nb] = 0.0;
+    }
+  }
+
+  // 3. Saliency Scaling -------------------------------------------------------
+  #ifdef IFT_PARALLEL
+  #pragma omp parallel for schedule(static)
+  #endif
+  for (iftIdx s = 0; s < igraph->nnodes; s++)
+    igraph->feat[s][nb] = max_lab_val * igraph->feat[s][nb];
+
+  A = iftCircular(1.0);
+  igraph->A = iftCopyAdjacency(A);
+  igraph->type = IMPLICIT;
+
+  if (crop) 
+    iftIGraphSetFrame(igraph, bb.begin, reader->xsize, reader->ysize, 1);
+
+  iftFree(lab);
+  iftFree(sal);
+  iftDestroyAdjRel(&A);
+
+  return igraph;
+}
+
+/**
+* BRIEF
+*    Creates the OISF image graph from an image file and either an integer or
+*    a float saliency map
+*
+* DESCRIPTION 
+*    The graph is built while decoding the file, unless its format is left
+*    to the generic path of iftReadLabMImageByExt.
+*
+* PARAMETERS
+*    filename  - Path to the image
+*    mask      - ROI image (can be set to NULL)
+*    objsm     - Object saliency map (can be set to NULL, if fobjsm is given)
+*    fobjsm    - Float object saliency map (can be set to NULL)
+*    function  - Name of the calling function, for the error messages
+*
+* RETURN
+*    Image graph with normalized features
+*/
+iftIGraph *_iftInitOISFIGraphByFile
+(const char *filename, iftImage *mask, const iftImage *objsm, 
+ const iftFImage *fobjsm, const char *function)
+{
+  bool crop;
+  int xsize, ysize, zsize;
+  iftBoundingBox bb;
+  iftImage *roi_mask;
+  iftLabRowReader *reader;
+  iftMImage *mimg;
+  iftIGraph *igraph;
+
+  if (fobjsm != NULL) 
+  { xsize = fobjsm->xsize; ysize = fobjsm->ysize; zsize = fobjsm->zsize; }
+  else { xsize = objsm->xsize; ysize = objsm->ysize; zsize = objsm->zsize; }
+
+  if (mask != NULL && (mask->xsize != xsize || mask->ysize != ysize || 
+                       mask->zsize != zsize))
+    iftError("The mask and the saliency map have different domains", function);
+
+  reader = iftOpenLabRowReader(filename);
+
+  if (reader != NULL)
+  {
+    if (reader->xsize != xsize || reader->ysize != ysize || zsize != 1)
+      iftError("The image and the saliency map have different domains", 
+               function);
+
+    crop = (mask != NULL && iftMaskROIBoundingBox(mask, &bb));
+
+    if (crop) roi_mask = iftExtractROI(mask, bb);
+    else
+    {
+      bb.begin.x = bb.begin.y = bb.begin.z = 0;
+      bb.end.x = xsize - 1; bb.end.y = ysize - 1; bb.end.z = 0;
+      if (mask != NULL) roi_mask = iftCopyImage(mask); // e.g., an empty mask
+      else roi_mask = iftSelectImageDomain(xsize, ysize, 1);
+    }
+
+    igraph = _iftStreamOISFIGraph(reader, roi_mask, crop, bb, objsm, fobjsm, 
+                                  NULL);
+    iftDestroyImage(&roi_mask);
+    iftCloseLabRowReader(&reader);
+  }
+  else
+  {
+    mimg = iftReadLabMImageByExt(filename);
+
+    if (mimg->xsize != xsize || mimg->ysize != ysize || mimg->zsize != zsize)
+      iftError("The image and the saliency map have different domains", 
+               function);
+
+    igraph = _iftInitOISFIGraphBySal(mimg, mask, objsm, fobjsm);
+    iftDestroyMImage(&mimg);
+  }
+
+  return igraph;
+}
+
 //----------------------------------------------------------------------------//
 // PUBLIC FUNCTIONS
 //----------------------------------------------------------------------------//
 iftIGraph *iftInitOISFIGraph
 (iftImage *img, iftImage *mask, iftImage *objsm)
 {
-  iftMImage *mimg, *obj_mimg;
-  iftAdjRel *A;
+  bool crop;
+  float max_lab_val;
+  iftBoundingBox bb;
+  iftImage *roi_mask;
+  iftMImage *mimg;
   iftIGraph *igraph;
 
-  A = iftCircular(1.0);
+  // Everything but the mask is computed within its bounding box, whereas
+  // the normalization values are taken over the whole image, so that
+  // cropping does not change the result
+  crop = (mask != NULL && iftMaskROIBoundingBox(mask, &bb));
 
-  if (iftIsColorImage(img)) mimg   = iftImageToMImage(img,LABNorm_CSPACE);
-  else mimg   = iftImageToMImage(img,GRAY_CSPACE);
+  if (crop)
+  {
+    roi_mask  = iftExtractROI(mask, bb);
+  }
+  else 
+  { 
+    bb.begin.x = bb.begin.y = bb.begin.z = 0;
+    bb.end.x = img->xsize - 1; bb.end.y = img->ysize - 1; 
+    bb.end.z = img->zsize - 1;
+    roi_mask = mask;
+  }
 
-  obj_mimg = _iftExtendMImageByObjSalMap(mimg, objsm);
+  mimg = _iftImageBoxToMImage(img, bb, &max_lab_val);
 
-  igraph = iftImplicitIGraph(obj_mimg, mask, A);
+  igraph = _iftBuildOISFIGraph(mimg, roi_mask, objsm, NULL, max_lab_val, crop,
+                               bb, img->xsize, img->ysize, img->zsize);
+
+  if (crop)
+  {
+    iftDestroyImage(&roi_mask);
+  }
 
   //Free
   iftDestroyMImage(&mimg);
-  iftDestroyMImage(&obj_mimg);
-  iftDestroyAdjRel(&A);
+
+  return igraph;
+}
+
+iftIGraph *iftInitOISFIGraphByMImage
+(iftMImage *mimg, iftImage *mask, iftImage *objsm)
+{
+  if (mimg->xsize != objsm->xsize || mimg->ysize != objsm->ysize ||
+      mimg->zsize != objsm->zsize)
+    iftError("The features and the saliency map have different domains", 
+             "iftInitOISFIGraphByMImage");
+
+  return _iftInitOISFIGraphBySal(mimg, mask, objsm, NULL);
+}
+
+iftIGraph *iftInitOISFIGraphByFloatSal
+(iftMImage *mimg, iftImage *mask, iftFImage *objsm)
+{
+  if (mimg->xsize != objsm->xsize || mimg->ysize != objsm->ysize ||
+      mimg->zsize != objsm->zsize)
+    iftError("The features and the saliency map have different domains", 
+             "iftInitOISFIGraphByFloatSal");
+
+  return _iftInitOISFIGraphBySal(mimg, mask, NULL, objsm);
+}
+
+iftIGraph *iftInitOISFIGraphByFile
+(const char *filename, iftImage *mask, iftImage *objsm)
+{
+  return _iftInitOISFIGraphByFile(filename, mask, objsm, NULL, 
+                                  "iftInitOISFIGraphByFile");
+}
+
+iftIGraph *iftInitOISFIGraphByFileFloatSal
+(const char *filename, iftImage *mask, iftFImage *objsm)
+{
+  return _iftInitOISFIGraphByFile(filename, mask, NULL, objsm, 
+                                  "iftInitOISFIGraphByFileFloatSal");
+}
+
+iftIGraph *iftInitOISFIGraphByBuffer
+(const uchar *rgb, int xsize, int ysize, int nchannels, long stride,
+ const iftCompactImage *mask, const iftCompactImage *objsm)
+{
+  bool crop;
+  iftBoundingBox bb;
+  iftImage *roi_mask;
+  iftLabRowReader *reader;
+  iftIGraph *igraph;
+
+  if (objsm->nbands != 1 || objsm->xsize != xsize || objsm->ysize != ysize || 
+      objsm->zsize != 1)
+    iftError("The saliency map must be a gray image of the buffer's domain", 
+             "iftInitOISFIGraphByBuffer");
+  if (mask != NULL) 
+    iftVerifyCompactImageDomains(mask, objsm, "iftInitOISFIGraphByBuffer");
+
+  // Only the mask's bounding box is widened to the graph's index
+  crop = (mask != NULL && iftCompactMaskROIBoundingBox(mask, &bb));
+
+  if (crop) roi_mask = iftCompactROIToImage(mask, &bb);
+  else
+  {
+    bb.begin.x = bb.begin.y = bb.begin.z = 0;
+    bb.end.x = xsize - 1; bb.end.y = ysize - 1; bb.end.z = 0;
+    if (mask != NULL) roi_mask = iftCompactROIToImage(mask, NULL);
+    else roi_mask = iftSelectImageDomain(xsize, ysize, 1);
+  }
+
+  reader = iftOpenLabRowReaderByBuffer(rgb, xsize, ysize, nchannels, stride);
+  igraph = _iftStreamOISFIGraph(reader, roi_mask, crop, bb, NULL, NULL, objsm);
+
+  iftCloseLabRowReader(&reader);
+  iftDestroyImage(&roi_mask);
 
   return igraph;
 }
 
 void iftOISF
 (iftIGraph *igraph, iftImage *seeds, double alpha, double beta, double gamma, int iters)
+{
+  iftIntArray *seed_arr;
+
+  if (seeds->xsize != igraph->frame.xsize || seeds->ysize != igraph->frame.ysize ||
+      seeds->zsize != igraph->frame.zsize)
+    iftError("The seed image and the graph's frame have different domains", 
+             "iftOISF");
+
+  seed_arr = iftSeedImageToIntArray(seeds);
+
+  iftOISFSeeds(igraph, seed_arr, alpha, beta, gamma, iters);
+
+  iftDestroyIntArray(&seed_arr);
+}
+
+void iftOISFSeeds
+(iftIGraph *igraph, const iftIntArray *seeds, double alpha, double beta, double gamma, int iters)
 {
   double tmp;
-  int r, s, t, i, p, q, it, nseeds;
-  int *seed, *center;
+  iftIdx p, q, r, s, t, i, nseeds;
+  int it;
+  iftIdx *seed, *center;
+  iftIdx *order;
   float max_objsm_val;
   double color_dist, geo_dist, obj_dist;
   iftVoxel u, v;
   iftDHeap *Q;
   double *pvalue;
-  iftSet *S, *new_seeds, *frontier_nodes, *trees_rm;
+  iftStack *new_seeds, *frontier_nodes, *trees_rm;
 
   nseeds = 0;
   max_objsm_val = iftIGraphMaximumFeatureValue(igraph, igraph->nfeats-1);
+  if (max_objsm_val <= 0.0) max_objsm_val = 1.0; // No saliency within the ROI
   
-  S = NULL;
-  new_seeds = NULL;
-  frontier_nodes = NULL;
-  trees_rm = NULL;
+  new_seeds = iftCreateStack(seeds->n);
+  frontier_nodes = iftCreateStack(seeds->n);
+  trees_rm = iftCreateStack(seeds->n);
 
-  pvalue = iftAllocDoubleArray(igraph->nnodes);
+  pvalue = (double *)iftAllocFirstTouch(igraph->nnodes, sizeof(double));
   Q = iftCreateDHeap(igraph->nnodes, pvalue);
 
+  #ifdef IFT_PARALLEL
+  #pragma omp parallel for schedule(static)
+  #endif
   for (s=0; s < igraph->nnodes; s++) 
   {
-      p               = igraph->node[s].voxel;
       pvalue[s]       = IFT_INFINITY_DBL;
-      igraph->pvalue[p] = IFT_INFINITY_DBL;
-      igraph->pred[p] = IFT_NIL;
-      
-      if (seeds->val[p]!=0)
+      igraph->pvalue[s] = IFT_INFINITY_DBL;
+      igraph->pred[s] = IFT_NIL;
+  }
+
+  // Only the seeds within the ROI are considered, and they are labeled in
+  // reverse raster order (as the seed set of the original implementation)
+  seed = iftAllocIdxArray(seeds->n);
+  order = iftAllocIdxArray(seeds->n);
+
+  for (i = 0; i < seeds->n; i++)
+  {
+      p = seeds->val[i];
+
+      if (p < 0 || p >= (iftIdx)igraph->frame.xsize * igraph->frame.ysize * igraph->frame.zsize)
+        iftError("Seed index %ld is outside the image domain", "iftOISFSeeds", (long)p);
+
+      order[i] = p;
+  }
+
+  qsort(order, seeds->n, sizeof(iftIdx), _iftCompareIdxDecr);
+
+  for (i = 0; i < seeds->n; i++)
+  {
+      s = iftIGraphFrameVoxelToNode(igraph, order[i]);
+
+      if (s != IFT_NIL)
       {
-          iftInsertSet(&new_seeds,s);
+          seed[nseeds] = s;
+          igraph->label[s] = nseeds+1;
           nseeds++;
       }
   }
 
-  seed = iftAllocIntArray(nseeds);
-  S = new_seeds; 
-  i = 0;
+  iftFree(order);
 
-  while (S != NULL) 
-  {
-      seed[i] = S->elem;
-      p       = igraph->node[seed[i]].voxel;
-      igraph->label[p] = i+1;
-      i++; 
-      S = S->next;
-  }
+  // The first seed is the first to be conquered
+  for (i = nseeds-1; i >= 0; i--) iftPushStack(new_seeds, seed[i]);
   
   for (it=0; it < iters; it++) 
   {
-    if (trees_rm != NULL)
+    if (!iftEmptyStack(trees_rm))
     { 
-      frontier_nodes = iftIGraphTreeRemoval(igraph, &trees_rm, pvalue, IFT_INFINITY_DBL);
+      iftIGraphTreeRemoval(igraph, trees_rm, pvalue, IFT_INFINITY_DBL, frontier_nodes);
     }
 
-    while (new_seeds != NULL) 
+    while (!iftEmptyStack(new_seeds)) 
     {
-      s = iftRemoveSet(&new_seeds);
-      p = igraph->node[s].voxel;  
+      s = iftPopStack(new_seeds);
 
-      if (igraph->label[p] > 0)
+      if (igraph->label[s] > 0)
       { 
         pvalue[s] = 0;
-        igraph->pvalue[p] = 0;
-        igraph->root[p] = p;
-        igraph->pred[p] = IFT_NIL;
+        igraph->pvalue[s] = 0;
+        igraph->root[s] = s;
+        igraph->pred[s] = IFT_NIL;
         iftInsertDHeap(Q,s);
       }
     }
 
-    while (frontier_nodes != NULL) 
+    while (!iftEmptyStack(frontier_nodes)) 
     {
-      s = iftRemoveSet(&frontier_nodes);
+      s = iftPopStack(frontier_nodes);
       
       if (Q->color[s] == IFT_WHITE) iftInsertDHeap(Q,s);
     } 
@@ -152,8 +889,8 @@ void iftOISF
     {
       s = iftRemoveDHeap(Q);
       p = igraph->node[s].voxel;
-      r = igraph->root[p];
-      igraph->pvalue[p] = pvalue[s];
+      r = igraph->root[s];
+      igraph->pvalue[s] = pvalue[s];
       u = iftGetVoxelCoord(igraph->index,p);
 
       for (i=1; i < igraph->A->n; i++) 
@@ -162,14 +899,14 @@ void iftOISF
         if (iftValidVoxel(igraph->index,v))
         {
           q   = iftGetVoxelIndex(igraph->index,v);
-          t   = igraph->index->val[q];
+          t   = igraph->nindex[q];
           if ((t != IFT_NIL) && (Q->color[t] != IFT_BLACK))
           {
             tmp = 0.0;
             
-            color_dist = (double)iftFeatDistance(igraph->feat[r], igraph->feat[q], igraph->nfeats-1);
+            color_dist = (double)iftIGraphFeatDistance(igraph, r, t, igraph->nfeats-1);
             geo_dist = (double)iftVoxelDistance(u,v);
-            obj_dist = (double)(abs((igraph->feat[r][igraph->nfeats-1] - igraph->feat[q][igraph->nfeats-1]))/max_objsm_val              );          
+            obj_dist = (double)(abs((iftIGraphFeat(igraph, r, igraph->nfeats-1) - iftIGraphFeat(igraph, t, igraph->nfeats-1)))/max_objsm_val              );          
             
             tmp = pow( alpha*color_dist*pow(gamma, obj_dist) +gamma*obj_dist, beta);
             tmp += geo_dist;
@@ -179,21 +916,21 @@ void iftOISF
             {
               pvalue[t]            = tmp;
 
-              igraph->root[q]      = igraph->root[p];
-              igraph->label[q]     = igraph->label[p];
-              igraph->pred[q]      = p;
+              igraph->root[t]      = igraph->root[s];
+              igraph->label[t]     = igraph->label[s];
+              igraph->pred[t]      = s;
 
               if (Q->color[t] == IFT_GRAY) iftGoUpDHeap(Q, Q->pos[t]);
               else iftInsertDHeap(Q,t);
             } 
             else 
             {
-              if (igraph->pred[q] == p)
+              if (igraph->pred[t] == s)
               {
                 if (tmp > pvalue[t]) iftIGraphSubTreeRemoval(igraph,t,pvalue,IFT_INFINITY_DBL,Q);
                 else 
                 {
-                  if ((igraph->label[q] != igraph->label[p])&&(igraph->label[q]!=0))
+                  if ((igraph->label[t] != igraph->label[s])&&(igraph->label[t]!=0))
                   {
                     iftIGraphSubTreeRemoval(igraph,t,pvalue,IFT_INFINITY_DBL,Q);
                   }
@@ -213,15 +950,15 @@ void iftOISF
       center = NULL;
       center = iftIGraphSuperpixelCenters(igraph, seed, nseeds);
 
-      iftIGraphEvalAndAssignNewSeeds(igraph, center, seed, nseeds, &trees_rm, &new_seeds);
+      iftIGraphEvalAndAssignNewSeeds(igraph, center, seed, nseeds, trees_rm, new_seeds);
+      iftFree(center);
     }
   }
 
   // Free
-  iftDestroySet(&S);
-  iftDestroySet(&new_seeds);
-  iftDestroySet(&frontier_nodes);
-  iftDestroySet(&trees_rm);
+  iftDestroyStack(&new_seeds);
+  iftDestroyStack(&frontier_nodes);
+  iftDestroyStack(&trees_rm);
   iftDestroyDHeap(&Q);
   iftFree(pvalue);
   iftFree(seed);
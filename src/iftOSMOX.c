@@ -27,7 +27,7 @@ iftSet *_iftObjSalMapSamplByValueWithAreaSum
 (iftImage *objsm, iftImage *mask, int num_seeds, float stddev)
 {
   // 1. Input Validation -------------------------------------------------------
-  if(objsm->n < num_seeds || num_seeds < 0) 
+  if(num_seeds < 0) 
     iftError("Invalid number of seeds!", 
              "_iftObjSalMapSamplByValueWithAreaSum");
   if(stddev <= 0.0) 
@@ -51,7 +51,7 @@ iftSet *_iftObjSalMapSamplByValueWithAreaSum
   #ifdef IFT_PARALLEL
   #pragma omp parallel for reduction(+:total_area)
   #endif
-  for(int p = 0; p < objsm->n; p++)
+  for(iftIdx p = 0; p < objsm->n; p++)
   {
     if(mask_copy->val[p] != 0) total_area++;
   }
@@ -89,14 +89,15 @@ iftSet *_iftObjSalMapSamplByValueWithAreaSum
 
   B = iftCircular(sqrtf(patch_width)); // For speed-up purposes
 
-  pixel_val = (double *)calloc(objsm->n, sizeof(double));
+  // Every pixel is written, thus the buffer does not need to be zeroed
+  pixel_val = (double *)iftPoolAlloc(objsm->n * sizeof(double), false);
   heap = iftCreateDHeap(objsm->n, pixel_val);
 
   iftSetRemovalPolicyDHeap(heap, MAXVALUE);
   #ifdef IFT_PARALLEL
   #pragma omp parallel for
   #endif
-  for( int p = 0; p < objsm->n; p++ ) {
+  for( iftIdx p = 0; p < objsm->n; p++ ) {
     if(mask_copy->val[p] != 0) {
       iftVoxel p_voxel;
       
@@ -113,7 +114,7 @@ iftSet *_iftObjSalMapSamplByValueWithAreaSum
         
         if(iftValidVoxel(objsm, q_voxel))
         {
-          int q;
+          iftIdx q;
           
           q = iftGetVoxelIndex(objsm, q_voxel);
           
@@ -124,7 +125,7 @@ iftSet *_iftObjSalMapSamplByValueWithAreaSum
     else pixel_val[p] = IFT_NIL;
   }
   
-  for( int p = 0; p < objsm->n; p++ ) 
+  for( iftIdx p = 0; p < objsm->n; p++ ) 
     if(pixel_val[p] != IFT_NIL) iftInsertDHeap(heap, p);
   
   iftDestroyAdjRel(&B);
@@ -139,7 +140,7 @@ iftSet *_iftObjSalMapSamplByValueWithAreaSum
 
   while( seed_count < num_seeds && !iftEmptyDHeap(heap) ) 
   {
-    int p;
+    iftIdx p;
     iftVoxel voxel_p;
 
     p = iftRemoveDHeap(heap);
@@ -157,7 +158,7 @@ iftSet *_iftObjSalMapSamplByValueWithAreaSum
       voxel_q = iftGetAdjacentVoxel(gaussian->A, voxel_p, i);
 
       if(iftValidVoxel(objsm, voxel_q)) {
-        int q;
+        iftIdx q;
 
         q = iftGetVoxelIndex(objsm, voxel_q);
         
@@ -174,7 +175,7 @@ iftSet *_iftObjSalMapSamplByValueWithAreaSum
     seed_count++;
   }
 
-  free(pixel_val);
+  iftPoolFree(pixel_val, objsm->n * sizeof(double));
   iftDestroyKernel(&gaussian);
   iftDestroyDHeap(&heap);
 
@@ -186,19 +187,34 @@ iftSet *_iftObjSalMapSamplByValueWithAreaSum
 //----------------------------------------------------------------------------//
 iftImage *iftOSMOX
 (iftImage* objsm, iftImage *mask, int num_seeds, float obj_perc, float stddev)
+{
+  iftIntArray *seeds;
+  iftImage *seed_img;
+
+  seeds = iftOSMOXSeeds(objsm, mask, num_seeds, obj_perc, stddev);
+  seed_img = iftIntArrayToSeedImage(seeds, objsm->xsize, objsm->ysize, 
+                                    objsm->zsize);
+  iftDestroyIntArray(&seeds);
+
+  return (seed_img);
+}
+
+iftIntArray *iftOSMOXSeeds
+(iftImage* objsm, iftImage *mask, int num_seeds, float obj_perc, float stddev)
 {
   // 1. Input Validation -------------------------------------------------------
   if(objsm->n < num_seeds || num_seeds < 0) 
-    iftError("Invalid number of seeds!", "iftOSMOX"); 
+    iftError("Invalid number of seeds!", "iftOSMOXSeeds"); 
   if(obj_perc < 0.0 || obj_perc > 1.0) 
-    iftError("Invalid object percentage!", "iftOSMOX");
+    iftError("Invalid object percentage!", "iftOSMOXSeeds");
   if(stddev <= 0.0) 
-    iftError("Invalid standard deviation value!", "iftOSMOX");
-  if(mask != NULL) iftVerifyImageDomains(objsm, mask, "iftOSMOX");
+    iftError("Invalid standard deviation value!", "iftOSMOXSeeds");
+  if(mask != NULL) iftVerifyImageDomains(objsm, mask, "iftOSMOXSeeds");
 
   // 2. Create Aux Vars --------------------------------------------------------
   int obj_seeds, bkg_seeds, max_val, min_val;
-  iftImage *mask_copy;
+  iftImage *mask_copy, *box_objsm, *box_mask;
+  iftBoundingBox bb;
   
   // Establish the number of seeds
   iftMinMaxValues(objsm, &min_val, &max_val);
@@ -214,40 +230,113 @@ iftImage *iftOSMOX
     bkg_seeds = num_seeds - obj_seeds;
   }
 
-  if( mask == NULL ) 
-    mask_copy = iftSelectImageDomain(objsm->xsize, objsm->ysize, objsm->zsize);
-  else mask_copy = iftCopyImage(mask);
+  // The samplings run within the mask's bounding box, if it pays off. The box
+  // is widened by the radius of the largest area sum, which also adds the
+  // saliency around the ROI, so the seeds are the same as in the full image.
+  box_objsm = objsm; box_mask = mask;
+  
+  if(mask != NULL && iftMaskROIBoundingBox(mask, &bb))
+  {
+    int total_area, h;
+
+    total_area = 0;
+    for(iftIdx p = 0; p < mask->n; p++)
+      if(mask->val[p] != 0) total_area++;
+
+    h = (int)sqrtf(iftRound(sqrtf(total_area))) + 1;
+
+    bb.begin.x = iftMax(bb.begin.x - h, 0);
+    bb.begin.y = iftMax(bb.begin.y - h, 0);
+    bb.end.x = iftMin(bb.end.x + h, objsm->xsize - 1);
+    bb.end.y = iftMin(bb.end.y + h, objsm->ysize - 1);
+    if(iftIs3DImage(objsm))
+    {
+      bb.begin.z = iftMax(bb.begin.z - h, 0);
+      bb.end.z = iftMin(bb.end.z + h, objsm->zsize - 1);
+    }
+
+    box_objsm = iftExtractROI(objsm, bb);
+    box_mask = iftExtractROI(mask, bb);
+  }
+
+  // The image-sized temporaries of both samplings are recycled
+  iftEnableBufferPool();
+
+  mask_copy = iftCreatePooledImage(box_objsm->xsize, box_objsm->ysize, 
+                                   box_objsm->zsize, false);
+  for(iftIdx p = 0; p < box_objsm->n; p++)
+    mask_copy->val[p] = (box_mask == NULL) ? 1 : box_mask->val[p];
 
   // 3. Seed sampling ----------------------------------------------------------
+  int i;
   iftSet *obj_set, *bkg_set, *s;
-  iftImage *seed_img, *invsm;
+  iftImage *invsm;
+  iftIntArray *seeds;
 
-  seed_img = iftCreateImage(objsm->xsize, objsm->ysize, objsm->zsize);
-
-  obj_set = _iftObjSalMapSamplByValueWithAreaSum(objsm, mask_copy, obj_seeds, stddev);
+  obj_set = _iftObjSalMapSamplByValueWithAreaSum(box_objsm, mask_copy, obj_seeds, 
+                                                 stddev);
 
   s = obj_set;
   while( s != NULL ) {
     mask_copy->val[s->elem] = 0; // Avoid resampling in the same location
-    seed_img->val[s->elem] = 1;
     s = s->next;
   }
-  iftDestroySet(&obj_set);
 
   // Background importance is the complement of the objects'
-  invsm = iftComplement(objsm);
+  invsm = iftCreatePooledImage(box_objsm->xsize, box_objsm->ysize, 
+                               box_objsm->zsize, false);
+  for(iftIdx p = 0; p < box_objsm->n; p++) 
+    invsm->val[p] = max_val - box_objsm->val[p];
   
-  bkg_set = _iftObjSalMapSamplByValueWithAreaSum(invsm, mask_copy, bkg_seeds, stddev);
-  iftDestroyImage(&mask_copy);
-  iftDestroyImage(&invsm);
+  bkg_set = _iftObjSalMapSamplByValueWithAreaSum(invsm, mask_copy, bkg_seeds, 
+                                                 stddev);
+  iftDestroyPooledImage(&mask_copy);
+  iftDestroyPooledImage(&invsm);
+
+  iftDisableBufferPool();
+
+  seeds = iftCreateIntArray(iftSetSize(obj_set) + iftSetSize(bkg_set));
+
+  i = 0;
+  s = obj_set;
+  while( s != NULL ) { seeds->val[i++] = s->elem; s = s->next; }
+  iftDestroySet(&obj_set);
 
   s = bkg_set;
-  while( s != NULL ) {
-    seed_img->val[s->elem] = 1;
-    s = s->next;
-  }
+  while( s != NULL ) { seeds->val[i++] = s->elem; s = s->next; }
   iftDestroySet(&bkg_set);  
+
+  if(box_objsm != objsm)
+  {
+    iftROIIndexesToImage(seeds, box_objsm, bb.begin, objsm);
+    iftDestroyImage(&box_objsm);
+    iftDestroyImage(&box_mask);
+  }
   
-  return (seed_img);
+  return (seeds);
 }
 
+iftIntArray *iftOSMOXSeedsByCompact
+(const iftCompactImage *objsm, const iftCompactImage *mask, int num_seeds, float obj_perc, float stddev)
+{
+  iftImage *img_objsm, *img_mask;
+  iftIntArray *seeds;
+
+  if(objsm->nbands != 1 || (mask != NULL && mask->nbands != 1))
+    iftError("Only gray images are permitted!", "iftOSMOXSeedsByCompact");
+  if(objsm->n < num_seeds || num_seeds < 0)
+    iftError("Invalid number of seeds!", "iftOSMOXSeedsByCompact");
+  if(mask != NULL) iftVerifyCompactImageDomains(objsm, mask, "iftOSMOXSeedsByCompact");
+
+  // The whole map is widened, since its value range and the sampling over
+  // the mask depend on all of it (the kernels crop only where it is exact)
+  img_objsm = iftCompactROIToImage(objsm, NULL);
+  img_mask = (mask == NULL) ? NULL : iftCompactROIToImage(mask, NULL);
+
+  seeds = iftOSMOXSeeds(img_objsm, img_mask, num_seeds, obj_perc, stddev);
+
+  iftDestroyImage(&img_objsm);
+  if(img_mask != NULL) iftDestroyImage(&img_mask);
+
+  return seeds;
+}